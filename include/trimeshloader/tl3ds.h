@@ -29,6 +29,8 @@
  @brief Trimeshloader 3DS parser public header file
 */
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -71,90 +73,259 @@ TRIMESH_LOADER_API void tl3dsDestroyState( tl3dsState *state );
 TRIMESH_LOADER_API int tl3dsParse(
 	tl3dsState *state,
 	const char *buffer,
-	unsigned int length,
+	size_t length,
 	int last );
 
+/** Bytes following the parsed input that the parser has no use for, the
+ * rest of an unknown or unwanted chunk like keyframer data.
+ * \param state a state between tl3dsParse calls.
+ * \return Returns the number of bytes, 0 if the next bytes are needed.
+ */
+TRIMESH_LOADER_API size_t tl3dsSkipLength( tl3dsState *state );
+
+/** Tell the parser that the input moves on without the next length bytes,
+ * e.g. after seeking past them.
+ * \param state a state between tl3dsParse calls.
+ * \param length at most tl3dsSkipLength( state ).
+ * \return Returns 0 on success, 1 if these bytes are needed.
+ */
+TRIMESH_LOADER_API int tl3dsSkip( tl3dsState *state, size_t length );
+
+/** Reserve room for the expected amount of data before parsing.
+ * Buffers still grow past the reservation, this only saves reallocations.
+ * \param state a previously created state.
+ * \param points expected vertex positions of all objects.
+ * \param texcoords expected texture coordinates of all objects.
+ * \param faces expected faces of all objects.
+ * \return Returns 0 on success, 1 if an allocation failed.
+ */
+TRIMESH_LOADER_API int tl3dsReserve(
+	tl3dsState *state,
+	size_t points,
+	size_t texcoords,
+	size_t faces );
+
+/** Estimate the reservation from the start of the input and reserve it.
+ * The chunk headers in buffer are walked to read the point, texcoord and
+ * face counts, the part of the file they describe is scaled up to
+ * total_length. With the whole file in buffer the result is exact.
+ * \param state a previously created state.
+ * \param buffer the start of the file or the whole file.
+ * \param length size of buffer in bytes.
+ * \param total_length size of the whole file in bytes.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tl3dsReserveEstimate(
+	tl3dsState *state,
+	const char *buffer,
+	size_t length,
+	size_t total_length );
+
+/* streaming */
+
+/** Material properties passed to on_material_property */
+#define TL_3DS_MATERIAL_AMBIENT 1      /* 3 values */
+#define TL_3DS_MATERIAL_DIFFUSE 2      /* 3 values */
+#define TL_3DS_MATERIAL_SPECULAR 3     /* 3 values */
+#define TL_3DS_MATERIAL_SHININESS 4    /* 1 value, 0 to 1 */
+#define TL_3DS_MATERIAL_TRANSPARENCY 5 /* 1 value, 0 to 1 */
+
+/** Functions called while parsing instead of storing the data, any of them
+ * may be NULL. Names are only valid during the call. */
+typedef struct tl3dsCallbacks
+{
+	void *user_data;
+
+	void (*on_vertex)( void *user_data, float x, float y, float z );
+	void (*on_texcoord)( void *user_data, float u, float v );
+
+	/* indices into all vertices reported so far, starting at 0 */
+	void (*on_face)( void *user_data, size_t a, size_t b, size_t c );
+
+	void (*on_object)( void *user_data, const char *name );
+
+	/* the next face_count faces of the object use this material */
+	void (*on_usemtl)( void *user_data, const char *name, size_t face_count );
+
+	/* the following properties belong to this material */
+	void (*on_material)( void *user_data, const char *name );
+	void (*on_material_property)( void *user_data, int property,
+		const float *values );
+} tl3dsCallbacks;
+
+/** Report everything tl3dsParse reads to callbacks instead of the state.
+ * The data access functions find nothing then. The callbacks are copied
+ * and stay set across tl3dsResetState.
+ * \param state a previously created state, before parsing.
+ * \param callbacks the functions to call, NULL to store the data again.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tl3dsSetCallbacks(
+	tl3dsState *state,
+	const tl3dsCallbacks *callbacks );
+
 /* data access */
-TRIMESH_LOADER_API unsigned int tl3dsObjectCount( tl3dsState *state );
+TRIMESH_LOADER_API size_t tl3dsObjectCount( tl3dsState *state );
 
 TRIMESH_LOADER_API const char *tl3dsObjectName(
 	tl3dsState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tl3dsObjectFaceCount(
+TRIMESH_LOADER_API size_t tl3dsObjectFaceCount(
 	tl3dsState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tl3dsObjectFaceIndex(
+TRIMESH_LOADER_API size_t tl3dsObjectFaceIndex(
 	tl3dsState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tl3dsMaterialCount( tl3dsState *state );
+TRIMESH_LOADER_API size_t tl3dsMaterialCount( tl3dsState *state );
 
 TRIMESH_LOADER_API const char *tl3dsMaterialName(
 	tl3dsState *state,
-	unsigned int object );
+	size_t object );
 
 TRIMESH_LOADER_API int tl3dsGetMaterial(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	float *ambient,
 	float *diffuse,
 	float *specular,
 	float *reflect );
 
-TRIMESH_LOADER_API unsigned int tl3dsMaterialReferenceCount( tl3dsState *state );
+TRIMESH_LOADER_API size_t tl3dsMaterialReferenceCount( tl3dsState *state );
 
 TRIMESH_LOADER_API const char *tl3dsMaterialReferenceName( 
 	tl3dsState *state,
-	unsigned int object );
+	size_t object );
 
 TRIMESH_LOADER_API int tl3dsGetMaterialReference( 
 	tl3dsState *state,
-	unsigned int index,
-	unsigned int *face_index,
-	unsigned int *face_count );
+	size_t index,
+	size_t *face_index,
+	size_t *face_count );
 
-TRIMESH_LOADER_API unsigned int tl3dsVertexCount( tl3dsState *state );
+TRIMESH_LOADER_API size_t tl3dsVertexCount( tl3dsState *state );
 
 TRIMESH_LOADER_API int tl3dsGetVertexDouble(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	double *x, double *y, double *z,
 	double *tu, double *tv,
 	double *nx, double *ny, double *nz );
 	
 TRIMESH_LOADER_API int tl3dsGetVertex(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	float *x, float *y, float *z,
 	float *tu, float *tv,
 	float *nx, float *ny, float *nz );
 	
-TRIMESH_LOADER_API unsigned int tl3dsFaceCount(
+TRIMESH_LOADER_API size_t tl3dsFaceCount(
 	tl3dsState *state );
 
 TRIMESH_LOADER_API int tl3dsGetFaceInt(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	unsigned int *a,
 	unsigned int *b,
 	unsigned int *c );
 	
 TRIMESH_LOADER_API int tl3dsGetFace(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	unsigned short *a,
 	unsigned short *b,
 	unsigned short *c );
 
+/* chunk index */
+
+/** Offsets of the objects and materials of a 3DS file, to list them and to
+ * parse only some objects. */
+typedef struct tl3dsIndex tl3dsIndex;
+
+/** Index a complete 3DS file in memory. Only the chunk headers and names
+ * are read, so for a mapped file only those pages are loaded. Objects cut
+ * off by the end of a truncated file are left out.
+ * \param buffer the whole file, it has to stay valid while the index is used.
+ * \param length size of buffer in bytes.
+ * \return A new index, which needs to be deleted with tl3dsIndexDestroy. NULL on error.
+ */
+TRIMESH_LOADER_API tl3dsIndex *tl3dsIndexCreate( const char *buffer, size_t length );
+
+TRIMESH_LOADER_API void tl3dsIndexDestroy( tl3dsIndex *index );
+
+/** Number of OBJECT chunks, meshes as well as cameras and lights. */
+TRIMESH_LOADER_API size_t tl3dsIndexObjectCount( tl3dsIndex *index );
+
+TRIMESH_LOADER_API const char *tl3dsIndexObjectName(
+	tl3dsIndex *index,
+	size_t object );
+
+/** Get the counts stored in front of the arrays of an object.
+ * \param points, texcoords, faces receive the counts, 0 without a mesh, may be NULL.
+ * \return Returns 0 on success, 1 if there is no such object.
+ */
+TRIMESH_LOADER_API int tl3dsIndexGetObjectCounts(
+	tl3dsIndex *index,
+	size_t object,
+	size_t *points,
+	size_t *texcoords,
+	size_t *faces );
+
+/** Find a chunk of an object in the file.
+ * \param chunk_id 0x4000 (OBJECT), 0x4100 (TRI_OBJECT), 0x4110 (POINT_ARRAY),
+ * 0x4140 (TEX_ARRAY) or 0x4120 (FACE_ARRAY).
+ * \param offset, length receive the position of the chunk including its header, may be NULL.
+ * \return Returns 0 on success, 1 if the object has no such chunk.
+ */
+TRIMESH_LOADER_API int tl3dsIndexGetChunk(
+	tl3dsIndex *index,
+	size_t object,
+	unsigned short chunk_id,
+	size_t *offset,
+	size_t *length );
+
+TRIMESH_LOADER_API size_t tl3dsIndexMaterialCount( tl3dsIndex *index );
+
+TRIMESH_LOADER_API const char *tl3dsIndexMaterialName(
+	tl3dsIndex *index,
+	size_t material );
+
+/** Find the MATERIAL chunk (0xAFFF) of a material in the file.
+ * \return Returns 0 on success, 1 if there is no such material.
+ */
+TRIMESH_LOADER_API int tl3dsIndexGetMaterialChunk(
+	tl3dsIndex *index,
+	size_t material,
+	size_t *offset,
+	size_t *length );
+
+/** Parse the materials and some objects into a new state, which is done
+ * with parsing afterwards. The result is the same as parsing a file that
+ * holds nothing but these objects.
+ * \param state a previously created state, callbacks work as well.
+ * \param objects indices of the objects, in the order to parse them.
+ * \param object_count number of objects.
+ * \return Returns 0 on success, 1 on error.
+ */
+TRIMESH_LOADER_API int tl3dsIndexParse(
+	tl3dsIndex *index,
+	tl3dsState *state,
+	const size_t *objects,
+	size_t object_count );
+
+/** Check the file extension, compressed files like mesh.3ds.gz or
+ * mesh.3ds.zst count as well.
+ * \return Returns 0 if the extension matches, 1 otherwise.
+ */
 TRIMESH_LOADER_API int tl3dsCheckFileExtension( const char *filename );
 
 /** Check if the loaded mesh has normals. 3DS does not support normals. It is for convenience only, and always returns 0.
  * \param state a previously created state.
  * \return Returns 0 if no normals are present, >0 if they are.
  */
-TRIMESH_LOADER_API unsigned int tl3dsHasNormals( tl3dsState *state );
+TRIMESH_LOADER_API size_t tl3dsHasNormals( tl3dsState *state );
 
 /**
  * @}
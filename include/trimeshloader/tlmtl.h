@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef TRIMESH_LOADER_MTL_H
+#define TRIMESH_LOADER_MTL_H
+
+/**
+ @file  tlmtl.h
+ @brief Trimeshloader MTL (OBJ material library) parser public header file
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TRIMESH_LOADER_EXPORT
+	#define TRIMESH_LOADER_API
+#else
+	#define TRIMESH_LOADER_API extern
+#endif
+
+/** @defgroup low_level_mtl_api Trimeshloader low level MTL API
+ * @{
+ */
+
+/** Materials of one MTL file. Understood are newmtl, Ka, Kd, Ks, Ke, Ns,
+ * Tr, d, Ni, illum and map_Kd, everything else is skipped. A tlObjState
+ * can adopt the materials with tlObjAdoptMaterials. */
+typedef struct tlMtlState tlMtlState;
+
+/* state handling */
+TRIMESH_LOADER_API tlMtlState *tlMtlCreateState();
+
+/** Do not reset a state that is shared with tlMtlRetainState. */
+TRIMESH_LOADER_API int tlMtlResetState( tlMtlState *state );
+
+/** Add a reference to a parsed state, e.g. to share it between several
+ * tlObjState or tlTrimesh objects. The state must not be parsed into any
+ * more, reading it from several threads is safe.
+ * \param state a state done with parsing.
+ */
+TRIMESH_LOADER_API void tlMtlRetainState( tlMtlState *state );
+
+/** Drop a reference, the state is freed with the last one. A created
+ * state starts with one reference. */
+TRIMESH_LOADER_API void tlMtlDestroyState( tlMtlState *state );
+
+/* parsing */
+TRIMESH_LOADER_API int tlMtlParse(
+	tlMtlState *state,
+	const char *buffer,
+	size_t length,
+	int last );
+
+/* data access, materials are complete once their lines are parsed */
+TRIMESH_LOADER_API size_t tlMtlMaterialCount( tlMtlState *state );
+
+TRIMESH_LOADER_API const char *tlMtlMaterialName(
+	tlMtlState *state,
+	size_t index );
+
+/** Get the colors of a material, like tlObjGetMaterial. The alpha of the
+ * colors is the opacity from d or Tr.
+ * \param ambient, diffuse, specular 4 floats each, or NULL.
+ * \param shininess 1 float, or NULL.
+ * \return Returns 0 on success, 1 if there is no such material.
+ */
+TRIMESH_LOADER_API int tlMtlGetMaterial(
+	tlMtlState *state,
+	size_t index,
+	float *ambient,
+	float *diffuse,
+	float *specular,
+	float *shininess );
+
+/** Get the properties tlObjGetMaterial has no room for.
+ * \param emissive 4 floats (Ke), or NULL.
+ * \param optical_density 1 float (Ni), or NULL.
+ * \param illumination the illumination model (illum), -1 if not given, or NULL.
+ * \return Returns 0 on success, 1 if there is no such material.
+ */
+TRIMESH_LOADER_API int tlMtlGetMaterialEx(
+	tlMtlState *state,
+	size_t index,
+	float *emissive,
+	float *optical_density,
+	int *illumination );
+
+/** The diffuse texture (map_Kd) of a material.
+ * \return The file name as written in the file, NULL if there is none.
+ */
+TRIMESH_LOADER_API const char *tlMtlMaterialTexture(
+	tlMtlState *state,
+	size_t index );
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -29,6 +29,10 @@
  @brief Trimeshloader OBJ parser public header file
 */
 
+#include <stddef.h>
+
+#include "tlmtl.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -45,9 +49,19 @@ extern "C" {
  
 typedef struct tlObjState tlObjState;
 
+/** Flag for tlObjCreateStateEx: parse and keep coordinates as float
+ * instead of double, which halves the memory of the attribute buffers. */
+#define TL_OBJ_SINGLE_PRECISION 1
+
 /* state handling */
 TRIMESH_LOADER_API tlObjState *tlObjCreateState();
 
+/** Create a new parsing state with options.
+ * \param flags 0 or TL_OBJ_SINGLE_PRECISION.
+ * \return A new parsing state, NULL on error.
+ */
+TRIMESH_LOADER_API tlObjState *tlObjCreateStateEx( unsigned int flags );
+
 TRIMESH_LOADER_API int tlObjResetState( tlObjState *state );
 
 TRIMESH_LOADER_API void tlObjDestroyState( tlObjState *state );
@@ -56,96 +70,276 @@ TRIMESH_LOADER_API void tlObjDestroyState( tlObjState *state );
 TRIMESH_LOADER_API int tlObjParse(
 	tlObjState *state,
 	const char *buffer,
-	unsigned int length,
+	size_t length,
 	int last );
 
+/** Parse a complete OBJ file that is already in memory on several threads.
+ * The input is split behind line breaks, the pieces are tokenized and
+ * their numbers parsed in parallel, then merged in file order. The result
+ * is identical to a single tlObjParse( state, buffer, length, 1 ) call.
+ * \param state a previously created state.
+ * \param buffer the whole file.
+ * \param length size of buffer in bytes.
+ * \param thread_count threads to use, 0 uses one per processor.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlObjParseParallel(
+	tlObjState *state,
+	const char *buffer,
+	size_t length,
+	unsigned int thread_count );
+
+/** Reserve room for the expected amount of data before parsing.
+ * Buffers still grow past the reservation, this only saves reallocations.
+ * \param state a previously created state.
+ * \param points expected "v" lines.
+ * \param texcoords expected "vt" lines.
+ * \param normals expected "vn" lines.
+ * \param faces expected triangles after splitting polygons.
+ * \param vertices expected distinct v/vt/vn combinations.
+ * \return Returns 0 on success, 1 if an allocation failed.
+ */
+TRIMESH_LOADER_API int tlObjReserve(
+	tlObjState *state,
+	size_t points,
+	size_t texcoords,
+	size_t normals,
+	size_t faces,
+	size_t vertices );
+
+/** Estimate the reservation from a sample of the input and reserve it.
+ * The sample is scanned (large ones only in a few places) and the counts
+ * are scaled up to total_length.
+ * \param state a previously created state.
+ * \param buffer the start of the file or the whole file.
+ * \param length size of buffer in bytes.
+ * \param total_length size of the whole file in bytes.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlObjReserveEstimate(
+	tlObjState *state,
+	const char *buffer,
+	size_t length,
+	size_t total_length );
+
+/* streaming */
+
+/** Material properties passed to on_material_property */
+#define TL_OBJ_MATERIAL_AMBIENT 1      /* Ka, 3 values */
+#define TL_OBJ_MATERIAL_DIFFUSE 2      /* Kd, 3 values */
+#define TL_OBJ_MATERIAL_SPECULAR 3     /* Ks, 3 values */
+#define TL_OBJ_MATERIAL_SHININESS 4    /* Ns, 1 value */
+#define TL_OBJ_MATERIAL_TRANSPARENCY 5 /* Tr, 1 value */
+
+/** One polygon corner, indices start at 1 and are 0 when missing.
+ * Relative (negative) indices are already resolved. */
+typedef struct tlObjCorner
+{
+	size_t v, vt, vn;
+} tlObjCorner;
+
+/** Functions called while parsing instead of storing the data, any of them
+ * may be NULL. Names and corners are only valid during the call. */
+typedef struct tlObjCallbacks
+{
+	void *user_data;
+
+	void (*on_vertex)( void *user_data, double x, double y, double z );
+	void (*on_texcoord)( void *user_data, double u, double v );
+	void (*on_normal)( void *user_data, double x, double y, double z );
+
+	/* polygons are passed as they are, with corner_count >= 1 */
+	void (*on_face)( void *user_data, const tlObjCorner *corners, size_t corner_count );
+
+	void (*on_object)( void *user_data, const char *name );
+	void (*on_usemtl)( void *user_data, const char *name );
+	void (*on_mtllib)( void *user_data, const char *name );
+
+	/* newmtl, the following properties belong to this material */
+	void (*on_material)( void *user_data, const char *name );
+	void (*on_material_property)( void *user_data, int property,
+		const float *values );
+} tlObjCallbacks;
+
+/** Report everything tlObjParse reads to callbacks instead of the state.
+ * The state then only keeps an incomplete line and the element counts
+ * needed for relative indices, the data access functions find nothing.
+ * tlObjParseParallel parses serially in this mode. The callbacks are
+ * copied and stay set across tlObjResetState.
+ * \param state a previously created state, before parsing.
+ * \param callbacks the functions to call, NULL to store the data again.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlObjSetCallbacks(
+	tlObjState *state,
+	const tlObjCallbacks *callbacks );
+
+/* progressive access */
+
+typedef struct tlObjSnapshot tlObjSnapshot;
+
+/** Take a read-only view of what has been parsed so far: the finished
+ * objects, all faces and the vertices they use. Nothing is copied, while
+ * snapshots are alive the state moves growing buffers instead of
+ * reallocating them, so every snapshot stays valid as parsing continues.
+ * Create and release snapshots on the parsing thread between tlObjParse
+ * calls; the view itself can be read from any thread meanwhile. Release
+ * all snapshots before resetting or destroying the state.
+ * \param state a state in the middle of (or done with) parsing.
+ * \return A new snapshot, NULL on error.
+ */
+TRIMESH_LOADER_API tlObjSnapshot *tlObjSnapshotCreate( tlObjState *state );
+
+TRIMESH_LOADER_API void tlObjSnapshotRelease( tlObjSnapshot *snapshot );
+
+TRIMESH_LOADER_API size_t tlObjSnapshotObjectCount( const tlObjSnapshot *snapshot );
+
+TRIMESH_LOADER_API const char *tlObjSnapshotObjectName(
+	const tlObjSnapshot *snapshot,
+	size_t object );
+
+TRIMESH_LOADER_API size_t tlObjSnapshotObjectFaceIndex(
+	const tlObjSnapshot *snapshot,
+	size_t object );
+
+TRIMESH_LOADER_API size_t tlObjSnapshotObjectFaceCount(
+	const tlObjSnapshot *snapshot,
+	size_t object );
+
+TRIMESH_LOADER_API size_t tlObjSnapshotVertexCount( const tlObjSnapshot *snapshot );
+
+TRIMESH_LOADER_API int tlObjSnapshotGetVertex(
+	const tlObjSnapshot *snapshot,
+	size_t index,
+	float *x, float *y, float *z,
+	float *tu, float *tv,
+	float *nx, float *ny, float *nz );
+
+TRIMESH_LOADER_API size_t tlObjSnapshotFaceCount( const tlObjSnapshot *snapshot );
+
+TRIMESH_LOADER_API int tlObjSnapshotGetFaceInt(
+	const tlObjSnapshot *snapshot,
+	size_t index,
+	unsigned int *a,
+	unsigned int *b,
+	unsigned int *c );
+
 /* data access */
-TRIMESH_LOADER_API unsigned int tlObjObjectCount( tlObjState *state );
+TRIMESH_LOADER_API size_t tlObjObjectCount( tlObjState *state );
 
 TRIMESH_LOADER_API const char *tlObjObjectName(
 	tlObjState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tlObjObjectFaceCount(
+TRIMESH_LOADER_API size_t tlObjObjectFaceCount(
 	tlObjState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tlObjObjectFaceIndex(
+TRIMESH_LOADER_API size_t tlObjObjectFaceIndex(
 	tlObjState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tlObjMaterialCount( tlObjState *state );
+TRIMESH_LOADER_API size_t tlObjMaterialCount( tlObjState *state );
 
 TRIMESH_LOADER_API const char *tlObjMaterialName(
 	tlObjState *state,
-	unsigned int object );
+	size_t object );
 
-TRIMESH_LOADER_API unsigned int tlObjMaterialLibCount( tlObjState *state );
+TRIMESH_LOADER_API size_t tlObjMaterialLibCount( tlObjState *state );
 
 TRIMESH_LOADER_API const char *tlObjMaterialLibName(
 	tlObjState *state,
-	unsigned int object );
+	size_t object );
 
 TRIMESH_LOADER_API int tlObjGetMaterial(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	float *ambient,
 	float *diffuse,
 	float *specular,
 	float *reflect );
 
-TRIMESH_LOADER_API unsigned int tlObjMaterialReferenceCount( tlObjState *state );
+/** Append the materials of another state, e.g. a material library parsed
+ * on its own, to the materials of state. The default materials every state
+ * starts with are not copied again.
+ * \param state the state to add the materials to.
+ * \param source a state done with parsing, it is not changed.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlObjMergeMaterials( tlObjState *state, tlObjState *source );
+
+/** Take over the materials of a parsed MTL file without copying them. They
+ * are counted behind the state's own materials, in the order of adoption.
+ * \param state the state to add the materials to.
+ * \param materials state takes over this reference on success.
+ * \return Returns 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlObjAdoptMaterials( tlObjState *state, tlMtlState *materials );
+
+/** Number of MTL states adopted so far. */
+TRIMESH_LOADER_API size_t tlObjAdoptedCount( tlObjState *state );
+
+/** An adopted MTL state, e.g. to keep it with tlMtlRetainState.
+ * \return The state, owned by state, NULL if index is out of range.
+ */
+TRIMESH_LOADER_API tlMtlState *tlObjAdoptedMaterials( tlObjState *state, size_t index );
+
+TRIMESH_LOADER_API size_t tlObjMaterialReferenceCount( tlObjState *state );
 
 TRIMESH_LOADER_API const char *tlObjMaterialReferenceName( 
 	tlObjState *state,
-	unsigned int object );
+	size_t object );
 
 TRIMESH_LOADER_API int tlObjGetMaterialReference( 
 	tlObjState *state,
-	unsigned int index,
-	unsigned int *face_index,
-	unsigned int *face_count );
+	size_t index,
+	size_t *face_index,
+	size_t *face_count );
 
-TRIMESH_LOADER_API unsigned int tlObjVertexCount( tlObjState *state );
+TRIMESH_LOADER_API size_t tlObjVertexCount( tlObjState *state );
 
 TRIMESH_LOADER_API int tlObjGetVertexDouble(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	double *x, double *y, double *z,
 	double *tu, double *tv,
 	double *nx, double *ny, double *nz );
 	
 TRIMESH_LOADER_API int tlObjGetVertex(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	float *x, float *y, float *z,
 	float *tu, float *tv,
 	float *nx, float *ny, float *nz );
 	
-TRIMESH_LOADER_API unsigned int tlObjFaceCount(
+TRIMESH_LOADER_API size_t tlObjFaceCount(
 	tlObjState *state );
 
 TRIMESH_LOADER_API int tlObjGetFaceInt(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	unsigned int *a,
 	unsigned int *b,
 	unsigned int *c );
 	
 TRIMESH_LOADER_API int tlObjGetFace(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	unsigned short *a,
 	unsigned short *b,
 	unsigned short *c );
 
+/** Check the file extension, compressed files like mesh.obj.gz or
+ * mesh.obj.zst count as well.
+ * \return Returns 0 if the extension matches, 1 otherwise.
+ */
 TRIMESH_LOADER_API int tlObjCheckFileExtension( const char *filename );
 
 /** Check if the loaded mesh has normals.
  * \param state a previously created state.
  * \return Returns 0 if no normals are present, >0 if they are.
  */
-TRIMESH_LOADER_API unsigned int tlObjHasNormals( tlObjState *state );
+TRIMESH_LOADER_API size_t tlObjHasNormals( tlObjState *state );
 
 /**
  * @}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef TRIMESH_LOADER_READER_H
+#define TRIMESH_LOADER_READER_H
+
+/** 
+ @file  tlreader.h
+ @brief Trimeshloader reader interface public header file
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef TRIMESH_LOADER_EXPORT
+	#define TRIMESH_LOADER_API
+#else
+	#define TRIMESH_LOADER_API extern
+#endif
+
+/** @defgroup reader_api Trimeshloader reader API
+ * @{
+ */
+
+/** Functions the high level loaders read a file through. Implement them to
+ * load from archives or other custom stores, unused ones have to be NULL. */
+typedef struct tlReader
+{
+	/** passed to every function */
+	void *user_data;
+
+	/** Read up to size bytes into buffer. Fewer bytes than asked for means
+	 * the end of the data (or an error) was reached.
+	 * \return the number of bytes read. */
+	size_t (*read)( void *user_data, void *buffer, size_t size );
+
+	/** Move to an absolute offset, may be NULL if the data is a stream.
+	 * \return 0 on success, 1 on failure. */
+	int (*seek)( void *user_data, size_t offset );
+
+	/** Total size in bytes, may be NULL.
+	 * \return the size, 0 if it is unknown. */
+	size_t (*size)( void *user_data );
+
+	/** Release user_data, may be NULL. */
+	void (*close)( void *user_data );
+
+	/** The whole data at once, may be NULL. The loaders parse it in place
+	 * instead of reading it when this returns non NULL.
+	 * \param size set to the size of the data.
+	 * \return the data, valid until the reader is closed, or NULL. */
+	const void *(*map)( void *user_data, size_t *size );
+
+} tlReader;
+
+/** Open a named file for reading, used for the main file and the files it
+ * references (OBJ material libraries).
+ * \param open_data user pointer passed through by the loaders.
+ * \param filename the file to open.
+ * \param reader filled in on success.
+ * \return 0 on success, 1 on failure.
+ */
+typedef int (*tlOpenFunction)( void *open_data, const char *filename, tlReader *reader );
+
+/** Open a file with stdio.
+ * \return 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlReaderOpenFile( tlReader *reader, const char *filename );
+
+/** Open a file with POSIX read(). Small reads are served from a block that
+ * grows while the file is read sequentially, large reads go straight into
+ * the caller's buffer.
+ * \return 0 on success, 1 on failure or where POSIX files are not available.
+ */
+TRIMESH_LOADER_API int tlReaderOpenDescriptor( tlReader *reader, const char *filename );
+
+/** Flag for tlReaderOpenMapped: fault all pages in when mapping. */
+#define TL_READER_MAP_POPULATE 1
+
+/** Map a file into memory, the loaders then parse it without copying.
+ * Changing the file while it is mapped is undefined behaviour.
+ * \param flags 0 or TL_READER_MAP_POPULATE.
+ * \return 0 on success, 1 on failure, for empty or special files or where
+ * mmap is not available.
+ */
+TRIMESH_LOADER_API int tlReaderOpenMapped( tlReader *reader, const char *filename, unsigned int flags );
+
+/** Read from memory, the data is not copied and has to outlive the reader.
+ * \return 0 on success, 1 on failure.
+ */
+TRIMESH_LOADER_API int tlReaderOpenMemory( tlReader *reader, const void *data, size_t size );
+
+/** The default tlOpenFunction: POSIX files where available, stdio otherwise.
+ * open_data is not used.
+ */
+TRIMESH_LOADER_API int tlReaderOpen( void *open_data, const char *filename, tlReader *reader );
+
+/** A tlOpenFunction that maps files with tlReaderOpenMapped and falls back
+ * to tlReaderOpen. open_data is NULL or points to an unsigned int with the
+ * flags, e.g. tlLoadTrimeshEx( filename, tlReaderOpenMap, NULL, format ).
+ */
+TRIMESH_LOADER_API int tlReaderOpenMap( void *open_data, const char *filename, tlReader *reader );
+
+/** Read another reader ahead on a thread, so the next blocks are loaded
+ * while the caller parses the previous one. At most block_count blocks are
+ * read ahead of the caller. Without thread support, or for readers with a
+ * map callback, source is used as it is.
+ * \param reader filled in on success.
+ * \param source an opened reader, owned and closed by reader from now on.
+ * \param block_size bytes per block, 0 for 1 MiB.
+ * \param block_count blocks in flight, 0 for 3, at least 2.
+ * \return 0 on success, 1 on failure, source is closed then as well.
+ */
+TRIMESH_LOADER_API int tlReaderReadAhead(
+	tlReader *reader,
+	tlReader *source,
+	size_t block_size,
+	unsigned int block_count );
+
+/** Options for tlReaderOpenReadAhead */
+typedef struct tlReadAheadOptions
+{
+	/** opens the files, NULL for tlReaderOpen */
+	tlOpenFunction open;
+
+	/** passed to open */
+	void *open_data;
+
+	/** as in tlReaderReadAhead */
+	size_t block_size;
+
+	/** as in tlReaderReadAhead */
+	unsigned int block_count;
+
+} tlReadAheadOptions;
+
+/** A tlOpenFunction that reads the opened files ahead on a thread.
+ * open_data is NULL or points to a tlReadAheadOptions, e.g.
+ * tlLoadTrimeshEx( filename, tlReaderOpenReadAhead, NULL, format ).
+ */
+TRIMESH_LOADER_API int tlReaderOpenReadAhead( void *open_data, const char *filename, tlReader *reader );
+
+/** Decompress gzip or zstd data, detected by its first bytes, while it is
+ * read. The data is inflated on a thread with tlReaderReadAhead. Other data
+ * is passed through, usually as source itself. The high level loaders do
+ * this for every file, so mesh.obj.gz loads like mesh.obj.
+ * \param reader filled in on success.
+ * \param source an opened reader, owned and closed by reader from now on.
+ * \return 0 on success, 1 on failure or for a compression this build does
+ * not support (see HAVE_ZLIB and HAVE_ZSTD), source is closed then as well.
+ */
+TRIMESH_LOADER_API int tlReaderDecompress( tlReader *reader, tlReader *source );
+
+/** Close a reader opened by any of the functions above or a tlOpenFunction. */
+TRIMESH_LOADER_API void tlReaderClose( tlReader *reader );
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,7 +30,9 @@
 #define TRIMESH_LOADER_H
 
 #include "tlobj.h"
+#include "tlmtl.h"
 #include "tl3ds.h"
+#include "tlreader.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -54,10 +56,10 @@ typedef struct tlObject
 	char *name;
 
 	/** First face in the index list */
-	unsigned int face_index;
+	size_t face_index;
 
 	/** Face count */
-	unsigned int face_count;
+	size_t face_count;
 
 } tlObject;
 
@@ -91,10 +93,10 @@ typedef struct tlMaterialReference
 	char *name;
 
 	/** First face in the index list */
-	unsigned int face_index;
+	size_t face_index;
 
 	/** Face count */
-	unsigned int face_count;
+	size_t face_count;
 
 } tlMaterialReference;
 
@@ -105,7 +107,7 @@ typedef struct tlTrimesh
 	float *vertices;
 
 	/** number of vertices */
-	unsigned int vertex_count;
+	size_t vertex_count;
 
 	/** format of the vertices */
 	unsigned int vertex_format;
@@ -113,32 +115,41 @@ typedef struct tlTrimesh
 	/** size/stride of each vertex, in bytes */
 	unsigned int vertex_size;
 
-	/** pointer to the face (triangle) indices (3 unsigned shorts) */
-	unsigned short *faces;
+	/** pointer to the face (triangle) indices (3 unsigned ints) */
+	unsigned int *faces;
 
 	/** number of faces */
-	unsigned int face_count;
+	size_t face_count;
 
 	/** list of objects in this trimesh */
 	tlObject *objects;
 
 	/** number of objects */
-	unsigned int object_count;
+	size_t object_count;
 
 	/** list of materials in this trimesh */
 	tlMaterial *materials;
 
 	/** number of materials */
-	unsigned int material_count;
+	size_t material_count;
 
 	/** list of references to materials in this trimesh */
 	tlMaterialReference *material_references;
 
 	/** number of references to materials */
-	unsigned int material_reference_count;
+	size_t material_reference_count;
+
+	/** material libraries shared with other trimeshes, the names of their materials point into them */
+	tlMtlState **material_libraries;
+
+	/** number of shared material libraries */
+	size_t material_library_count;
 
 } tlTrimesh;
 
+/** A cache of parsed material libraries, shared by all OBJ files using them */
+typedef struct tlMaterialCache tlMaterialCache;
+
 
 /** Load a 3DS file in an tlTrimesh structure
  * \param filename Pointer to NULL-terminated string containing the filename
@@ -147,6 +158,28 @@ typedef struct tlTrimesh
  */
 TRIMESH_LOADER_API tlTrimesh *tlLoad3DS( const char*filename, unsigned int vertex_format );
 
+/** Load a 3DS file from a reader in an tlTrimesh structure
+ * \param reader An opened reader, it is read to the end and not closed
+ * \param vertex_format Defines the vertex format. any format combination of TL_FVF_XYZ, TL_FVF_UV, TL_FVF_NORMAL
+ * \return Returns a new tlTrimesh object, which needs to be deleted with tlDeleteTrimesh. NULL on error.
+ */
+TRIMESH_LOADER_API tlTrimesh *tlLoad3DSReader( tlReader *reader, unsigned int vertex_format );
+
+
+/** Load only some objects of a 3DS file in an tlTrimesh structure. The file is
+ * indexed first, then only the materials and the objects with these names are
+ * parsed. Uncompressed files are mapped, so the rest is not even read
+ * \param filename Pointer to NULL-terminated string containing the filename
+ * \param names name_count object names, objects with other names are left out
+ * \param name_count number of names
+ * \param vertex_format Defines the vertex format. any format combination of TL_FVF_XYZ, TL_FVF_UV, TL_FVF_NORMAL
+ * \return Returns a new tlTrimesh object, which needs to be deleted with tlDeleteTrimesh. NULL on error or if no object has one of the names.
+ */
+TRIMESH_LOADER_API tlTrimesh *tlLoad3DSObjects(
+	const char *filename,
+	const char *const *names,
+	size_t name_count,
+	unsigned int vertex_format );
 
 /** Load a OBJ file in an tlTrimesh structure
  * \param filename Pointer to NULL-terminated string containing the filename
@@ -155,6 +188,21 @@ TRIMESH_LOADER_API tlTrimesh *tlLoad3DS( const char*filename, unsigned int verte
  */
 TRIMESH_LOADER_API tlTrimesh *tlLoadOBJ( const char*filename, unsigned int vertex_format );
 
+/** Load a OBJ file from a reader in an tlTrimesh structure
+ * \param reader An opened reader, it is read to the end and not closed
+ * \param filename Name of the file the reader reads, material libraries are looked up next to it. May be NULL
+ * \param open Opens the material libraries, NULL to skip them. They are opened and parsed on worker threads while the file is still parsed, so open has to be thread safe
+ * \param open_data Passed to open
+ * \param vertex_format Defines the vertex format. any format combination of TL_FVF_XYZ, TL_FVF_UV, TL_FVF_NORMAL
+ * \return Returns a new tlTrimesh object, which needs to be deleted with tlDeleteTrimesh. NULL on error.
+ */
+TRIMESH_LOADER_API tlTrimesh *tlLoadOBJReader(
+	tlReader *reader,
+	const char *filename,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format );
+
 /** Create an a tlTrimesh structure from a tlObjState
  * \param state Pointer to state after parsing.
  * \param vertex_format Defines the vertex format. any format combination of TL_FVF_XYZ, TL_FVF_UV, TL_FVF_NORMAL
@@ -178,6 +226,60 @@ TRIMESH_LOADER_API void tlTrimeshCreateNormals( tlTrimesh *trimesh );
  */
 TRIMESH_LOADER_API tlTrimesh *tlLoadTrimesh( const char*filename, unsigned int vertex_format );
 
+/** Load an 3DS or OBJ file in an tlTrimesh structure, opening the file and any material libraries with a custom function.
+ * \param filename Pointer to NULL-terminated string containing the filename
+ * \param open Opens filename and the files it references, tlReaderOpen for the file system. Material libraries are opened on worker threads, so open has to be thread safe
+ * \param open_data Passed to open
+ * \param vertex_format Defines the vertex format. any format combination of TL_FVF_XYZ, TL_FVF_UV, TL_FVF_NORMAL
+ * \return Returns a new tlTrimesh object, which needs to be deleted with tlDeleteTrimesh. NULL on error.
+ */
+TRIMESH_LOADER_API tlTrimesh *tlLoadTrimeshEx(
+	const char *filename,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format );
+
+/** Load many 3DS or OBJ files at once. Where io_uring is available the files
+ * and their material libraries are opened and read many at a time and parsed
+ * on worker threads, otherwise the files are loaded on a pool of threads.
+ * \param filenames count file names
+ * \param count number of files
+ * \param trimeshes receives count tlTrimesh objects, NULL for files that failed to load
+ * \param open Opens the files, NULL for the file system (and io_uring)
+ * \param open_data Passed to open
+ * \param vertex_format Defines the vertex format. any format combination of TL_FVF_XYZ, TL_FVF_UV, TL_FVF_NORMAL
+ * \param thread_count parser threads, 0 for one per processor
+ * \return Returns the number of files loaded.
+ */
+TRIMESH_LOADER_API size_t tlLoadTrimeshBatch(
+	const char *const *filenames,
+	size_t count,
+	tlTrimesh **trimeshes,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format,
+	unsigned int thread_count );
+
+/** Create a material library cache. Libraries opened with tlReaderOpen or
+ * tlReaderOpenMap are looked up by their resolved path, those of any other
+ * open function by name, open function and open_data. A library that changed
+ * on disk (modification time or size) is parsed again.
+ * \return Returns a new cache, which needs to be deleted with tlMaterialCacheDestroy. NULL on error.
+ */
+TRIMESH_LOADER_API tlMaterialCache *tlMaterialCacheCreate( void );
+
+/** Delete a material library cache. Trimeshes keep the libraries they use.
+ * \param cache Previously created cache, not set with tlSetMaterialCache any more
+ */
+TRIMESH_LOADER_API void tlMaterialCacheDestroy( tlMaterialCache *cache );
+
+/** Make all OBJ loaders of the process take their material libraries from a
+ * cache. The cache is thread safe, loaders on several threads share it, but
+ * set it only while no file is being loaded.
+ * \param cache The cache to use, NULL to parse material libraries for every file
+ */
+TRIMESH_LOADER_API void tlSetMaterialCache( tlMaterialCache *cache );
+
 /** Delete an previously loaded tlTrimesh object
  * \param trimesh Previously loaded tlTrimesh object
  */
@@ -21,11 +21,22 @@
  *    distribution.
  */
 
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
 #include "trimeshloader/tl3ds.h"
+#include "tlarena.h"
 
 #include <string.h>
 #include <stdlib.h>
 
+/* the host byte order, configure knows it, the compiler usually does too */
+#if defined(WORDS_BIGENDIAN) \
+	|| (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	#define TDS_BIG_ENDIAN
+#endif
+
 /*----------------------------------------------------------------------------*/
 typedef enum tl3dsParsingState
 {
@@ -54,7 +65,7 @@ typedef enum tl3dsParsingState
 typedef struct tl3dsObject
 {
 	char *name;
-	unsigned int index, count;
+	size_t index, count;
 } tl3dsObject;
 
 /*----------------------------------------------------------------------------*/
@@ -68,12 +79,15 @@ typedef struct tl3dsMaterial
 typedef struct tl3dsMaterialReference
 {
 	char *name;
-	unsigned int face_index, face_count;
+	size_t face_index, face_count;
 } tl3dsMaterialReference;
 
 /*----------------------------------------------------------------------------*/
 struct tl3dsState
 {
+	/* names live here, they are freed all at once on reset */
+	tl_arena arena;
+
 	unsigned short chunk_id;
 	unsigned int chunk_length;
 
@@ -87,72 +101,68 @@ struct tl3dsState
 	tl3dsParsingState parsing_state;
 
 	float *point_buffer;
-	unsigned int point_buffer_size;
-	unsigned int point_count;
-    unsigned int last_point_index;
+	size_t point_buffer_size;
+	size_t point_count;
+    size_t last_point_index;
 
 	float *texcoord_buffer;
-	unsigned int texcoord_buffer_size;
-	unsigned int texcoord_count;
+	size_t texcoord_buffer_size;
+	size_t texcoord_count;
 
-	unsigned short *face_buffer;
-	unsigned int face_buffer_size;
-	unsigned int face_count;
+	unsigned int *face_buffer;
+	size_t face_buffer_size;
+	size_t face_count;
 
 	tl3dsMaterial *material_buffer;
-	unsigned int material_count;
+	size_t material_buffer_size;
+	size_t material_count;
 
 	tl3dsMaterialReference *material_reference_buffer;
-	unsigned int material_reference_count;
-	unsigned int last_material_face;
+	size_t material_reference_buffer_size;
+	size_t material_reference_count;
+	size_t last_material_face;
+
+	tl3dsObject *object_buffer;
+	size_t object_buffer_size;
+	size_t object_count;
 
-	tl3dsObject **object_buffer;
-	unsigned int object_count;
+	/* set by tl3dsSetCallbacks, nothing but the point count is stored then */
+	int use_callbacks;
+	tl3dsCallbacks callbacks;
 
+	/* material group name until its face count is read */
+	char *group_name;
+	size_t group_name_size;
 };
 
 
 
+#ifdef TDS_BIG_ENDIAN
 /*----------------------------------------------------------------------------*/
-static unsigned int tds_le()
+/* 3DS files are little endian, swap on the rest */
+static void tds_swap( char *ptr, size_t size )
 {
-	const char endian[8] = { 1, 0, 0, 0, 0, 0, 0, 0 };
-	unsigned int i = *((unsigned int *)endian);
+	size_t i;
 
-	/* LE uint64: i = 1 */
-	/* LE uint32: i = 1 */
-	/* LE uint16: i = 1 */
-
-	/* BE uint32: i > 1 */
-	/* BE uint32: i > 1 */
-	/* BE uint16: i > 1 */
-
-	if( i == 1 )
-		return 1;
-	else
-		return 0;
+	for( i = 0; i < size / 2; i++ )
+	{
+		char c = ptr[i];
+		ptr[i] = ptr[size - 1 - i];
+		ptr[size - 1 - i] = c;
+	}
 }
+#endif
+
 
 /*----------------------------------------------------------------------------*/
 static float tds_read_le_float( const char *ptr )
 {
-	float f = 0;
-	char *fptr = (char *)&f;
+	float f;
 
-	if( tds_le() )
-	{
-		fptr[0] = ptr[0];
-		fptr[1] = ptr[1];
-		fptr[2] = ptr[2];
-		fptr[3] = ptr[3];
-	}
-	else
-	{
-		fptr[0] = ptr[3];
-		fptr[1] = ptr[2];
-		fptr[2] = ptr[1];
-		fptr[3] = ptr[0];
-	}
+	memcpy( &f, ptr, 4 );
+#ifdef TDS_BIG_ENDIAN
+	tds_swap( (char *)&f, 4 );
+#endif
 
 	return f;
 }
@@ -161,47 +171,31 @@ static float tds_read_le_float( const char *ptr )
 /*----------------------------------------------------------------------------*/
 static unsigned short tds_read_le_ushort( const char *ptr )
 {
-	unsigned short s = 0;
-	char *sptr = (char *)&s;
-
-	if( tds_le() )
-	{
-		sptr[0] = ptr[0];
-		sptr[1] = ptr[1];
-	}
-	else
-	{
-		sptr[0] = ptr[1];
-		sptr[1] = ptr[0];
-	}
-
-	return s;
-
+	return (unsigned short)((unsigned char)ptr[0] | ((unsigned char)ptr[1] << 8));
 }
 
 /*----------------------------------------------------------------------------*/
 static unsigned int tds_read_le_uint( const char *ptr )
 {
-	unsigned int i = 0;
-	char *iptr = (char *)&i;
-
-	if( tds_le() )
-	{
-		iptr[0] = ptr[0];
-		iptr[1] = ptr[1];
-		iptr[2] = ptr[2];
-		iptr[3] = ptr[3];
-	}
-	else
-	{
-		iptr[0] = ptr[3];
-		iptr[1] = ptr[2];
-		iptr[2] = ptr[1];
-		iptr[3] = ptr[0];
-	}
+	return (unsigned int)(unsigned char)ptr[0]
+		| ((unsigned int)(unsigned char)ptr[1] << 8)
+		| ((unsigned int)(unsigned char)ptr[2] << 16)
+		| ((unsigned int)(unsigned char)ptr[3] << 24);
+}
 
-	return i;
 
+/*----------------------------------------------------------------------------*/
+/* count floats in a row, as a whole where the byte order matches */
+static void tds_read_le_floats( float *floats, const char *ptr, size_t count )
+{
+#ifdef TDS_BIG_ENDIAN
+	size_t i;
+
+	for( i = 0; i < count; i++ )
+		floats[i] = tds_read_le_float( ptr + i * 4 );
+#else
+	memcpy( floats, ptr, count * 4 );
+#endif
 }
 
 
@@ -241,20 +235,60 @@ static void tds_buffer_add( tl3dsState *state, char c )
 	state->buffer_length++;
 }
 
+/*----------------------------------------------------------------------------*/
+/* grows a buffer to at least count elements, doubling to keep copies rare;
+ * a size that does not fit a size_t leaves the buffer as it is */
+static void *tds_grow(
+	void *buffer,
+	size_t *buffer_size,
+	size_t count,
+	size_t element_size )
+{
+	size_t needed_size, new_size;
+	void *new_buffer;
+
+	if( count > (size_t)-1 / element_size )
+		return buffer;
+
+	needed_size = count * element_size;
+	if( needed_size <= *buffer_size )
+		return buffer;
+
+	new_size = *buffer_size <= (size_t)-1 / 2 ? *buffer_size * 2 : (size_t)-1;
+	if( new_size < needed_size )
+		new_size = needed_size;
+
+	new_buffer = realloc( buffer, new_size );
+	if( new_buffer == NULL )
+		return buffer;
+
+	*buffer_size = new_size;
+	return new_buffer;
+}
+
+
 /*----------------------------------------------------------------------------*/
 static void tds_material_buffer_add( tl3dsState *state, char *name )
 {
     float           defAmbient[4]   = {1.0, 1.0, 1.0, 1.0};
     float           defSpecular[4]  = {0.0, 0.0, 0.0, 1.0};
-	unsigned int    new_size    = (state->material_count + 1 ) * sizeof(tl3dsMaterial);
-	tl3dsMaterial   *new_buffer = realloc( state->material_buffer, new_size );
+	size_t          new_size    = (state->material_count + 1 ) * sizeof(tl3dsMaterial);
 
-	if( new_buffer == NULL )
+	if( state->use_callbacks )
+	{
+		if( state->callbacks.on_material )
+			state->callbacks.on_material( state->callbacks.user_data, name );
+		return;
+	}
+
+	state->material_buffer = tds_grow( state->material_buffer,
+		&state->material_buffer_size, state->material_count + 1, sizeof(tl3dsMaterial) );
+
+	if( state->material_buffer_size < new_size )
         return;
 
-	state->material_buffer = new_buffer;
-	state->material_buffer[state->material_count].name = malloc( strlen( name ) + 1 );
-	strcpy(state->material_buffer[state->material_count].name, name);
+	state->material_buffer[state->material_count].name
+		= tl_arena_copy_span( &state->arena, name, name + strlen( name ) );
 
     memcpy(state->material_buffer[state->material_count].ambient, defAmbient, sizeof(float) * 4);
     memcpy(state->material_buffer[state->material_count].diffuse, defAmbient, sizeof(float) * 4);
@@ -267,7 +301,25 @@ static void tds_material_buffer_add( tl3dsState *state, char *name )
 /*----------------------------------------------------------------------------*/
 static void tds_material_set_property( tl3dsState *state, float *props )
 {
-    int last_material_index  = state->material_count - 1;
+    size_t last_material_index  = state->material_count - 1;
+
+	if( state->use_callbacks )
+	{
+		int property = 0;
+
+		switch( state->chunk_id )
+		{
+		case 0xA010: property = TL_3DS_MATERIAL_AMBIENT; break;
+		case 0xA020: property = TL_3DS_MATERIAL_DIFFUSE; break;
+		case 0xA030: property = TL_3DS_MATERIAL_SPECULAR; break;
+		case 0xA040: property = TL_3DS_MATERIAL_SHININESS; break;
+		case 0xA050: property = TL_3DS_MATERIAL_TRANSPARENCY; break;
+		}
+
+		if( property && state->callbacks.on_material_property )
+			state->callbacks.on_material_property( state->callbacks.user_data, property, props );
+		return;
+	}
 
     switch (state->chunk_id)
     {
@@ -298,22 +350,35 @@ static void tds_material_set_property( tl3dsState *state, float *props )
 /*----------------------------------------------------------------------------*/
 static void tds_material_reference_buffer_add( tl3dsState *state, char *name)
 {
-	unsigned int new_size = (state->material_reference_count + 1 ) * sizeof(tl3dsMaterialReference);
-	tl3dsMaterialReference *new_buffer = realloc( state->material_reference_buffer, new_size );
+	size_t new_size = (state->material_reference_count + 1 ) * sizeof(tl3dsMaterialReference);
 
-	if( new_buffer == NULL )
+	/* reported with the face count that follows the name */
+	if( state->use_callbacks )
+	{
+		size_t length = strlen( name ) + 1;
+
+		state->group_name = tds_grow( state->group_name, &state->group_name_size, length, 1 );
+		if( state->group_name_size >= length )
+			memcpy( state->group_name, name, length );
+		return;
+	}
+
+	state->material_reference_buffer = tds_grow( state->material_reference_buffer,
+		&state->material_reference_buffer_size, state->material_reference_count + 1,
+		sizeof(tl3dsMaterialReference) );
+
+	if( state->material_reference_buffer_size < new_size )
         return;
 
-	state->material_reference_buffer = new_buffer;
-	state->material_reference_buffer[state->material_reference_count].name = malloc( strlen(name) + 1 );
-	strcpy( state->material_reference_buffer[state->material_reference_count].name, name );
+	state->material_reference_buffer[state->material_reference_count].name
+		= tl_arena_copy_span( &state->arena, name, name + strlen( name ) );
 
 	state->material_reference_count++;
 }
 
 
 /*----------------------------------------------------------------------------*/
-static void tds_material_reference_set_range( tl3dsState *state, unsigned int face_index, unsigned int face_count )
+static void tds_material_reference_set_range( tl3dsState *state, size_t face_index, size_t face_count )
 {
 	if( state->material_reference_count > 0 )
 	{
@@ -329,28 +394,30 @@ static int tds_object_buffer_add(
 	const char *name,
 	unsigned int name_length )
 {
-	tl3dsObject **new_object_buffer = 0;
-	unsigned int new_object_count = state->object_count + 1;
+	size_t new_object_count = state->object_count + 1;
+
+	if( state->use_callbacks )
+	{
+		if( state->callbacks.on_object )
+			state->callbacks.on_object( state->callbacks.user_data, name );
+		return 0;
+	}
 
-	new_object_buffer = (tl3dsObject **)realloc(
-		state->object_buffer,
-		sizeof(tl3dsObject *) * new_object_count );
+	state->object_buffer = tds_grow( state->object_buffer,
+		&state->object_buffer_size, new_object_count, sizeof(tl3dsObject) );
 
-	if( new_object_buffer )
+	if( state->object_buffer_size >= sizeof(tl3dsObject) * new_object_count )
 	{
-		/* create the new object */
-		tl3dsObject *new_object = (tl3dsObject *)malloc( sizeof(tl3dsObject) );
+		/* the new object */
+		tl3dsObject *new_object = &state->object_buffer[ new_object_count - 1 ];
 		memset(	new_object, 0, sizeof(tl3dsObject) );
 
 		/* copy the name */
-		new_object->name = (char *)malloc( name_length );
-		memcpy( new_object->name, name, name_length );
-
-		/* add the new object */
-		new_object_buffer[ new_object_count - 1 ] = new_object;
+		new_object->name = tl_arena_alloc( &state->arena, name_length );
+		if( new_object->name )
+			memcpy( new_object->name, name, name_length );
 
 		/* update state */
-		state->object_buffer = new_object_buffer;
 		state->object_count = new_object_count;
 
 		return 0;
@@ -361,23 +428,29 @@ static int tds_object_buffer_add(
 
 
 /*----------------------------------------------------------------------------*/
-static void tds_point_buffer_grow( tl3dsState *state, unsigned int count )
+static void tds_point_buffer_grow( tl3dsState *state, size_t count )
 {
-	unsigned int new_size = (state->point_count + count ) * 3 * sizeof(float);
+	if( state->use_callbacks )
+		return;
 
-	float *new_buffer = realloc( state->point_buffer, new_size );
-	if( new_buffer )
-	{
-		state->point_buffer = new_buffer;
-		state->point_buffer_size = new_size;
-	}
+	state->point_buffer = tds_grow( state->point_buffer, &state->point_buffer_size,
+		state->point_count + count, 3 * sizeof(float) );
 }
 
 
 /*----------------------------------------------------------------------------*/
 static void tds_point_buffer_add( tl3dsState *state, float x, float y, float z )
 {
-	unsigned int new_size = (state->point_count + 1 ) * 3 * sizeof(float);
+	size_t new_size = (state->point_count + 1 ) * 3 * sizeof(float);
+
+	/* faces still need the count to make their indices absolute */
+	if( state->use_callbacks )
+	{
+		if( state->callbacks.on_vertex )
+			state->callbacks.on_vertex( state->callbacks.user_data, x, y, z );
+		state->point_count++;
+		return;
+	}
 
 	if( state->point_buffer_size < new_size )
 		return;
@@ -390,23 +463,27 @@ static void tds_point_buffer_add( tl3dsState *state, float x, float y, float z )
 
 
 /*----------------------------------------------------------------------------*/
-static void tds_texcoord_buffer_grow( tl3dsState *state, unsigned int count )
+static void tds_texcoord_buffer_grow( tl3dsState *state, size_t count )
 {
-	unsigned int new_size = (state->texcoord_count + count ) * 2 * sizeof(float);
-	float *new_buffer = realloc( state->texcoord_buffer, new_size );
+	if( state->use_callbacks )
+		return;
 
-	if( new_buffer )
-	{
-		state->texcoord_buffer = new_buffer;
-		state->texcoord_buffer_size = new_size;
-	}
+	state->texcoord_buffer = tds_grow( state->texcoord_buffer, &state->texcoord_buffer_size,
+		state->texcoord_count + count, 2 * sizeof(float) );
 }
 
 
 /*----------------------------------------------------------------------------*/
 static void tds_texcoord_buffer_add( tl3dsState *state, float u, float v )
 {
-	unsigned int new_size = (state->texcoord_count + 1 ) * 2 * sizeof(float);
+	size_t new_size = (state->texcoord_count + 1 ) * 2 * sizeof(float);
+
+	if( state->use_callbacks )
+	{
+		if( state->callbacks.on_texcoord )
+			state->callbacks.on_texcoord( state->callbacks.user_data, u, v );
+		return;
+	}
 
 	if( state->texcoord_buffer_size < new_size )
 		return;
@@ -418,17 +495,13 @@ static void tds_texcoord_buffer_add( tl3dsState *state, float u, float v )
 
 
 /*----------------------------------------------------------------------------*/
-static void tds_face_buffer_grow( tl3dsState *state, unsigned int count )
+static void tds_face_buffer_grow( tl3dsState *state, size_t count )
 {
-	unsigned int new_size
-		= (state->face_count + count ) * 3 * sizeof(unsigned short);
+	if( state->use_callbacks )
+		return;
 
-	unsigned short *new_buffer = realloc( state->face_buffer, new_size );
-	if( new_buffer )
-	{
-		state->face_buffer = new_buffer;
-		state->face_buffer_size = new_size;
-	}
+	state->face_buffer = tds_grow( state->face_buffer, &state->face_buffer_size,
+		state->face_count + count, 3 * sizeof(unsigned int) );
 }
 
 
@@ -439,19 +512,143 @@ static void tds_face_buffer_add(
 	unsigned short b,
 	unsigned short c )
 {
-	unsigned int new_size
-		= (state->face_count + 1 ) * 3 * sizeof(unsigned short);
+	size_t new_size
+		= (state->face_count + 1 ) * 3 * sizeof(unsigned int);
+
+	if( state->use_callbacks )
+	{
+		if( state->callbacks.on_face )
+			state->callbacks.on_face( state->callbacks.user_data,
+				a + state->last_point_index,
+				b + state->last_point_index,
+				c + state->last_point_index );
+		return;
+	}
 
 	if( state->face_buffer_size < new_size )
 		return;
 
-	state->face_buffer[state->face_count * 3] = a + state->last_point_index;
-	state->face_buffer[state->face_count * 3 + 1] = b + state->last_point_index;
-	state->face_buffer[state->face_count * 3 + 2] = c + state->last_point_index;
+	state->face_buffer[state->face_count * 3] = (unsigned int)(a + state->last_point_index);
+	state->face_buffer[state->face_count * 3 + 1] = (unsigned int)(b + state->last_point_index);
+	state->face_buffer[state->face_count * 3 + 2] = (unsigned int)(c + state->last_point_index);
 	state->face_count++;
 }
 
 
+/*----------------------------------------------------------------------------*/
+/* whole items of the current array in length bytes, a split item is left
+ * to the byte buffer */
+static size_t tds_item_count( tl3dsState *state, size_t length, size_t item_size )
+{
+	size_t count = length / item_size;
+
+	if( count > state->item_count - state->counter )
+		count = state->item_count - state->counter;
+
+	return count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the read functions decode whole items from the input, returning the bytes used */
+static size_t tds_read_points( tl3dsState *state, const char *ptr, size_t length )
+{
+	size_t count = tds_item_count( state, length, 12 ), i;
+
+	if( !state->use_callbacks
+		&& state->point_buffer_size >= (state->point_count + count) * 3 * sizeof(float) )
+	{
+		tds_read_le_floats( state->point_buffer + state->point_count * 3, ptr, count * 3 );
+		state->point_count += count;
+	}
+	else
+	{
+		for( i = 0; i < count; i++ )
+			tds_point_buffer_add( state,
+				tds_read_le_float( ptr + i * 12 ),
+				tds_read_le_float( ptr + i * 12 + 4 ),
+				tds_read_le_float( ptr + i * 12 + 8 ) );
+	}
+
+	state->counter += count;
+
+	return count * 12;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t tds_read_texcoords( tl3dsState *state, const char *ptr, size_t length )
+{
+	size_t count = tds_item_count( state, length, 8 ), i;
+
+	if( !state->use_callbacks
+		&& state->texcoord_buffer_size >= (state->texcoord_count + count) * 2 * sizeof(float) )
+	{
+		tds_read_le_floats( state->texcoord_buffer + state->texcoord_count * 2, ptr, count * 2 );
+		state->texcoord_count += count;
+	}
+	else
+	{
+		for( i = 0; i < count; i++ )
+			tds_texcoord_buffer_add( state,
+				tds_read_le_float( ptr + i * 8 ),
+				tds_read_le_float( ptr + i * 8 + 4 ) );
+	}
+
+	state->counter += count;
+
+	return count * 8;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the fourth value of a face are its edge flags */
+static size_t tds_read_faces( tl3dsState *state, const char *ptr, size_t length )
+{
+	size_t count = tds_item_count( state, length, 8 ), i;
+
+	if( !state->use_callbacks
+		&& state->face_buffer_size >= (state->face_count + count) * 3 * sizeof(unsigned int) )
+	{
+		unsigned int *face = state->face_buffer + state->face_count * 3;
+		unsigned int offset = (unsigned int)state->last_point_index;
+
+		for( i = 0; i < count; i++, ptr += 8, face += 3 )
+		{
+			face[0] = tds_read_le_ushort( ptr ) + offset;
+			face[1] = tds_read_le_ushort( ptr + 2 ) + offset;
+			face[2] = tds_read_le_ushort( ptr + 4 ) + offset;
+		}
+
+		state->face_count += count;
+	}
+	else
+	{
+		for( i = 0; i < count; i++ )
+			tds_face_buffer_add( state,
+				tds_read_le_ushort( ptr + i * 8 ),
+				tds_read_le_ushort( ptr + i * 8 + 2 ),
+				tds_read_le_ushort( ptr + i * 8 + 4 ) );
+	}
+
+	state->counter += count;
+
+	return count * 8;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the rest of a chunk that is skipped */
+static size_t tds_skip_length( tl3dsState *state )
+{
+	if( state->parsing_state != TDS_STATE_SKIP_CHUNK
+		|| state->counter >= state->chunk_length )
+		return 0;
+
+	return state->chunk_length - state->counter;
+}
+
+
 /*----------------------------------------------------------------------------*/
 tl3dsState *tl3dsCreateState()
 {
@@ -470,27 +667,20 @@ tl3dsState *tl3dsCreateState()
 /*----------------------------------------------------------------------------*/
 int tl3dsResetState( tl3dsState *state )
 {
-	unsigned int i;
+	tl3dsCallbacks callbacks = state->callbacks;
+	int use_callbacks = state->use_callbacks;
+
+	/* all names at once */
+	tl_arena_release( &state->arena );
 
 	if( state->buffer )
 		free( state->buffer );
 
-	if( state->object_buffer )
-	{
-		for( i = 0; i < state->object_count; i++ )
-		{
-			tl3dsObject *obj = state->object_buffer[i];
-			if( obj == 0 )
-				continue;
-
-			if( obj->name )
-				free( obj->name );
-
-			free( obj );
-		}
+	if( state->group_name )
+		free( state->group_name );
 
+	if( state->object_buffer )
 		free( state->object_buffer );
-	}
 
 	if( state->point_buffer )
 		free( state->point_buffer );
@@ -507,8 +697,11 @@ int tl3dsResetState( tl3dsState *state )
 	if( state->material_reference_buffer )
 		free( state->material_reference_buffer );
 
+	/* the callbacks outlive a reset */
 	memset( state, 0, sizeof(tl3dsState) );
 
+	state->callbacks = callbacks;
+	state->use_callbacks = use_callbacks;
 	state->parsing_state = TDS_STATE_READ_CHUNK_ID;
 
 	return 0;
@@ -530,10 +723,10 @@ void tl3dsDestroyState( tl3dsState *state )
 int tl3dsParse(
 	tl3dsState *state,
 	const char *buffer,
-	unsigned int length,
+	size_t length,
 	int last )
 {
-	unsigned int i = 0;
+	size_t i = 0;
 
 	if( state == NULL )
 		return 1;
@@ -675,6 +868,24 @@ int tl3dsParse(
 			break;
 
 		case TDS_STATE_READ_POINTS:
+			/* whole points straight from the input */
+			if( state->buffer_length == 0 && state->counter < state->item_count )
+			{
+				size_t used = tds_read_points( state, buffer + i, length - i );
+
+				if( used > 0 )
+				{
+					i += used;
+
+					if( state->counter >= state->item_count )
+					{
+						state->parsing_state = TDS_STATE_READ_CHUNK_ID;
+						state->last_point_index = state->point_count - state->item_count;
+					}
+					break;
+				}
+			}
+
 			tds_buffer_add( state, c );
 
 			if( state->buffer_length == 12 )
@@ -715,6 +926,20 @@ int tl3dsParse(
 			break;
 
 		case TDS_STATE_READ_TEXCOORDS:
+			if( state->buffer_length == 0 && state->counter < state->item_count )
+			{
+				size_t used = tds_read_texcoords( state, buffer + i, length - i );
+
+				if( used > 0 )
+				{
+					i += used;
+
+					if( state->counter >= state->item_count )
+						state->parsing_state = TDS_STATE_READ_CHUNK_ID;
+					break;
+				}
+			}
+
 			tds_buffer_add( state, c );
 
 			if( state->buffer_length == 8 )
@@ -742,13 +967,14 @@ int tl3dsParse(
 				state->item_count = tds_read_le_ushort( state->buffer );
 				tds_face_buffer_grow( state, state->item_count );
 
-				state->object_buffer[state->object_count-1]->count
-					= state->item_count;
+				if( state->object_count > 0 )
+					state->object_buffer[state->object_count-1].count
+						= state->item_count;
 
 				if( state->object_count > 1 )
-					state->object_buffer[state->object_count - 1]->index
-						= state->object_buffer[state->object_count-2]->index
-						+  state->object_buffer[state->object_count-2]->count;
+					state->object_buffer[state->object_count - 1].index
+						= state->object_buffer[state->object_count-2].index
+						+  state->object_buffer[state->object_count-2].count;
 
 
 				state->parsing_state = TDS_STATE_READ_FACES;
@@ -763,6 +989,20 @@ int tl3dsParse(
 			break;
 
 		case TDS_STATE_READ_FACES:
+			if( state->buffer_length == 0 && state->counter < state->item_count )
+			{
+				size_t used = tds_read_faces( state, buffer + i, length - i );
+
+				if( used > 0 )
+				{
+					i += used;
+
+					if( state->counter >= state->item_count )
+						state->parsing_state = TDS_STATE_READ_CHUNK_ID;
+					break;
+				}
+			}
+
 			tds_buffer_add( state, c );
 
 			if( state->buffer_length == 8 )
@@ -871,6 +1111,10 @@ int tl3dsParse(
 			{
 				state->item_count = tds_read_le_ushort( state->buffer );
                 tds_material_reference_set_range(state, state->last_material_face, state->item_count);
+
+				if( state->use_callbacks && state->callbacks.on_usemtl && state->group_name )
+					state->callbacks.on_usemtl( state->callbacks.user_data,
+						state->group_name, state->item_count );
                 state->last_material_face += state->item_count;
 
 				state->parsing_state = TDS_STATE_READ_MATERIAL_LIST;
@@ -908,11 +1152,21 @@ int tl3dsParse(
 			break;
 
 		case TDS_STATE_SKIP_CHUNK:
-			++i;
-			++state->counter;
+		{
+			/* as much of the chunk as the input holds, at least a byte */
+			size_t skip = tds_skip_length( state );
+
+			if( skip == 0 )
+				skip = 1;
+			if( skip > length - i )
+				skip = length - i;
+
+			i += skip;
+			state->counter += (unsigned int)skip;
 			if( state->counter >= state->chunk_length )
 				state->parsing_state = TDS_STATE_READ_CHUNK_ID;
 			break;
+		}
 
 		default:
 			++i;
@@ -928,113 +1182,308 @@ int tl3dsParse(
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsObjectCount( tl3dsState *state )
+size_t tl3dsSkipLength( tl3dsState *state )
 {
 	if( state == NULL )
 		return 0;
 
-	if( state->parsing_state != TDS_STATE_DONE )
-		return 0;
-
-	return state->object_count;
+	return tds_skip_length( state );
 }
 
 
 /*----------------------------------------------------------------------------*/
-const char *tl3dsObjectName( tl3dsState *state, unsigned int object )
+int tl3dsSkip( tl3dsState *state, size_t length )
 {
-	if( state == NULL )
-		return NULL;
-
-	if( state->parsing_state != TDS_STATE_DONE )
-		return NULL;
+	if( state == NULL || length > tds_skip_length( state ) )
+		return 1;
 
-	if( object >= state->object_count )
-		return NULL;
+	state->counter += (unsigned int)length;
+	if( state->counter >= state->chunk_length )
+		state->parsing_state = TDS_STATE_READ_CHUNK_ID;
 
-	return state->object_buffer[object]->name;
+	return 0;
 }
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsObjectFaceCount( tl3dsState *state, unsigned int object )
+static int tds_reserve(
+	void **buffer,
+	size_t *buffer_size,
+	size_t count,
+	size_t element_size )
 {
+	void *new_buffer;
 
-	if( state == NULL )
-		return 0;
+	if( count > (size_t)-1 / element_size )
+		return 1;
 
-	if( state->parsing_state != TDS_STATE_DONE )
+	if( count == 0 || count * element_size <= *buffer_size )
 		return 0;
 
-	if( object >= state->object_count )
-		return 0;
+	new_buffer = realloc( *buffer, count * element_size );
+	if( new_buffer == NULL )
+		return 1;
+
+	*buffer = new_buffer;
+	*buffer_size = count * element_size;
 
-	return state->object_buffer[object]->count;
+	return 0;
 }
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsObjectFaceIndex( tl3dsState *state, unsigned int object )
+int tl3dsReserve(
+	tl3dsState *state,
+	size_t points,
+	size_t texcoords,
+	size_t faces )
 {
+	int result = 0;
 
 	if( state == NULL )
-		return 0;
+		return 1;
 
-	if( state->parsing_state != TDS_STATE_DONE )
+	/* nothing to reserve when nothing is stored */
+	if( state->use_callbacks )
 		return 0;
 
-	if( object >= state->object_count )
-		return 0;
+	result |= tds_reserve( (void **)&state->point_buffer,
+		&state->point_buffer_size, points, 3 * sizeof(float) );
+	result |= tds_reserve( (void **)&state->texcoord_buffer,
+		&state->texcoord_buffer_size, texcoords, 2 * sizeof(float) );
+	result |= tds_reserve( (void **)&state->face_buffer,
+		&state->face_buffer_size, faces, 3 * sizeof(unsigned int) );
 
-	return state->object_buffer[object]->index;
+	return result;
 }
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsMaterialCount( tl3dsState *state )
+static size_t tds_estimate_count( double count )
 {
-	if( state == NULL )
-		return 0;
-
-	if( state->parsing_state != TDS_STATE_DONE )
-		return 0;
-
-    return state->material_count;
+	return count < (double)(size_t)-1 ? (size_t)count : (size_t)-1;
 }
 
 
 /*----------------------------------------------------------------------------*/
-const char *tl3dsMaterialName(   tl3dsState *state,
-                                 unsigned int material )
+int tl3dsReserveEstimate(
+	tl3dsState *state,
+	const char *buffer,
+	size_t length,
+	size_t total_length )
 {
-	if( state == NULL )
-		return NULL;
+	double points = 0, texcoords = 0, faces = 0, scale;
+	size_t offset = 0, covered = 0;
 
-	if( state->parsing_state != TDS_STATE_DONE )
-		return NULL;
+	if( state == NULL || buffer == NULL )
+		return 1;
 
-	if( material >= state->material_count )
-		return NULL;
+	if( total_length < length )
+		total_length = length;
 
-    return state->material_buffer[material].name;
-}
+	/* walk the chunk headers, the counts are stored in front of the arrays */
+	while( length >= 6 && offset <= length - 6 )
+	{
+		unsigned short id = tds_read_le_ushort( buffer + offset );
+		unsigned int chunk_length = tds_read_le_uint( buffer + offset + 2 );
 
-/*----------------------------------------------------------------------------*/
-int tl3dsGetMaterial(    tl3dsState *state,
-                         unsigned int index,
-                         float *ambient, float *diffuse, float *specular,
-                         float *shininess )
-{
-	if( state == NULL )
-		return 1;
+		if( id == 0x4d4d || id == 0x3d3d || id == 0x4100 )
+		{
+			/* containers, descend */
+			offset += 6;
+			continue;
+		}
 
-	if( index >= state->material_count )
-		return 1;
+		if( id == 0x4000 )
+		{
+			/* object name, then the sub chunks */
+			const char *name_end;
 
-	if( ambient )
-		memcpy(ambient, state->material_buffer[index].ambient, sizeof(float) * 4);
+			/* the counts of an object are in front of its arrays */
+			if( chunk_length <= (size_t)-1 - offset && offset + chunk_length > covered )
+				covered = offset + chunk_length;
 
-	if( diffuse )
+			offset += 6;
+			name_end = memchr( buffer + offset, 0, length - offset );
+			if( name_end == NULL )
+				break;
+
+			offset = (size_t)(name_end - buffer) + 1;
+			continue;
+		}
+
+		if( (id == 0x4110 || id == 0x4140 || id == 0x4120) && offset + 8 <= length )
+		{
+			unsigned short count = tds_read_le_ushort( buffer + offset + 6 );
+
+			if( id == 0x4110 )
+				points += count;
+			else if( id == 0x4140 )
+				texcoords += count;
+			else
+				faces += count;
+		}
+
+		/* broken chunk */
+		if( chunk_length < 6 || chunk_length > (size_t)-1 - offset )
+			break;
+
+		offset += chunk_length;
+	}
+
+	/* the counts describe everything up to there, scale the rest from it */
+	if( offset > covered )
+		covered = offset;
+
+	if( covered == 0 )
+		return 0;
+
+	if( covered < total_length )
+	{
+		scale = (double)total_length / (double)covered;
+		points *= scale;
+		texcoords *= scale;
+		faces *= scale;
+	}
+
+	return tl3dsReserve( state,
+		tds_estimate_count( points ),
+		tds_estimate_count( texcoords ),
+		tds_estimate_count( faces ) );
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tl3dsSetCallbacks(
+	tl3dsState *state,
+	const tl3dsCallbacks *callbacks )
+{
+	if( state == NULL )
+		return 1;
+
+	if( callbacks != NULL )
+	{
+		state->callbacks = *callbacks;
+		state->use_callbacks = 1;
+	}
+	else
+	{
+		memset( &state->callbacks, 0, sizeof(tl3dsCallbacks) );
+		state->use_callbacks = 0;
+	}
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tl3dsObjectCount( tl3dsState *state )
+{
+	if( state == NULL )
+		return 0;
+
+	if( state->parsing_state != TDS_STATE_DONE )
+		return 0;
+
+	return state->object_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+const char *tl3dsObjectName( tl3dsState *state, size_t object )
+{
+	if( state == NULL )
+		return NULL;
+
+	if( state->parsing_state != TDS_STATE_DONE )
+		return NULL;
+
+	if( object >= state->object_count )
+		return NULL;
+
+	return state->object_buffer[object].name;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tl3dsObjectFaceCount( tl3dsState *state, size_t object )
+{
+
+	if( state == NULL )
+		return 0;
+
+	if( state->parsing_state != TDS_STATE_DONE )
+		return 0;
+
+	if( object >= state->object_count )
+		return 0;
+
+	return state->object_buffer[object].count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tl3dsObjectFaceIndex( tl3dsState *state, size_t object )
+{
+
+	if( state == NULL )
+		return 0;
+
+	if( state->parsing_state != TDS_STATE_DONE )
+		return 0;
+
+	if( object >= state->object_count )
+		return 0;
+
+	return state->object_buffer[object].index;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tl3dsMaterialCount( tl3dsState *state )
+{
+	if( state == NULL )
+		return 0;
+
+	if( state->parsing_state != TDS_STATE_DONE )
+		return 0;
+
+    return state->material_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+const char *tl3dsMaterialName(   tl3dsState *state,
+                                 size_t material )
+{
+	if( state == NULL )
+		return NULL;
+
+	if( state->parsing_state != TDS_STATE_DONE )
+		return NULL;
+
+	if( material >= state->material_count )
+		return NULL;
+
+    return state->material_buffer[material].name;
+}
+
+/*----------------------------------------------------------------------------*/
+int tl3dsGetMaterial(    tl3dsState *state,
+                         size_t index,
+                         float *ambient, float *diffuse, float *specular,
+                         float *shininess )
+{
+	if( state == NULL )
+		return 1;
+
+	if( index >= state->material_count )
+		return 1;
+
+	if( ambient )
+		memcpy(ambient, state->material_buffer[index].ambient, sizeof(float) * 4);
+
+	if( diffuse )
     	memcpy(diffuse, state->material_buffer[index].diffuse, sizeof(float) * 4);
 
     if( specular )
@@ -1047,7 +1496,7 @@ int tl3dsGetMaterial(    tl3dsState *state,
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsMaterialReferenceCount( tl3dsState *state )
+size_t tl3dsMaterialReferenceCount( tl3dsState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1057,7 +1506,7 @@ unsigned int tl3dsMaterialReferenceCount( tl3dsState *state )
 
 /*----------------------------------------------------------------------------*/
 const char *tl3dsMaterialReferenceName(   tl3dsState *state,
-                               unsigned int object )
+                               size_t object )
 {
 	if( state == NULL )
 		return NULL;
@@ -1070,9 +1519,9 @@ const char *tl3dsMaterialReferenceName(   tl3dsState *state,
 
 /*----------------------------------------------------------------------------*/
 int tl3dsGetMaterialReference(    tl3dsState *state,
-                             unsigned int index,
-                             unsigned int *face_index,
-                             unsigned int *face_count)
+                             size_t index,
+                             size_t *face_index,
+                             size_t *face_count)
 {
 	if( state == NULL )
 		return 1;
@@ -1091,7 +1540,7 @@ int tl3dsGetMaterialReference(    tl3dsState *state,
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsVertexCount( tl3dsState *state )
+size_t tl3dsVertexCount( tl3dsState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1106,7 +1555,7 @@ unsigned int tl3dsVertexCount( tl3dsState *state )
 /*----------------------------------------------------------------------------*/
 int tl3dsGetVertexDouble(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	double *x, double *y, double *z,
 	double *tu, double *tv,
 	double *nx, double *ny, double *nz )
@@ -1154,7 +1603,7 @@ int tl3dsGetVertexDouble(
 /*----------------------------------------------------------------------------*/
 int tl3dsGetVertex(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	float *x, float *y, float *z,
 	float *tu, float *tv,
 	float *nx, float *ny, float *nz )
@@ -1200,7 +1649,7 @@ int tl3dsGetVertex(
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsFaceCount( tl3dsState *state )
+size_t tl3dsFaceCount( tl3dsState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1212,12 +1661,12 @@ unsigned int tl3dsFaceCount( tl3dsState *state )
 /*----------------------------------------------------------------------------*/
 int tl3dsGetFaceInt(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	unsigned int *a,
 	unsigned int *b,
 	unsigned int *c )
 {
-	unsigned int face = 0;
+	size_t face = 0;
 
 	if( state == NULL )
 		return 1;
@@ -1240,12 +1689,12 @@ int tl3dsGetFaceInt(
 /*----------------------------------------------------------------------------*/
 int tl3dsGetFace(
 	tl3dsState *state,
-	unsigned int index,
+	size_t index,
 	unsigned short *a,
 	unsigned short *b,
 	unsigned short *c )
 {
-	unsigned int face = 0;
+	size_t face = 0;
 
 	if( state == NULL )
 		return 1;
@@ -1253,23 +1702,43 @@ int tl3dsGetFace(
 	if( state->face_buffer && face <= state->face_count )
 	{
 		if( a )
-			*a = state->face_buffer[ index * 3 ];
+			*a = (unsigned short)state->face_buffer[ index * 3 ];
 
 		if( b )
-			*b = state->face_buffer[ index * 3 + 1 ];
+			*b = (unsigned short)state->face_buffer[ index * 3 + 1 ];
 
 		if( c )
-			*c = state->face_buffer[ index * 3 + 2 ];
+			*c = (unsigned short)state->face_buffer[ index * 3 + 2 ];
 	}
 
 	return 0;
 }
 
 
+/*----------------------------------------------------------------------------*/
+/* "gz" or "zst", the loaders decompress these */
+static int tds_is_compressed_extension( const char *ext )
+{
+	if( (ext[0] == 'g' || ext[0] == 'G')
+		&& (ext[1] == 'z' || ext[1] == 'Z')
+		&& (ext[2] == 0) )
+		return 1;
+
+	if( (ext[0] == 'z' || ext[0] == 'Z')
+		&& (ext[1] == 's' || ext[1] == 'S')
+		&& (ext[2] == 't' || ext[2] == 'T')
+		&& (ext[3] == 0) )
+		return 1;
+
+	return 0;
+}
+
+
 /*----------------------------------------------------------------------------*/
 int tl3dsCheckFileExtension( const char *filename )
 {
-	const char *ext = 0, *tmp = filename;
+	const char *ext = 0, *previous = 0, *tmp = filename;
+	char end = 0;
 
 	if( filename == NULL )
 		return 1;
@@ -1277,7 +1746,10 @@ int tl3dsCheckFileExtension( const char *filename )
 	while( *tmp != 0 )
 	{
 		if( *tmp == '.' )
+		{
+			previous = ext;
 			ext = tmp + 1;
+		}
 
 		tmp++;
 	}
@@ -1286,17 +1758,476 @@ int tl3dsCheckFileExtension( const char *filename )
 	if( ext == 0 )
 		return 1;
 
+	/* look through a compression suffix */
+	if( previous != 0 && tds_is_compressed_extension( ext ) )
+	{
+		ext = previous;
+		end = '.';
+	}
+
 	if( (ext[0] == '3')
 		&& (ext[1] == 'd' || ext[1] == 'D')
 		&& (ext[2] == 's' || ext[2] == 'S')
-		&& (ext[3] == 0) )
+		&& (ext[3] == end) )
 		return 0;
 
 	return 1;
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned int tl3dsHasNormals( tl3dsState *state )
+size_t tl3dsHasNormals( tl3dsState *state )
 {
     return 0;
 }
+
+
+/*----------------------------------------------------------------------------*/
+/* chunks of an object the index keeps, in this order */
+static const unsigned short tds_index_chunk_ids[] =
+{
+	0x4000, /* OBJECT */
+	0x4100, /* TRI_OBJECT */
+	0x4110, /* POINT_ARRAY */
+	0x4140, /* TEX_ARRAY */
+	0x4120  /* FACE_ARRAY */
+};
+
+#define TDS_INDEX_CHUNK_COUNT (sizeof(tds_index_chunk_ids) / sizeof(tds_index_chunk_ids[0]))
+
+
+/*----------------------------------------------------------------------------*/
+/* length is 0 for a chunk that is not there */
+typedef struct tl3dsIndexChunk
+{
+	size_t offset, length;
+} tl3dsIndexChunk;
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct tl3dsIndexObject
+{
+	char *name;
+	tl3dsIndexChunk chunks[TDS_INDEX_CHUNK_COUNT];
+	size_t point_count, texcoord_count, face_count;
+} tl3dsIndexObject;
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct tl3dsIndexMaterial
+{
+	char *name;
+	tl3dsIndexChunk chunk;
+} tl3dsIndexMaterial;
+
+
+/*----------------------------------------------------------------------------*/
+struct tl3dsIndex
+{
+	/* names live here */
+	tl_arena arena;
+
+	/* the file, owned by the caller */
+	const char *buffer;
+	size_t length;
+
+	tl3dsIndexObject *object_buffer;
+	size_t object_buffer_size;
+	size_t object_count;
+
+	tl3dsIndexMaterial *material_buffer;
+	size_t material_buffer_size;
+	size_t material_count;
+};
+
+
+/*----------------------------------------------------------------------------*/
+/* the header of the chunk at offset, 1 if the chunk does not fit before end;
+ * containers of a truncated file end with it */
+static int tds_index_read_chunk(
+	tl3dsIndex *index,
+	size_t offset,
+	size_t end,
+	unsigned short *id,
+	size_t *length )
+{
+	if( end - offset < 6 )
+		return 1;
+
+	*id = tds_read_le_ushort( index->buffer + offset );
+	*length = tds_read_le_uint( index->buffer + offset + 2 );
+
+	if( *length > end - offset && (*id == 0x4d4d || *id == 0x3d3d) )
+		*length = end - offset;
+
+	return *length < 6 || *length > end - offset ? 1 : 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the item count in front of an array chunk */
+static size_t tds_index_array_count( tl3dsIndex *index, const tl3dsIndexChunk *chunk )
+{
+	if( chunk->length < 8 )
+		return 0;
+
+	return tds_read_le_ushort( index->buffer + chunk->offset + 6 );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* records the arrays of a TRI_OBJECT */
+static void tds_index_scan_mesh( tl3dsIndex *index, tl3dsIndexObject *object )
+{
+	size_t offset = object->chunks[1].offset + 6;
+	size_t end = object->chunks[1].offset + object->chunks[1].length;
+	unsigned short id;
+	size_t length, i;
+
+	while( tds_index_read_chunk( index, offset, end, &id, &length ) == 0 )
+	{
+		/* the first of each, like the parser fills one mesh per object */
+		for( i = 2; i < TDS_INDEX_CHUNK_COUNT; i++ )
+		{
+			if( id == tds_index_chunk_ids[i] && object->chunks[i].length == 0 )
+			{
+				object->chunks[i].offset = offset;
+				object->chunks[i].length = length;
+			}
+		}
+
+		offset += length;
+	}
+
+	object->point_count = tds_index_array_count( index, &object->chunks[2] );
+	object->texcoord_count = tds_index_array_count( index, &object->chunks[3] );
+	object->face_count = tds_index_array_count( index, &object->chunks[4] );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void tds_index_add_object( tl3dsIndex *index, size_t offset, size_t length )
+{
+	const char *name = index->buffer + offset + 6;
+	const char *end = index->buffer + offset + length;
+	const char *name_end = memchr( name, 0, (size_t)(end - name) );
+	tl3dsIndexObject *object;
+	unsigned short id;
+	size_t chunk_offset, chunk_length;
+
+	/* the parser could not read it either */
+	if( name_end == NULL )
+		return;
+
+	index->object_buffer = tds_grow( index->object_buffer, &index->object_buffer_size,
+		index->object_count + 1, sizeof(tl3dsIndexObject) );
+	if( index->object_buffer_size < (index->object_count + 1) * sizeof(tl3dsIndexObject) )
+		return;
+
+	object = &index->object_buffer[index->object_count];
+	memset( object, 0, sizeof(tl3dsIndexObject) );
+
+	object->name = tl_arena_copy_span( &index->arena, name, name_end );
+	if( object->name == NULL )
+		return;
+
+	object->chunks[0].offset = offset;
+	object->chunks[0].length = length;
+
+	/* cameras and lights have no mesh */
+	chunk_offset = (size_t)(name_end - index->buffer) + 1;
+	while( tds_index_read_chunk( index, chunk_offset, offset + length, &id, &chunk_length ) == 0 )
+	{
+		if( id == 0x4100 && object->chunks[1].length == 0 )
+		{
+			object->chunks[1].offset = chunk_offset;
+			object->chunks[1].length = chunk_length;
+			tds_index_scan_mesh( index, object );
+		}
+
+		chunk_offset += chunk_length;
+	}
+
+	index->object_count++;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void tds_index_add_material( tl3dsIndex *index, size_t offset, size_t length )
+{
+	tl3dsIndexMaterial *material;
+	size_t chunk_offset = offset + 6, chunk_length;
+	unsigned short id;
+
+	index->material_buffer = tds_grow( index->material_buffer, &index->material_buffer_size,
+		index->material_count + 1, sizeof(tl3dsIndexMaterial) );
+	if( index->material_buffer_size < (index->material_count + 1) * sizeof(tl3dsIndexMaterial) )
+		return;
+
+	material = &index->material_buffer[index->material_count];
+	material->name = NULL;
+	material->chunk.offset = offset;
+	material->chunk.length = length;
+
+	/* MATERIAL_NAME */
+	while( tds_index_read_chunk( index, chunk_offset, offset + length, &id, &chunk_length ) == 0 )
+	{
+		const char *name = index->buffer + chunk_offset + 6;
+		const char *name_end = memchr( name, 0, chunk_length - 6 );
+
+		if( id == 0xA000 && name_end != NULL )
+		{
+			material->name = tl_arena_copy_span( &index->arena, name, name_end );
+			break;
+		}
+
+		chunk_offset += chunk_length;
+	}
+
+	if( material->name == NULL )
+		material->name = tl_arena_copy_span( &index->arena, "", "" );
+
+	if( material->name != NULL )
+		index->material_count++;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* walks the chunks in [offset, end) of container (0 for the file), down into
+ * MAIN and from there into EDITOR only, so nesting can not exhaust the stack */
+static void tds_index_scan( tl3dsIndex *index, size_t offset, size_t end, unsigned short container )
+{
+	unsigned short id;
+	size_t length;
+
+	while( tds_index_read_chunk( index, offset, end, &id, &length ) == 0 )
+	{
+		switch( id )
+		{
+		case 0x4d4d: /* MAIN CHUNK */
+			if( container == 0 )
+				tds_index_scan( index, offset + 6, offset + length, id );
+			break;
+
+		case 0x3d3d: /* 3D EDITOR CHUNK */
+			if( container != 0x3d3d )
+				tds_index_scan( index, offset + 6, offset + length, id );
+			break;
+
+		case 0x4000: /* OBJECT */
+			tds_index_add_object( index, offset, length );
+			break;
+
+		case 0xAFFF: /* MATERIAL CHUNK */
+			tds_index_add_material( index, offset, length );
+			break;
+
+		default:
+			break;
+		}
+
+		offset += length;
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* parses a single complete chunk, starting over whatever was left before */
+static void tds_index_parse_chunk( tl3dsIndex *index, tl3dsState *state, const tl3dsIndexChunk *chunk )
+{
+	state->parsing_state = TDS_STATE_READ_CHUNK_ID;
+	state->buffer_length = 0;
+
+	tl3dsParse( state, index->buffer + chunk->offset, chunk->length, 0 );
+}
+
+
+/*----------------------------------------------------------------------------*/
+tl3dsIndex *tl3dsIndexCreate( const char *buffer, size_t length )
+{
+	tl3dsIndex *index;
+
+	if( buffer == NULL )
+		return NULL;
+
+	index = malloc( sizeof(tl3dsIndex) );
+	if( index == NULL )
+		return NULL;
+
+	memset( index, 0, sizeof(tl3dsIndex) );
+	index->buffer = buffer;
+	index->length = length;
+
+	tds_index_scan( index, 0, length, 0 );
+
+	return index;
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl3dsIndexDestroy( tl3dsIndex *index )
+{
+	if( index == NULL )
+		return;
+
+	tl_arena_release( &index->arena );
+	free( index->object_buffer );
+	free( index->material_buffer );
+	free( index );
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tl3dsIndexObjectCount( tl3dsIndex *index )
+{
+	if( index == NULL )
+		return 0;
+
+	return index->object_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+const char *tl3dsIndexObjectName( tl3dsIndex *index, size_t object )
+{
+	if( index == NULL || object >= index->object_count )
+		return NULL;
+
+	return index->object_buffer[object].name;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tl3dsIndexGetObjectCounts(
+	tl3dsIndex *index,
+	size_t object,
+	size_t *points,
+	size_t *texcoords,
+	size_t *faces )
+{
+	if( index == NULL || object >= index->object_count )
+		return 1;
+
+	if( points )
+		*points = index->object_buffer[object].point_count;
+
+	if( texcoords )
+		*texcoords = index->object_buffer[object].texcoord_count;
+
+	if( faces )
+		*faces = index->object_buffer[object].face_count;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tl3dsIndexGetChunk(
+	tl3dsIndex *index,
+	size_t object,
+	unsigned short chunk_id,
+	size_t *offset,
+	size_t *length )
+{
+	size_t i;
+
+	if( index == NULL || object >= index->object_count )
+		return 1;
+
+	for( i = 0; i < TDS_INDEX_CHUNK_COUNT; i++ )
+	{
+		const tl3dsIndexChunk *chunk = &index->object_buffer[object].chunks[i];
+
+		if( tds_index_chunk_ids[i] != chunk_id || chunk->length == 0 )
+			continue;
+
+		if( offset )
+			*offset = chunk->offset;
+
+		if( length )
+			*length = chunk->length;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tl3dsIndexMaterialCount( tl3dsIndex *index )
+{
+	if( index == NULL )
+		return 0;
+
+	return index->material_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+const char *tl3dsIndexMaterialName( tl3dsIndex *index, size_t material )
+{
+	if( index == NULL || material >= index->material_count )
+		return NULL;
+
+	return index->material_buffer[material].name;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tl3dsIndexGetMaterialChunk(
+	tl3dsIndex *index,
+	size_t material,
+	size_t *offset,
+	size_t *length )
+{
+	if( index == NULL || material >= index->material_count )
+		return 1;
+
+	if( offset )
+		*offset = index->material_buffer[material].chunk.offset;
+
+	if( length )
+		*length = index->material_buffer[material].chunk.length;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tl3dsIndexParse(
+	tl3dsIndex *index,
+	tl3dsState *state,
+	const size_t *objects,
+	size_t object_count )
+{
+	size_t points = 0, texcoords = 0, faces = 0, i;
+
+	if( index == NULL || state == NULL || (objects == NULL && object_count > 0) )
+		return 1;
+
+	for( i = 0; i < object_count; i++ )
+	{
+		const tl3dsIndexObject *object;
+
+		if( objects[i] >= index->object_count )
+			return 1;
+
+		object = &index->object_buffer[objects[i]];
+		points += object->point_count;
+		texcoords += object->texcoord_count;
+		faces += object->face_count;
+	}
+
+	/* the index knows exactly how much room the arrays need */
+	tl3dsReserve( state, state->point_count + points,
+		state->texcoord_count + texcoords, state->face_count + faces );
+
+	/* the material references of the objects need all materials */
+	for( i = 0; i < index->material_count; i++ )
+		tds_index_parse_chunk( index, state, &index->material_buffer[i].chunk );
+
+	for( i = 0; i < object_count; i++ )
+		tds_index_parse_chunk( index, state, &index->object_buffer[objects[i]].chunks[0] );
+
+	return tl3dsParse( state, index->buffer, 0, 1 );
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "tlarena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* room for most names and records of a file in a handful of blocks */
+#ifndef TL_ARENA_BLOCK_SIZE
+	#define TL_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* the strictest alignment any allocation needs */
+typedef union tl_arena_align
+{
+	double d;
+	long l;
+	void *p;
+} tl_arena_align;
+
+/*----------------------------------------------------------------------------*/
+struct tl_arena_block
+{
+	tl_arena_block *next;
+	size_t size, used;
+};
+
+/* the data follows the header, rounded up to the alignment */
+#define TL_ARENA_HEADER_SIZE \
+	((sizeof(tl_arena_block) + sizeof(tl_arena_align) - 1) \
+		/ sizeof(tl_arena_align) * sizeof(tl_arena_align))
+
+/*----------------------------------------------------------------------------*/
+void *tl_arena_alloc( tl_arena *arena, size_t size )
+{
+	tl_arena_block *block = arena->block;
+	void *ptr;
+
+	if( size > (size_t)-1 - TL_ARENA_HEADER_SIZE - sizeof(tl_arena_align) )
+		return NULL;
+
+	size = (size + sizeof(tl_arena_align) - 1)
+		/ sizeof(tl_arena_align) * sizeof(tl_arena_align);
+
+	if( block == NULL || block->size - block->used < size )
+	{
+		size_t block_size = size > TL_ARENA_BLOCK_SIZE ? size : TL_ARENA_BLOCK_SIZE;
+
+		block = malloc( TL_ARENA_HEADER_SIZE + block_size );
+		if( block == NULL )
+			return NULL;
+
+		block->size = block_size;
+		block->used = 0;
+
+		/* an oversized block is full right away, keep filling the current one */
+		if( size == block_size && arena->block != NULL )
+		{
+			block->next = arena->block->next;
+			arena->block->next = block;
+		}
+		else
+		{
+			block->next = arena->block;
+			arena->block = block;
+		}
+	}
+
+	ptr = (char *)block + TL_ARENA_HEADER_SIZE + block->used;
+	block->used += size;
+
+	return ptr;
+}
+
+/*----------------------------------------------------------------------------*/
+char *tl_arena_copy_span( tl_arena *arena, const char *begin, const char *end )
+{
+	size_t length = end - begin;
+	char *ptr = tl_arena_alloc( arena, length + 1 );
+
+	if( ptr == NULL )
+		return NULL;
+
+	memcpy( ptr, begin, length );
+	ptr[length] = 0;
+
+	return ptr;
+}
+
+/*----------------------------------------------------------------------------*/
+void tl_arena_release( tl_arena *arena )
+{
+	tl_arena_block *block = arena->block;
+
+	while( block != NULL )
+	{
+		tl_arena_block *next = block->next;
+		free( block );
+		block = next;
+	}
+
+	arena->block = NULL;
+}
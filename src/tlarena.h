@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef TRIMESH_LOADER_ARENA_H
+#define TRIMESH_LOADER_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Internal bump allocator for the many small, long lived allocations of a
+ * parser state (names, records). Nothing is freed on its own, the whole
+ * arena goes away with tl_arena_release. A zeroed tl_arena is empty.
+ */
+
+typedef struct tl_arena_block tl_arena_block;
+
+typedef struct tl_arena
+{
+	tl_arena_block *block;
+} tl_arena;
+
+/* NULL if out of memory, the memory is aligned for any type */
+void *tl_arena_alloc( tl_arena *arena, size_t size );
+
+/* zero terminated copy of [begin, end) */
+char *tl_arena_copy_span( tl_arena *arena, const char *begin, const char *end );
+
+/* frees all blocks and leaves the arena empty */
+void tl_arena_release( tl_arena *arena );
+
+#endif
@@ -0,0 +1,912 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "trimeshloader/trimeshloader.h"
+#include "tlthread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Batch loading. The portable path loads the files on a pool of threads,
+ * each file with the usual open/read/close calls. On Linux the files are
+ * opened and read through io_uring instead: the calling thread keeps many
+ * opens and reads in flight at once and hands finished files to parser
+ * threads. The ring is driven through the kernel interface directly, files
+ * it cannot load are loaded the usual way.
+ */
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_PTHREAD) && defined(__GNUC__)
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+
+	/* the opcodes used here came with 5.6, as did this flag */
+	#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+		#define TL_BATCH_URING
+	#endif
+#endif
+
+/* submission queue entries, half as many files are in flight */
+#define BATCH_RING_ENTRIES 64
+
+/* first read of a file, doubled while the file fills it */
+#define BATCH_READ_SIZE (64 * 1024)
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct batch_pool
+{
+	const char *const *filenames;
+	size_t count;
+	tlTrimesh **trimeshes;
+	tlOpenFunction open;
+	void *open_data;
+	unsigned int vertex_format;
+
+	tl_mutex *mutex;
+	size_t next;
+} batch_pool;
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_pool_work( void *data )
+{
+	batch_pool *pool = (batch_pool *)data;
+
+	for( ;; )
+	{
+		size_t i;
+
+		tl_mutex_lock( pool->mutex );
+		i = pool->next++;
+		tl_mutex_unlock( pool->mutex );
+
+		if( i >= pool->count )
+			break;
+
+		pool->trimeshes[i] = tlLoadTrimeshEx( pool->filenames[i],
+			pool->open, pool->open_data, pool->vertex_format );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_load_pool(
+	const char *const *filenames,
+	size_t count,
+	tlTrimesh **trimeshes,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format,
+	unsigned int thread_count )
+{
+	batch_pool pool;
+	tl_thread **threads;
+	unsigned int i;
+
+	memset( &pool, 0, sizeof(batch_pool) );
+	pool.filenames = filenames;
+	pool.count = count;
+	pool.trimeshes = trimeshes;
+	pool.open = open;
+	pool.open_data = open_data;
+	pool.vertex_format = vertex_format;
+
+	/* without threads the work is done inline, no lock needed */
+	pool.mutex = tl_mutex_create();
+
+	threads = calloc( thread_count, sizeof(tl_thread *) );
+	if( threads == NULL )
+	{
+		batch_pool_work( &pool );
+		tl_mutex_destroy( pool.mutex );
+		return;
+	}
+
+	for( i = 0; i < thread_count; i++ )
+		threads[i] = tl_thread_start( batch_pool_work, &pool );
+
+	for( i = 0; i < thread_count; i++ )
+		tl_thread_join( threads[i] );
+
+	free( threads );
+	tl_mutex_destroy( pool.mutex );
+}
+
+
+#ifdef TL_BATCH_URING
+/*----------------------------------------------------------------------------*/
+typedef struct batch_ring
+{
+	int fd;
+
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int sq_entries;
+
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_map, *cq_map;
+	size_t sq_map_size, cq_map_size, sqes_size;
+
+	/* queued but not yet submitted, submitted but not yet completed */
+	unsigned int queued;
+	unsigned int in_flight;
+} batch_ring;
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_ring_destroy( batch_ring *ring )
+{
+	if( ring->sqes != NULL && ring->sqes != MAP_FAILED )
+		munmap( ring->sqes, ring->sqes_size );
+
+	if( ring->cq_map != NULL && ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map )
+		munmap( ring->cq_map, ring->cq_map_size );
+
+	if( ring->sq_map != NULL && ring->sq_map != MAP_FAILED )
+		munmap( ring->sq_map, ring->sq_map_size );
+
+	if( ring->fd >= 0 )
+		close( ring->fd );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int batch_ring_create( batch_ring *ring, unsigned int entries )
+{
+	struct io_uring_params params;
+	char *sq, *cq;
+
+	memset( ring, 0, sizeof(batch_ring) );
+	memset( &params, 0, sizeof(params) );
+
+	ring->fd = (int)syscall( __NR_io_uring_setup, entries, &params );
+	if( ring->fd < 0 )
+		return 1;
+
+	ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	/* both rings share one mapping on newer kernels */
+	if( params.features & IORING_FEAT_SINGLE_MMAP )
+	{
+		if( ring->cq_map_size > ring->sq_map_size )
+			ring->sq_map_size = ring->cq_map_size;
+		ring->cq_map_size = ring->sq_map_size;
+	}
+
+	ring->sq_map = mmap( NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+	if( ring->sq_map == MAP_FAILED )
+	{
+		batch_ring_destroy( ring );
+		return 1;
+	}
+
+	if( params.features & IORING_FEAT_SINGLE_MMAP )
+		ring->cq_map = ring->sq_map;
+	else
+	{
+		ring->cq_map = mmap( NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING );
+		if( ring->cq_map == MAP_FAILED )
+		{
+			batch_ring_destroy( ring );
+			return 1;
+		}
+	}
+
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap( NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+	if( ring->sqes == MAP_FAILED )
+	{
+		batch_ring_destroy( ring );
+		return 1;
+	}
+
+	sq = (char *)ring->sq_map;
+	ring->sq_head = (unsigned int *)(sq + params.sq_off.head);
+	ring->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+	ring->sq_entries = params.sq_entries;
+
+	cq = (char *)ring->cq_map;
+	ring->cq_head = (unsigned int *)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* hands the queued entries to the kernel, wait for a completion if asked */
+static int batch_ring_submit( batch_ring *ring, int wait )
+{
+	unsigned int tail = *ring->sq_tail + ring->queued;
+	long result;
+
+	__atomic_store_n( ring->sq_tail, tail, __ATOMIC_RELEASE );
+	ring->queued = 0;
+
+	for( ;; )
+	{
+		/* including any the kernel did not take last time */
+		unsigned int submit = tail - __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+
+		result = syscall( __NR_io_uring_enter, ring->fd, submit, wait ? 1 : 0,
+			wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+
+		if( result >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY) )
+			break;
+	}
+
+	return result < 0 ? 1 : 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* a cleared entry to fill in, NULL if the queue stays full */
+static struct io_uring_sqe *batch_ring_get( batch_ring *ring )
+{
+	unsigned int tail = *ring->sq_tail + ring->queued;
+	struct io_uring_sqe *sqe;
+
+	if( tail - __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE ) >= ring->sq_entries )
+	{
+		if( batch_ring_submit( ring, 0 ) )
+			return NULL;
+
+		tail = *ring->sq_tail;
+		if( tail - __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE ) >= ring->sq_entries )
+			return NULL;
+	}
+
+	sqe = &ring->sqes[tail & *ring->sq_mask];
+	memset( sqe, 0, sizeof(struct io_uring_sqe) );
+	ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+	ring->queued++;
+	ring->in_flight++;
+
+	return sqe;
+}
+
+
+/*----------------------------------------------------------------------------*/
+enum
+{
+	BATCH_WAITING,
+	BATCH_OPENING,
+	BATCH_READING,
+	BATCH_DONE,
+	BATCH_FAILED
+};
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct batch_request
+{
+	const char *filename;
+	int status;
+	int fd;
+
+	char *data;
+	size_t size;
+	size_t capacity;
+
+	/* read position once the data is handed out */
+	size_t position;
+
+	/* requests for material libraries own a copy of the name */
+	char *name;
+} batch_request;
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct batch_uring
+{
+	batch_ring ring;
+
+	const char *const *filenames;
+	size_t count;
+	tlTrimesh **trimeshes;
+	unsigned int vertex_format;
+
+	/* main files in order, then material libraries asked for by workers */
+	batch_request *requests;
+	size_t next_request;
+	batch_request **extra;
+	size_t extra_count;
+	size_t extra_size;
+	size_t next_extra;
+
+	/* files with an open or read in flight */
+	unsigned int active;
+
+	/* next file for a worker and workers still running */
+	size_t next_job;
+	unsigned int workers;
+
+	/* io_uring_enter failed, nothing completes any more */
+	int broken;
+
+	tl_mutex *mutex;
+	tl_condition *changed;
+} batch_uring;
+
+
+/*----------------------------------------------------------------------------*/
+static size_t batch_request_read( void *user_data, void *buffer, size_t size )
+{
+	batch_request *request = (batch_request *)user_data;
+	size_t available = request->size - request->position;
+
+	if( size > available )
+		size = available;
+
+	if( size > 0 )
+		memcpy( buffer, request->data + request->position, size );
+	request->position += size;
+
+	return size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int batch_request_seek( void *user_data, size_t offset )
+{
+	batch_request *request = (batch_request *)user_data;
+
+	if( offset > request->size )
+		return 1;
+
+	request->position = offset;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t batch_request_size( void *user_data )
+{
+	return ((batch_request *)user_data)->size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static const void *batch_request_map( void *user_data, size_t *size )
+{
+	batch_request *request = (batch_request *)user_data;
+
+	*size = request->size;
+
+	return request->data;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* frees what was read, and the request itself for material libraries */
+static void batch_request_close( void *user_data )
+{
+	batch_request *request = (batch_request *)user_data;
+
+	free( request->data );
+	request->data = NULL;
+
+	if( request->name != NULL )
+	{
+		free( request->name );
+		free( request );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_request_reader( batch_request *request, tlReader *reader )
+{
+	request->position = 0;
+
+	reader->user_data = request;
+	reader->read = batch_request_read;
+	reader->seek = batch_request_seek;
+	reader->size = batch_request_size;
+	reader->close = batch_request_close;
+	reader->map = batch_request_map;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* material libraries go through the ring as well, ahead of the main files */
+static int batch_uring_open( void *open_data, const char *filename, tlReader *reader )
+{
+	batch_uring *batch = (batch_uring *)open_data;
+	batch_request *request = malloc( sizeof(batch_request) );
+	size_t length = strlen( filename );
+	int status;
+
+	if( request == NULL )
+		return tlReaderOpen( NULL, filename, reader );
+
+	memset( request, 0, sizeof(batch_request) );
+	request->name = malloc( length + 1 );
+	if( request->name == NULL )
+	{
+		free( request );
+		return tlReaderOpen( NULL, filename, reader );
+	}
+	memcpy( request->name, filename, length + 1 );
+	request->filename = request->name;
+	request->fd = -1;
+
+	tl_mutex_lock( batch->mutex );
+
+	if( batch->extra_count == batch->extra_size )
+	{
+		size_t size = batch->extra_size ? batch->extra_size * 2 : 16;
+		batch_request **extra = realloc( batch->extra, size * sizeof(batch_request *) );
+
+		if( extra == NULL )
+		{
+			tl_mutex_unlock( batch->mutex );
+			free( request->name );
+			free( request );
+			return tlReaderOpen( NULL, filename, reader );
+		}
+
+		batch->extra = extra;
+		batch->extra_size = size;
+	}
+
+	batch->extra[batch->extra_count++] = request;
+	tl_condition_broadcast( batch->changed );
+
+	while( request->status != BATCH_DONE && request->status != BATCH_FAILED && !batch->broken )
+		tl_condition_wait( batch->changed, batch->mutex );
+	status = request->status;
+
+	tl_mutex_unlock( batch->mutex );
+
+	/* the kernel may still write to a request the broken ring left behind */
+	if( status != BATCH_DONE && status != BATCH_FAILED )
+		return tlReaderOpen( NULL, filename, reader );
+
+	if( status == BATCH_FAILED )
+	{
+		batch_request_close( request );
+		return tlReaderOpen( NULL, filename, reader );
+	}
+
+	batch_request_reader( request, reader );
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_uring_work( void *data )
+{
+	batch_uring *batch = (batch_uring *)data;
+
+	for( ;; )
+	{
+		batch_request *request;
+		tlTrimesh *trimesh = NULL;
+		const char *filename;
+		tlReader reader;
+		size_t i;
+		int status;
+
+		tl_mutex_lock( batch->mutex );
+		i = batch->next_job++;
+		if( i >= batch->count )
+		{
+			tl_mutex_unlock( batch->mutex );
+			break;
+		}
+
+		request = &batch->requests[i];
+		while( request->status != BATCH_DONE && request->status != BATCH_FAILED && !batch->broken )
+			tl_condition_wait( batch->changed, batch->mutex );
+		status = request->status;
+		tl_mutex_unlock( batch->mutex );
+
+		filename = request->filename;
+
+		/* what the ring could not read is loaded the usual way */
+		if( status != BATCH_DONE )
+		{
+			batch->trimeshes[i] = tlLoadTrimeshEx( filename, tlReaderOpen, NULL, batch->vertex_format );
+			continue;
+		}
+
+		batch_request_reader( request, &reader );
+
+		if( tl3dsCheckFileExtension( filename ) == 0 )
+			trimesh = tlLoad3DSReader( &reader, batch->vertex_format );
+		else if( tlObjCheckFileExtension( filename ) == 0 )
+			trimesh = tlLoadOBJReader( &reader, filename, batch_uring_open, batch, batch->vertex_format );
+
+		tlReaderClose( &reader );
+
+		batch->trimeshes[i] = trimesh;
+	}
+
+	tl_mutex_lock( batch->mutex );
+	batch->workers--;
+	tl_condition_broadcast( batch->changed );
+	tl_mutex_unlock( batch->mutex );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* next file to open, material libraries first since a worker waits for them */
+static batch_request *batch_uring_next( batch_uring *batch )
+{
+	if( batch->next_extra < batch->extra_count )
+		return batch->extra[batch->next_extra++];
+
+	while( batch->next_request < batch->count )
+	{
+		batch_request *request = &batch->requests[batch->next_request++];
+
+		if( request->status == BATCH_WAITING )
+			return request;
+	}
+
+	return NULL;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_uring_finish( batch_uring *batch, batch_request *request, int status )
+{
+	/* nobody waits for the close, so it carries no request */
+	if( request->fd >= 0 )
+	{
+		struct io_uring_sqe *sqe = batch_ring_get( &batch->ring );
+
+		if( sqe != NULL )
+		{
+			sqe->opcode = IORING_OP_CLOSE;
+			sqe->fd = request->fd;
+		}
+		else
+			close( request->fd );
+
+		request->fd = -1;
+	}
+
+	if( status == BATCH_FAILED )
+	{
+		free( request->data );
+		request->data = NULL;
+	}
+
+	request->status = status;
+	batch->active--;
+	tl_condition_broadcast( batch->changed );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_uring_read( batch_uring *batch, batch_request *request )
+{
+	struct io_uring_sqe *sqe;
+
+	/* the file fills the buffer, there may be more */
+	if( request->size == request->capacity )
+	{
+		size_t capacity = request->capacity ? request->capacity * 2 : BATCH_READ_SIZE;
+		char *data = capacity > request->capacity ? realloc( request->data, capacity ) : NULL;
+
+		if( data == NULL )
+		{
+			batch_uring_finish( batch, request, BATCH_FAILED );
+			return;
+		}
+
+		request->data = data;
+		request->capacity = capacity;
+	}
+
+	sqe = batch_ring_get( &batch->ring );
+	if( sqe == NULL )
+	{
+		batch_uring_finish( batch, request, BATCH_FAILED );
+		return;
+	}
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = request->fd;
+	sqe->addr = (unsigned long)(request->data + request->size);
+	sqe->len = (unsigned int)(request->capacity - request->size > 0x40000000u
+		? 0x40000000u : request->capacity - request->size);
+	sqe->off = request->size;
+	sqe->user_data = (unsigned long)request;
+
+	request->status = BATCH_READING;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void batch_uring_complete( batch_uring *batch, batch_request *request, int result )
+{
+	if( request->status == BATCH_OPENING )
+	{
+		if( result < 0 )
+		{
+			batch_uring_finish( batch, request, BATCH_FAILED );
+			return;
+		}
+
+		request->fd = result;
+		batch_uring_read( batch, request );
+	}
+	else if( request->status == BATCH_READING )
+	{
+		if( result < 0 )
+		{
+			batch_uring_finish( batch, request, BATCH_FAILED );
+			return;
+		}
+
+		request->size += (size_t)result;
+
+		/* a short read is the end of a regular file */
+		if( result > 0 && request->size == request->capacity )
+			batch_uring_read( batch, request );
+		else
+			batch_uring_finish( batch, request, BATCH_DONE );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the calling thread runs the ring until the workers are done */
+static void batch_uring_run( batch_uring *batch )
+{
+	/* every file has an open or a read and possibly a close in flight */
+	unsigned int max_active = batch->ring.sq_entries / 2;
+
+	tl_mutex_lock( batch->mutex );
+
+	for( ;; )
+	{
+		batch_request *request;
+		unsigned int head, tail;
+
+		while( batch->active < max_active && (request = batch_uring_next( batch )) != NULL )
+		{
+			struct io_uring_sqe *sqe = batch_ring_get( &batch->ring );
+
+			if( sqe == NULL )
+			{
+				request->status = BATCH_FAILED;
+				tl_condition_broadcast( batch->changed );
+				continue;
+			}
+
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (unsigned long)request->filename;
+			sqe->open_flags = O_RDONLY | O_CLOEXEC;
+			sqe->user_data = (unsigned long)request;
+
+			request->status = BATCH_OPENING;
+			batch->active++;
+		}
+
+		if( batch->ring.in_flight == 0 )
+		{
+			if( batch->workers == 0 )
+				break;
+
+			/* wait for material libraries or the workers to finish */
+			tl_condition_wait( batch->changed, batch->mutex );
+			continue;
+		}
+
+		tl_mutex_unlock( batch->mutex );
+		if( batch_ring_submit( &batch->ring, 1 ) )
+		{
+			/* the workers load the rest themselves */
+			tl_mutex_lock( batch->mutex );
+			batch->broken = 1;
+			tl_condition_broadcast( batch->changed );
+			break;
+		}
+		tl_mutex_lock( batch->mutex );
+
+		head = *batch->ring.cq_head;
+		tail = __atomic_load_n( batch->ring.cq_tail, __ATOMIC_ACQUIRE );
+
+		while( head != tail )
+		{
+			struct io_uring_cqe *cqe = &batch->ring.cqes[head & *batch->ring.cq_mask];
+
+			batch->ring.in_flight--;
+			if( cqe->user_data != 0 )
+				batch_uring_complete( batch, (batch_request *)(unsigned long)cqe->user_data, cqe->res );
+
+			head++;
+		}
+
+		__atomic_store_n( batch->ring.cq_head, head, __ATOMIC_RELEASE );
+	}
+
+	tl_mutex_unlock( batch->mutex );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* 1 if io_uring is not available, the pool does the work then */
+static int batch_load_uring(
+	const char *const *filenames,
+	size_t count,
+	tlTrimesh **trimeshes,
+	unsigned int vertex_format,
+	unsigned int thread_count )
+{
+	batch_uring batch;
+	tl_thread **threads;
+	unsigned int i;
+	size_t j;
+
+	memset( &batch, 0, sizeof(batch_uring) );
+	batch.filenames = filenames;
+	batch.count = count;
+	batch.trimeshes = trimeshes;
+	batch.vertex_format = vertex_format;
+
+	if( batch_ring_create( &batch.ring, BATCH_RING_ENTRIES ) )
+		return 1;
+
+	batch.mutex = tl_mutex_create();
+	batch.changed = tl_condition_create();
+	batch.requests = calloc( count, sizeof(batch_request) );
+	threads = calloc( thread_count, sizeof(tl_thread *) );
+
+	if( batch.mutex == NULL || batch.changed == NULL || batch.requests == NULL || threads == NULL )
+	{
+		free( threads );
+		free( batch.requests );
+		tl_condition_destroy( batch.changed );
+		tl_mutex_destroy( batch.mutex );
+		batch_ring_destroy( &batch.ring );
+		return 1;
+	}
+
+	for( j = 0; j < count; j++ )
+	{
+		batch.requests[j].filename = filenames[j];
+		batch.requests[j].fd = -1;
+
+		/* not worth reading what no loader takes */
+		if( filenames[j] == NULL || (tl3dsCheckFileExtension( filenames[j] ) != 0
+			&& tlObjCheckFileExtension( filenames[j] ) != 0) )
+			batch.requests[j].status = BATCH_FAILED;
+	}
+
+	/* the workers wait for the ring, they need threads of their own */
+	for( i = 0; i < thread_count; i++ )
+	{
+		tl_mutex_lock( batch.mutex );
+		batch.workers++;
+		tl_mutex_unlock( batch.mutex );
+
+		threads[i] = tl_thread_spawn( batch_uring_work, &batch );
+		if( threads[i] == NULL )
+		{
+			tl_mutex_lock( batch.mutex );
+			batch.workers--;
+			tl_mutex_unlock( batch.mutex );
+			break;
+		}
+	}
+
+	if( i == 0 )
+	{
+		free( threads );
+		free( batch.requests );
+		tl_condition_destroy( batch.changed );
+		tl_mutex_destroy( batch.mutex );
+		batch_ring_destroy( &batch.ring );
+		return 1;
+	}
+
+	batch_uring_run( &batch );
+
+	while( i > 0 )
+		tl_thread_join( threads[--i] );
+
+	/* buffers of reads the kernel may still finish go with the ring */
+	batch_ring_destroy( &batch.ring );
+
+	for( j = 0; j < count; j++ )
+		free( batch.requests[j].data );
+
+	free( threads );
+	free( batch.extra );
+	free( batch.requests );
+	tl_condition_destroy( batch.changed );
+	tl_mutex_destroy( batch.mutex );
+
+	return 0;
+}
+#endif
+
+
+/*----------------------------------------------------------------------------*/
+size_t tlLoadTrimeshBatch(
+	const char *const *filenames,
+	size_t count,
+	tlTrimesh **trimeshes,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format,
+	unsigned int thread_count )
+{
+	size_t i, loaded = 0;
+
+	if( filenames == NULL || trimeshes == NULL )
+		return 0;
+
+	for( i = 0; i < count; i++ )
+		trimeshes[i] = NULL;
+
+	if( count == 0 )
+		return 0;
+
+	if( thread_count == 0 )
+		thread_count = tl_thread_cpu_count();
+
+	if( thread_count > count )
+		thread_count = (unsigned int)count;
+
+#ifdef TL_BATCH_URING
+	/* the ring reads straight from the file system only */
+	if( open != NULL || batch_load_uring( filenames, count, trimeshes, vertex_format, thread_count ) )
+#endif
+	batch_load_pool( filenames, count, trimeshes,
+		open != NULL ? open : tlReaderOpen, open_data, vertex_format, thread_count );
+
+	for( i = 0; i < count; i++ )
+	{
+		if( trimeshes[i] != NULL )
+			loaded++;
+	}
+
+	return loaded;
+}
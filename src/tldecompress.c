@@ -0,0 +1,476 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "trimeshloader/tlreader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+	#include <zstd.h>
+#endif
+
+/* compressed bytes read from the source at once */
+#define TL_DECOMPRESS_INPUT_SIZE (256 * 1024)
+
+/* enough for the magic bytes and the largest zstd frame header */
+#define TL_DECOMPRESS_HEADER_SIZE 18
+
+/* zlib counts in unsigned int, feed it at most this much at once */
+#define TL_DECOMPRESS_ZLIB_STEP (1024 * 1024 * 1024)
+
+#define TL_FORMAT_NONE 0
+#define TL_FORMAT_GZIP 1
+#define TL_FORMAT_ZSTD 2
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct decompress_reader
+{
+	tlReader source;
+	int format;
+
+	/* bytes read to detect the format, handed out again first */
+	unsigned char header[TL_DECOMPRESS_HEADER_SIZE];
+	size_t header_length;
+
+	/* compressed input, the buffer or the source's mapped data */
+	unsigned char *buffer;
+	const unsigned char *input;
+	size_t input_length;
+	size_t input_position;
+	int input_end;
+
+	/* estimated uncompressed size, 0 if unknown */
+	size_t size;
+
+	/* all data handed out or the stream is broken */
+	int end;
+
+#ifdef HAVE_ZLIB
+	z_stream zlib;
+	int zlib_ready;
+#endif
+
+#ifdef HAVE_ZSTD
+	ZSTD_DStream *zstd;
+#endif
+} decompress_reader;
+
+
+/*----------------------------------------------------------------------------*/
+static int decompress_detect( const unsigned char *data, size_t size )
+{
+	if( size >= 2 && data[0] == 0x1f && data[1] == 0x8b )
+		return TL_FORMAT_GZIP;
+
+	if( size >= 4 && data[0] == 0x28 && data[1] == 0xb5
+		&& data[2] == 0x2f && data[3] == 0xfd )
+		return TL_FORMAT_ZSTD;
+
+	return TL_FORMAT_NONE;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* reads up to size bytes, fewer only at the end of the source */
+static size_t decompress_source_read( decompress_reader *reader, unsigned char *buffer, size_t size )
+{
+	size_t length = 0;
+
+	if( reader->header_length > 0 )
+	{
+		length = reader->header_length < size ? reader->header_length : size;
+		memcpy( buffer, reader->header, length );
+
+		reader->header_length -= length;
+		memmove( reader->header, reader->header + length, reader->header_length );
+
+		if( length == size )
+			return length;
+	}
+
+	return length + reader->source.read( reader->source.user_data, buffer + length, size - length );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* refills the input when it is used up */
+static void decompress_fill( decompress_reader *reader )
+{
+	if( reader->input_position < reader->input_length || reader->input_end )
+		return;
+
+	reader->input_length = decompress_source_read( reader,
+		reader->buffer, TL_DECOMPRESS_INPUT_SIZE );
+	reader->input_position = 0;
+
+	if( reader->input_length < TL_DECOMPRESS_INPUT_SIZE )
+		reader->input_end = 1;
+}
+
+
+#ifdef HAVE_ZLIB
+/*----------------------------------------------------------------------------*/
+static size_t decompress_gzip( decompress_reader *reader, unsigned char *buffer, size_t size )
+{
+	z_stream *zlib = &reader->zlib;
+	size_t available = reader->input_length - reader->input_position;
+	int result;
+
+	if( available > TL_DECOMPRESS_ZLIB_STEP )
+		available = TL_DECOMPRESS_ZLIB_STEP;
+	if( size > TL_DECOMPRESS_ZLIB_STEP )
+		size = TL_DECOMPRESS_ZLIB_STEP;
+
+	zlib->next_in = (Bytef *)(reader->input + reader->input_position);
+	zlib->avail_in = (uInt)available;
+	zlib->next_out = buffer;
+	zlib->avail_out = (uInt)size;
+
+	result = inflate( zlib, Z_NO_FLUSH );
+
+	reader->input_position += available - zlib->avail_in;
+	size -= zlib->avail_out;
+
+	if( result == Z_STREAM_END )
+	{
+		/* concatenated files are members of the same stream */
+		decompress_fill( reader );
+		if( reader->input_position < reader->input_length )
+			inflateReset( zlib );
+		else
+			reader->end = 1;
+	}
+	else if( result != Z_OK && result != Z_BUF_ERROR )
+	{
+		reader->end = 1;
+	}
+	else if( zlib->avail_out > 0 && reader->input_position == reader->input_length
+		&& reader->input_end )
+	{
+		/* truncated */
+		reader->end = 1;
+	}
+
+	return size;
+}
+#endif
+
+
+#ifdef HAVE_ZSTD
+/*----------------------------------------------------------------------------*/
+static size_t decompress_zstd( decompress_reader *reader, unsigned char *buffer, size_t size )
+{
+	ZSTD_inBuffer in;
+	ZSTD_outBuffer out;
+	size_t result;
+
+	in.src = reader->input;
+	in.size = reader->input_length;
+	in.pos = reader->input_position;
+
+	out.dst = buffer;
+	out.size = size;
+	out.pos = 0;
+
+	/* frames following each other are decoded one after the other */
+	result = ZSTD_decompressStream( reader->zstd, &out, &in );
+
+	reader->input_position = in.pos;
+
+	if( ZSTD_isError( result ) )
+		reader->end = 1;
+	else if( out.pos < out.size && in.pos == in.size && reader->input_end )
+		reader->end = 1;
+
+	return out.pos;
+}
+#endif
+
+
+/*----------------------------------------------------------------------------*/
+static size_t decompress_read( void *user_data, void *buffer, size_t size )
+{
+	decompress_reader *reader = (decompress_reader *)user_data;
+	unsigned char *out = (unsigned char *)buffer;
+	size_t length = 0;
+
+	/* uncompressed source that cannot seek back */
+	if( reader->format == TL_FORMAT_NONE )
+		return decompress_source_read( reader, out, size );
+
+	while( length < size && !reader->end )
+	{
+		decompress_fill( reader );
+
+#ifdef HAVE_ZLIB
+		if( reader->format == TL_FORMAT_GZIP )
+			length += decompress_gzip( reader, out + length, size - length );
+#endif
+
+#ifdef HAVE_ZSTD
+		if( reader->format == TL_FORMAT_ZSTD )
+			length += decompress_zstd( reader, out + length, size - length );
+#endif
+	}
+
+	return length;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t decompress_size( void *user_data )
+{
+	return ((decompress_reader *)user_data)->size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void decompress_close( void *user_data )
+{
+	decompress_reader *reader = (decompress_reader *)user_data;
+
+#ifdef HAVE_ZLIB
+	if( reader->zlib_ready )
+		inflateEnd( &reader->zlib );
+#endif
+
+#ifdef HAVE_ZSTD
+	if( reader->zstd != NULL )
+		ZSTD_freeDStream( reader->zstd );
+#endif
+
+	tlReaderClose( &reader->source );
+	free( reader->buffer );
+	free( reader );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the uncompressed size from the gzip trailer, modulo 4 GiB and only of the
+ * last member, or from the zstd frame header, 0 if unknown */
+static size_t decompress_estimate( decompress_reader *reader, const unsigned char *data,
+	size_t length, size_t source_size )
+{
+	unsigned char trailer[4];
+	size_t size = 0;
+
+	if( reader->format == TL_FORMAT_GZIP && source_size >= 18 )
+	{
+		if( reader->input_end && reader->input_length == source_size )
+		{
+			memcpy( trailer, reader->input + source_size - 4, 4 );
+		}
+		else if( reader->source.seek == NULL
+			|| reader->source.seek( reader->source.user_data, source_size - 4 ) != 0
+			|| reader->source.read( reader->source.user_data, trailer, 4 ) != 4 )
+		{
+			return 0;
+		}
+
+		size = (size_t)trailer[0] | ((size_t)trailer[1] << 8)
+			| ((size_t)trailer[2] << 16) | ((size_t)trailer[3] << 24);
+	}
+
+#ifdef HAVE_ZSTD
+	if( reader->format == TL_FORMAT_ZSTD )
+	{
+		unsigned long long content = ZSTD_getFrameContentSize( data, length );
+
+		if( content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR
+			&& content == (size_t)content )
+			size = (size_t)content;
+	}
+#else
+	(void)data;
+	(void)length;
+#endif
+
+	return size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* prepares the decoder for reader->format, 1 if it is not built in */
+static int decompress_start( decompress_reader *reader )
+{
+#ifdef HAVE_ZLIB
+	if( reader->format == TL_FORMAT_GZIP )
+	{
+		/* 32 accepts the gzip header */
+		if( inflateInit2( &reader->zlib, 15 + 32 ) != Z_OK )
+			return 1;
+
+		reader->zlib_ready = 1;
+		return 0;
+	}
+#endif
+
+#ifdef HAVE_ZSTD
+	if( reader->format == TL_FORMAT_ZSTD )
+	{
+		reader->zstd = ZSTD_createDStream();
+		if( reader->zstd == NULL || ZSTD_isError( ZSTD_initDStream( reader->zstd ) ) )
+			return 1;
+
+		return 0;
+	}
+#endif
+
+#if !defined(HAVE_ZLIB) && !defined(HAVE_ZSTD)
+	(void)reader;
+#endif
+
+	return 1;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderDecompress( tlReader *reader, tlReader *source )
+{
+	decompress_reader *decompress;
+	tlReader decompressed;
+	const unsigned char *data = NULL;
+	unsigned char header[TL_DECOMPRESS_HEADER_SIZE];
+	size_t length = 0, source_size = 0;
+	int format;
+
+	if( reader == NULL || source == NULL || source->read == NULL )
+		return 1;
+
+	/* look at the first bytes, in place if the source is in memory */
+	if( source->map != NULL )
+		data = (const unsigned char *)source->map( source->user_data, &length );
+
+	if( data == NULL )
+	{
+		if( source->seek != NULL && source->seek( source->user_data, 0 ) != 0 )
+		{
+			tlReaderClose( source );
+			return 1;
+		}
+
+		length = source->read( source->user_data, header, sizeof(header) );
+		data = header;
+
+		/* rewind if possible, hand the bytes out again otherwise */
+		if( source->seek != NULL && source->seek( source->user_data, 0 ) == 0 )
+			data = NULL;
+	}
+
+	format = decompress_detect( data != NULL ? data : header, length );
+
+	if( format == TL_FORMAT_NONE && data != header )
+	{
+		*reader = *source;
+		return 0;
+	}
+
+	decompress = malloc( sizeof(decompress_reader) );
+	if( decompress == NULL )
+	{
+		tlReaderClose( source );
+		return 1;
+	}
+
+	memset( decompress, 0, sizeof(decompress_reader) );
+	decompress->source = *source;
+	decompress->format = format;
+
+	if( data == header )
+	{
+		memcpy( decompress->header, header, length );
+		decompress->header_length = length;
+	}
+
+	if( source->size != NULL )
+		source_size = source->size( source->user_data );
+	else if( data != NULL && data != header )
+		source_size = length;
+
+	if( format != TL_FORMAT_NONE )
+	{
+		if( data != NULL && data != header )
+		{
+			/* decompress straight from memory */
+			decompress->input = data;
+			decompress->input_length = length;
+			decompress->input_end = 1;
+		}
+		else
+		{
+			decompress->buffer = malloc( TL_DECOMPRESS_INPUT_SIZE );
+			decompress->input = decompress->buffer;
+			if( decompress->buffer == NULL )
+			{
+				decompress_close( decompress );
+				return 1;
+			}
+		}
+
+		if( decompress_start( decompress ) != 0 )
+		{
+			decompress_close( decompress );
+			return 1;
+		}
+
+		decompress->size = decompress_estimate( decompress,
+			data != NULL ? data : header, length, source_size );
+
+		/* back to the start after looking at the trailer */
+		if( decompress->input != data && decompress->header_length == 0
+			&& source->seek( source->user_data, 0 ) != 0 )
+		{
+			decompress_close( decompress );
+			return 1;
+		}
+	}
+	else
+	{
+		decompress->size = source_size;
+	}
+
+	memset( &decompressed, 0, sizeof(tlReader) );
+	decompressed.user_data = decompress;
+	decompressed.read = decompress_read;
+	decompressed.size = decompress_size;
+	decompressed.close = decompress_close;
+
+	if( format == TL_FORMAT_NONE )
+	{
+		*reader = decompressed;
+		return 0;
+	}
+
+	/* inflate on a thread while the caller parses */
+	return tlReaderReadAhead( reader, &decompressed, 0, 0 );
+}
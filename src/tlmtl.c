@@ -0,0 +1,617 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "trimeshloader/tlmtl.h"
+#include "tlarena.h"
+#include "tlnumber.h"
+#include "tlthread.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+typedef enum tlMtlProperty
+{
+	MTL_PROPERTY_NEWMTL,
+	MTL_PROPERTY_AMBIENT,
+	MTL_PROPERTY_DIFFUSE,
+	MTL_PROPERTY_SPECULAR,
+	MTL_PROPERTY_EMISSIVE,
+	MTL_PROPERTY_SHININESS,
+	MTL_PROPERTY_TRANSPARENCY,
+	MTL_PROPERTY_DISSOLVE,
+	MTL_PROPERTY_OPTICAL_DENSITY,
+	MTL_PROPERTY_ILLUMINATION,
+	MTL_PROPERTY_TEXTURE
+} tlMtlProperty;
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct tlMtlKeyword
+{
+	const char *name;
+	size_t length;
+	tlMtlProperty property;
+
+	/* numbers following the keyword, 0 for a name */
+	int value_count;
+} tlMtlKeyword;
+
+
+/*----------------------------------------------------------------------------*/
+/* the most frequent keywords first */
+static const tlMtlKeyword mtl_keywords[] =
+{
+	{ "Kd",     2, MTL_PROPERTY_DIFFUSE,         3 },
+	{ "Ka",     2, MTL_PROPERTY_AMBIENT,         3 },
+	{ "Ks",     2, MTL_PROPERTY_SPECULAR,        3 },
+	{ "Ns",     2, MTL_PROPERTY_SHININESS,       1 },
+	{ "newmtl", 6, MTL_PROPERTY_NEWMTL,          0 },
+	{ "d",      1, MTL_PROPERTY_DISSOLVE,        1 },
+	{ "Tr",     2, MTL_PROPERTY_TRANSPARENCY,    1 },
+	{ "illum",  5, MTL_PROPERTY_ILLUMINATION,    1 },
+	{ "Ke",     2, MTL_PROPERTY_EMISSIVE,        3 },
+	{ "Ni",     2, MTL_PROPERTY_OPTICAL_DENSITY, 1 },
+	{ "map_Kd", 6, MTL_PROPERTY_TEXTURE,         0 }
+};
+
+#define MTL_KEYWORD_COUNT (sizeof(mtl_keywords) / sizeof(mtl_keywords[0]))
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct tlMtlMaterial
+{
+	char *name;
+	char *texture;
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float emissive[4];
+	float shininess;
+	float optical_density;
+	int illumination;
+} tlMtlMaterial;
+
+
+/*----------------------------------------------------------------------------*/
+struct tlMtlState
+{
+	/* names live here, they are freed all at once on reset */
+	tl_arena arena;
+
+	tlMtlMaterial *material_buffer;
+	size_t material_buffer_size;
+	size_t material_count;
+
+	/* a line split across tlMtlParse calls */
+	char *line_buffer;
+	size_t line_buffer_size;
+	size_t line_buffer_length;
+
+	/* parsed states are shared between OBJ states, trimeshes and caches */
+	size_t references;
+	tl_mutex *reference_lock;
+};
+
+
+/*----------------------------------------------------------------------------*/
+static int mtl_grow_buffer(
+	void **buffer,
+	size_t *buffer_size,
+	size_t count,
+	size_t element_size )
+{
+	size_t needed_size, new_size = 128;
+	void *new_buffer;
+
+	if( element_size != 0 && count > (size_t)-1 / element_size )
+		return 1;
+
+	needed_size = count * element_size;
+	if( needed_size <= *buffer_size )
+		return 0;
+
+	while( new_size < needed_size )
+	{
+		if( new_size > (size_t)-1 / 2 )
+		{
+			new_size = needed_size;
+			break;
+		}
+		new_size = new_size * 2;
+	}
+
+	new_buffer = realloc( *buffer, new_size );
+	if( new_buffer == NULL )
+		return 1;
+
+	*buffer = new_buffer;
+	*buffer_size = new_size;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int mtl_is_whitespace( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+/*----------------------------------------------------------------------------*/
+static const char *mtl_skip_whitespace( const char *ptr, const char *end )
+{
+	while( ptr < end && mtl_is_whitespace( *ptr ) )
+		ptr++;
+
+	return ptr;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static const char *mtl_find_whitespace( const char *ptr, const char *end )
+{
+	while( ptr < end && !mtl_is_whitespace( *ptr ) )
+		ptr++;
+
+	return ptr;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static const tlMtlKeyword *mtl_find_keyword( const char *command, size_t length )
+{
+	size_t i;
+
+	for( i = 0; i < MTL_KEYWORD_COUNT; i++ )
+	{
+		if( mtl_keywords[i].length == length
+			&& memcmp( mtl_keywords[i].name, command, length ) == 0 )
+			return &mtl_keywords[i];
+	}
+
+	return NULL;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void mtl_add_material( tlMtlState *state, const char *name, const char *name_end )
+{
+	static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	static const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	void *buffer = state->material_buffer;
+	tlMtlMaterial *material;
+
+	if( mtl_grow_buffer( &buffer, &state->material_buffer_size,
+		state->material_count + 1, sizeof(tlMtlMaterial) ) )
+		return;
+
+	state->material_buffer = buffer;
+
+	material = &state->material_buffer[state->material_count];
+	material->name = tl_arena_copy_span( &state->arena, name, name_end );
+	if( material->name == NULL )
+		return;
+
+	/* the same defaults as materials parsed by the OBJ parser */
+	material->texture = NULL;
+	memcpy( material->ambient, white, sizeof(white) );
+	memcpy( material->diffuse, white, sizeof(white) );
+	memcpy( material->specular, black, sizeof(black) );
+	memcpy( material->emissive, black, sizeof(black) );
+	material->shininess = 1.0f;
+	material->optical_density = 1.0f;
+	material->illumination = -1;
+
+	state->material_count++;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void mtl_set_opacity( tlMtlMaterial *material, float opacity )
+{
+	material->ambient[3] = opacity;
+	material->diffuse[3] = opacity;
+	material->specular[3] = opacity;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void mtl_process_command(
+	tlMtlState *state,
+	const tlMtlKeyword *keyword,
+	const char *parameter,
+	const char *parameter_end )
+{
+	tlMtlMaterial *material;
+	float values[3];
+	int count = 0;
+
+	if( keyword->property == MTL_PROPERTY_NEWMTL )
+	{
+		mtl_add_material( state, parameter, parameter_end );
+		return;
+	}
+
+	/* property without newmtl */
+	if( state->material_count == 0 )
+		return;
+
+	material = &state->material_buffer[state->material_count - 1];
+
+	if( keyword->property == MTL_PROPERTY_TEXTURE )
+	{
+		const char *name = parameter_end;
+
+		/* options come first, the file name is the last word */
+		while( name > parameter && !mtl_is_whitespace( name[-1] ) )
+			name--;
+
+		if( name < parameter_end )
+			material->texture = tl_arena_copy_span( &state->arena, name, parameter_end );
+		return;
+	}
+
+	while( count < keyword->value_count && parameter < parameter_end )
+	{
+		const char *next = tl_parse_float( parameter, parameter_end, &values[count] );
+
+		/* spectral or xyz colors are not supported */
+		if( next == parameter )
+			break;
+
+		parameter = mtl_skip_whitespace( next, parameter_end );
+		count++;
+	}
+
+	if( count == 0 )
+		return;
+
+	/* "Kd r" is a gray */
+	for( ; count < keyword->value_count; count++ )
+		values[count] = values[0];
+
+	switch( keyword->property )
+	{
+	case MTL_PROPERTY_AMBIENT:
+		memcpy( material->ambient, values, sizeof(float) * 3 );
+		break;
+
+	case MTL_PROPERTY_DIFFUSE:
+		memcpy( material->diffuse, values, sizeof(float) * 3 );
+		break;
+
+	case MTL_PROPERTY_SPECULAR:
+		memcpy( material->specular, values, sizeof(float) * 3 );
+		break;
+
+	case MTL_PROPERTY_EMISSIVE:
+		memcpy( material->emissive, values, sizeof(float) * 3 );
+		break;
+
+	/* scaled as the OBJ parser always did */
+	case MTL_PROPERTY_SHININESS:
+		material->shininess = values[0] / 255.0f;
+		break;
+
+	case MTL_PROPERTY_TRANSPARENCY:
+		mtl_set_opacity( material, 1.0f - (values[0] / 255.0f) );
+		break;
+
+	case MTL_PROPERTY_DISSOLVE:
+		mtl_set_opacity( material, values[0] );
+		break;
+
+	case MTL_PROPERTY_OPTICAL_DENSITY:
+		material->optical_density = values[0];
+		break;
+
+	case MTL_PROPERTY_ILLUMINATION:
+		material->illumination = (int)values[0];
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the line has to be free of comments */
+static void mtl_process_line( tlMtlState *state, const char *ptr, const char *end )
+{
+	const tlMtlKeyword *keyword;
+	const char *command;
+
+	/* trim */
+	ptr = mtl_skip_whitespace( ptr, end );
+	while( end > ptr && mtl_is_whitespace( end[-1] ) )
+		end--;
+
+	if( ptr == end )
+		return;
+
+	/* split command and parameter */
+	command = ptr;
+	ptr = mtl_find_whitespace( ptr, end );
+
+	keyword = mtl_find_keyword( command, (size_t)(ptr - command) );
+	if( keyword == NULL )
+		return;
+
+	mtl_process_command( state, keyword, mtl_skip_whitespace( ptr, end ), end );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int mtl_line_buffer_add( tlMtlState *state, const char *bytes, size_t size )
+{
+	void *buffer = state->line_buffer;
+
+	if( size > (size_t)-1 - state->line_buffer_length
+		|| mtl_grow_buffer( &buffer, &state->line_buffer_size,
+			state->line_buffer_length + size, 1 ) )
+		return 1;
+
+	state->line_buffer = buffer;
+
+	memcpy( state->line_buffer + state->line_buffer_length, bytes, size );
+	state->line_buffer_length += size;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void mtl_process_line_buffer( tlMtlState *state )
+{
+	const char *end = state->line_buffer + state->line_buffer_length;
+	const char *comment = memchr( state->line_buffer, '#', state->line_buffer_length );
+
+	mtl_process_line( state, state->line_buffer, comment != NULL ? comment : end );
+
+	state->line_buffer_length = 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlMtlState *tlMtlCreateState()
+{
+	tlMtlState *state = malloc( sizeof(tlMtlState) );
+
+	if( state )
+	{
+		memset( state, 0, sizeof(tlMtlState) );
+		state->references = 1;
+		state->reference_lock = tl_mutex_create();
+
+		/* shared states are released from several threads */
+		if( state->reference_lock == NULL && tl_thread_supported() )
+		{
+			free( state );
+			return NULL;
+		}
+	}
+
+	return state;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlMtlResetState( tlMtlState *state )
+{
+	if( state == NULL )
+		return 1;
+
+	/* all names at once */
+	tl_arena_release( &state->arena );
+
+	free( state->material_buffer );
+	free( state->line_buffer );
+
+	state->material_buffer = NULL;
+	state->material_buffer_size = 0;
+	state->material_count = 0;
+	state->line_buffer = NULL;
+	state->line_buffer_size = 0;
+	state->line_buffer_length = 0;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tlMtlRetainState( tlMtlState *state )
+{
+	if( state == NULL )
+		return;
+
+	tl_mutex_lock( state->reference_lock );
+	state->references++;
+	tl_mutex_unlock( state->reference_lock );
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tlMtlDestroyState( tlMtlState *state )
+{
+	size_t references;
+
+	if( state == NULL )
+		return;
+
+	tl_mutex_lock( state->reference_lock );
+	references = --state->references;
+	tl_mutex_unlock( state->reference_lock );
+
+	if( references == 0 )
+	{
+		tlMtlResetState( state );
+		tl_mutex_destroy( state->reference_lock );
+		free( state );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlMtlParse(
+	tlMtlState *state,
+	const char *bytes,
+	size_t size,
+	int last )
+{
+	const char *ptr = bytes, *end = bytes + size;
+
+	if( state == NULL )
+		return 1;
+
+	while( ptr < end )
+	{
+		const char *line_end = memchr( ptr, '\n', end - ptr );
+		const char *comment;
+
+		/* incomplete line, keep it for the next call */
+		if( line_end == NULL )
+		{
+			if( mtl_line_buffer_add( state, ptr, (size_t)(end - ptr) ) )
+				return 1;
+			break;
+		}
+
+		/* complete a line started in a previous call */
+		if( state->line_buffer_length > 0 )
+		{
+			if( mtl_line_buffer_add( state, ptr, (size_t)(line_end - ptr) ) )
+				return 1;
+			mtl_process_line_buffer( state );
+		}
+		else
+		{
+			comment = memchr( ptr, '#', line_end - ptr );
+			mtl_process_line( state, ptr, comment != NULL ? comment : line_end );
+		}
+
+		ptr = line_end + 1;
+	}
+
+	/* last line without line break */
+	if( last != 0 && state->line_buffer_length > 0 )
+		mtl_process_line_buffer( state );
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tlMtlMaterialCount( tlMtlState *state )
+{
+	if( state == NULL )
+		return 0;
+
+	return state->material_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+const char *tlMtlMaterialName( tlMtlState *state, size_t index )
+{
+	if( state == NULL || index >= state->material_count )
+		return NULL;
+
+	return state->material_buffer[index].name;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlMtlGetMaterial(
+	tlMtlState *state,
+	size_t index,
+	float *ambient,
+	float *diffuse,
+	float *specular,
+	float *shininess )
+{
+	tlMtlMaterial *material;
+
+	if( state == NULL || index >= state->material_count )
+		return 1;
+
+	material = &state->material_buffer[index];
+
+	if( ambient )
+		memcpy( ambient, material->ambient, sizeof(float) * 4 );
+
+	if( diffuse )
+		memcpy( diffuse, material->diffuse, sizeof(float) * 4 );
+
+	if( specular )
+		memcpy( specular, material->specular, sizeof(float) * 4 );
+
+	if( shininess )
+		*shininess = material->shininess;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlMtlGetMaterialEx(
+	tlMtlState *state,
+	size_t index,
+	float *emissive,
+	float *optical_density,
+	int *illumination )
+{
+	tlMtlMaterial *material;
+
+	if( state == NULL || index >= state->material_count )
+		return 1;
+
+	material = &state->material_buffer[index];
+
+	if( emissive )
+		memcpy( emissive, material->emissive, sizeof(float) * 4 );
+
+	if( optical_density )
+		*optical_density = material->optical_density;
+
+	if( illumination )
+		*illumination = material->illumination;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+const char *tlMtlMaterialTexture( tlMtlState *state, size_t index )
+{
+	if( state == NULL || index >= state->material_count )
+		return NULL;
+
+	return state->material_buffer[index].texture;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef TRIMESH_LOADER_NUMBER_H
+#define TRIMESH_LOADER_NUMBER_H
+
+/*
+ * Internal number parsing. Decimal text is converted with the Eisel-Lemire
+ * algorithm straight from a (not zero terminated) span, independent of the
+ * current locale and correctly rounded. Rare inputs (more than 19 digits,
+ * hex floats, inf/nan, ambiguous products) fall back to strtod.
+ *
+ * Both functions expect ptr to point at the number (no leading whitespace),
+ * never read at or beyond end and return the pointer behind the number. If
+ * there is no number, ptr is returned and value is set to zero.
+ */
+
+#if defined(_MSC_VER)
+	typedef unsigned __int64 tl_uint64;
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+	typedef unsigned long long tl_uint64;
+#elif defined(__GNUC__)
+	/* long long is an extension in C89 mode */
+	__extension__ typedef unsigned long long tl_uint64;
+#else
+	typedef unsigned long long tl_uint64;
+#endif
+
+/* 64 bit constant from two 32 bit halves, no LL suffix needed */
+#define TL_U64(hi, lo) ((((tl_uint64)(hi)) << 32) | (tl_uint64)(lo))
+
+const char *tl_parse_double( const char *ptr, const char *end, double *value );
+
+const char *tl_parse_float( const char *ptr, const char *end, float *value );
+
+#endif
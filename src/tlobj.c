@@ -22,37 +22,109 @@
  */
 
 #include "trimeshloader/tlobj.h"
+#include "tlnumber.h"
+#include "tlthread.h"
+#include "tlarena.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define OBJ_SIMD_AVX2
+	#define OBJ_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define OBJ_SIMD_SSE2
+#endif
+
+#if defined(OBJ_SIMD_SSE2) && defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+/* smallest piece of input tlObjParseParallel hands to a thread */
+#ifndef OBJ_PARALLEL_MIN_CHUNK
+	#define OBJ_PARALLEL_MIN_CHUNK (256 * 1024)
+#endif
+
+/* tlObjReserveEstimate samples this many windows of this size */
+#define OBJ_ESTIMATE_WINDOWS 8
+#define OBJ_ESTIMATE_WINDOW_SIZE (64 * 1024)
 
 /*----------------------------------------------------------------------------*/
-static char *obj_copy_string( const char *string )
+/* makes room for count elements, the size doubles starting at 128 bytes;
+ * fails instead of wrapping around when the size does not fit a size_t */
+static int obj_grow_buffer(
+	void **buffer,
+	size_t *buffer_size,
+	size_t count,
+	size_t element_size )
 {
-	size_t length = strlen( string );
-	char *ptr = malloc( length + 1 );
-	memcpy( ptr, string, length + 1 );
-	return ptr;
+	size_t needed_size, new_size = 128;
+	void *new_buffer;
+
+	if( element_size != 0 && count > (size_t)-1 / element_size )
+		return 1;
+
+	needed_size = count * element_size;
+	if( needed_size <= *buffer_size )
+		return 0;
+
+	while( new_size < needed_size )
+	{
+		if( new_size > (size_t)-1 / 2 )
+		{
+			new_size = needed_size;
+			break;
+		}
+		new_size = new_size * 2;
+	}
+
+	new_buffer = realloc( *buffer, new_size );
+	if( new_buffer == NULL )
+		return 1;
+
+	*buffer = new_buffer;
+	*buffer_size = new_size;
+
+	return 0;
 }
 
 /*----------------------------------------------------------------------------*/
 typedef enum tlObjParsingState
 {
-	OBJ_STATE_SEARCH_COMMAND,
-	OBJ_STATE_PARSE_COMMAND,
-	OBJ_STATE_SEARCH_PARAMETER,
-	OBJ_STATE_PARSE_PARAMETER,
-	OBJ_STATE_SKIP_COMMENT,
+	OBJ_STATE_PARSE_LINES,
 	OBJ_STATE_DONE
 } tlObjParsingState;
 
 
+/*----------------------------------------------------------------------------*/
+typedef enum tlObjKeyword
+{
+	OBJ_KEYWORD_UNKNOWN,
+	OBJ_KEYWORD_OBJECT,          /* o */
+	OBJ_KEYWORD_VERTEX,          /* v */
+	OBJ_KEYWORD_NORMAL,          /* vn */
+	OBJ_KEYWORD_TEXCOORD,        /* vt */
+	OBJ_KEYWORD_FACE,            /* f */
+	OBJ_KEYWORD_MTLLIB,          /* mtllib */
+	OBJ_KEYWORD_USEMTL,          /* usemtl */
+	OBJ_KEYWORD_NEWMTL,          /* newmtl */
+	OBJ_KEYWORD_AMBIENT,         /* Ka */
+	OBJ_KEYWORD_DIFFUSE,         /* Kd */
+	OBJ_KEYWORD_SPECULAR,        /* Ks */
+	OBJ_KEYWORD_SHININESS,       /* Ns */
+	OBJ_KEYWORD_TRANSPARENCY     /* Tr */
+} tlObjKeyword;
+
+
 /*----------------------------------------------------------------------------*/
 typedef struct tlObjObject
 {
 	char *name;
-	unsigned int index, count;
+	size_t index, count;
 } tlObjObject;
 
 /*----------------------------------------------------------------------------*/
@@ -69,8 +141,8 @@ typedef struct tlObjMaterial
 typedef struct tlObjMaterialReference
 {
 	char *name;
-	unsigned int face_index;
-	unsigned int face_count;
+	size_t face_index;
+	size_t face_count;
 } tlObjMaterialReference;
 
 /*----------------------------------------------------------------------------*/
@@ -79,74 +151,211 @@ typedef struct vertex_map_item
 	int v;
 	unsigned int vt;
 	unsigned int vn;
-	unsigned int index;
 } obj_vertex_map_item;
 
+/* unused hash slot, tables are cleared with 0xFF bytes */
+#define OBJ_VERTEX_HASH_EMPTY 0xFFFFFFFFu
+
+/*----------------------------------------------------------------------------*/
+/* a buffer that was replaced while snapshots up to epoch may read it */
+typedef struct obj_retired_buffer
+{
+	void *buffer;
+	unsigned long epoch;
+	struct obj_retired_buffer *next;
+} obj_retired_buffer;
+
+/*----------------------------------------------------------------------------*/
+struct tlObjSnapshot
+{
+	tlObjState *state;
+	tlObjSnapshot *next;
+	unsigned long epoch;
+
+	size_t real_size;
+
+	const tlObjObject *objects;
+	size_t object_count;
+
+	const unsigned int *faces;
+	size_t face_count;
+
+	const obj_vertex_map_item *vertices;
+	size_t vertex_count;
+
+	const void *points, *texcoords, *normals;
+	size_t point_count, texcoord_count, normal_count;
+};
+
 /*----------------------------------------------------------------------------*/
 struct tlObjState
 {
-	tlObjObject **object_buffer;
-	unsigned int object_buffer_size;
-	unsigned int object_count;
+	/* names live here, they are freed all at once on reset */
+	tl_arena arena;
+
+	tlObjObject *object_buffer;
+	size_t object_buffer_size;
+	size_t object_count;
 
 	tlObjMaterial *material_buffer;
-	unsigned int  material_count;
+	size_t material_buffer_size;
+	size_t material_count;
+	size_t default_material_count;
+
+	/* material libraries owned by the state, their materials follow */
+	tlMtlState **adopted_buffer;
+	size_t adopted_buffer_size;
+	size_t adopted_count;
 
 	tlObjMaterialReference *material_reference_buffer;
-	unsigned int    material_reference_count;
-	unsigned int    last_material_face;
+	size_t material_reference_buffer_size;
+	size_t material_reference_count;
+	size_t last_material_face;
 
 	char **mtllib_buffer;
-	unsigned int mtllib_count;
+	size_t mtllib_buffer_size;
+	size_t mtllib_count;
 
-	double *point_buffer;
-	unsigned int point_buffer_size;
-	unsigned int point_count;
+	/* coordinates are double, or float with TL_OBJ_SINGLE_PRECISION */
+	size_t real_size;
 
-	double *texcoord_buffer;
-	unsigned int texcoord_buffer_size;
-	unsigned int texcoord_count;
+	void *point_buffer;
+	size_t point_buffer_size;
+	size_t point_count;
 
-	double *normal_buffer;
-	unsigned int normal_buffer_size;
-	unsigned int normal_count;
+	void *texcoord_buffer;
+	size_t texcoord_buffer_size;
+	size_t texcoord_count;
+
+	void *normal_buffer;
+	size_t normal_buffer_size;
+	size_t normal_count;
 
 	unsigned int *face_buffer;
-	unsigned int face_buffer_size;
-	unsigned int face_count;
+	size_t face_buffer_size;
+	size_t face_count;
+
+	/* vertex records in index order, the hash maps (v, vt, vn) to them */
+	unsigned int *vertex_hash_buffer;
+	size_t vertex_hash_mask;
 
 	obj_vertex_map_item *vertex_map_buffer;
-	unsigned int vertex_map_buffer_size;
-	unsigned int vertex_map_count;
+	size_t vertex_map_buffer_size;
+	size_t vertex_map_count;
 
 	tlObjParsingState parsing_state;
-	tlObjParsingState previous_parsing_state;
 
-	char *command_buffer;
-	unsigned int command_buffer_size;
-	unsigned int command_buffer_length;
+	/* incomplete line carried over from the previous tlObjParse call */
+	char *line_buffer;
+	size_t line_buffer_size;
+	size_t line_buffer_length;
+
+	/* set by tlObjSetCallbacks, nothing but the counts is stored then */
+	int use_callbacks;
+	tlObjCallbacks callbacks;
+
+	/* zero terminated name and face corners of the current line */
+	char *name_buffer;
+	size_t name_buffer_size;
+	tlObjCorner *corner_buffer;
+	size_t corner_buffer_size;
+
+	/* live snapshots, oldest first, and the buffers they may still read */
+	tlObjSnapshot *snapshot_list;
+	unsigned long snapshot_epoch;
+	obj_retired_buffer *retired_list;
+};
+
+/*----------------------------------------------------------------------------*/
+/* obj_grow_buffer for the buffers snapshots see, these are moved instead of
+ * reallocated while a snapshot is alive and the old one is kept around */
+static int obj_state_grow_buffer(
+	tlObjState *state,
+	void **buffer,
+	size_t *buffer_size,
+	size_t count,
+	size_t element_size )
+{
+	void *new_buffer = NULL;
+	size_t new_size = 0;
+	obj_retired_buffer *retired;
+
+	if( state->snapshot_list == NULL || *buffer == NULL )
+		return obj_grow_buffer( buffer, buffer_size, count, element_size );
 
-	char *parameter_buffer;
-	unsigned int parameter_buffer_size;
-	unsigned int parameter_buffer_length;
+	if( element_size != 0 && count <= (size_t)-1 / element_size
+		&& count * element_size <= *buffer_size )
+		return 0;
 
-};
+	retired = malloc( sizeof(obj_retired_buffer) );
+	if( retired == NULL )
+		return 1;
+
+	if( obj_grow_buffer( &new_buffer, &new_size, count, element_size ) )
+	{
+		free( retired );
+		return 1;
+	}
+
+	memcpy( new_buffer, *buffer, *buffer_size );
+
+	retired->buffer = *buffer;
+	retired->epoch = state->snapshot_epoch;
+	retired->next = state->retired_list;
+	state->retired_list = retired;
+
+	*buffer = new_buffer;
+	*buffer_size = new_size;
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* frees what no live snapshot can read, everything if there is none */
+static void obj_state_free_retired( tlObjState *state )
+{
+	obj_retired_buffer **link = &state->retired_list;
+
+	while( *link != NULL )
+	{
+		obj_retired_buffer *retired = *link;
+
+		if( state->snapshot_list == NULL || retired->epoch < state->snapshot_list->epoch )
+		{
+			*link = retired->next;
+			free( retired->buffer );
+			free( retired );
+		}
+		else
+			link = &retired->next;
+	}
+}
+
+/*----------------------------------------------------------------------------*/
+static char *obj_state_copy_string( tlObjState *state, const char *string )
+{
+	return tl_arena_copy_span( &state->arena, string, string + strlen( string ) );
+}
 
 /*----------------------------------------------------------------------------*/
-static void obj_state_add_material( tlObjState *state, char *name )
+static void obj_state_add_material(
+	tlObjState *state,
+	const char *name,
+	const char *name_end )
 {
 	float defAmbient[4] = {1.0, 1.0, 1.0, 1.0};
 	float           defSpecular[4]  = {0.0, 0.0, 0.0, 1.0};
-	unsigned int    new_size    = (state->material_count + 1 ) * sizeof(tlObjMaterial);
-	tlObjMaterial   *new_buffer = realloc( state->material_buffer, new_size );
+	void            *buffer     = state->material_buffer;
 
-	if ( new_buffer == NULL )
+	if( obj_grow_buffer( &buffer, &state->material_buffer_size,
+		state->material_count + 1, sizeof(tlObjMaterial) ) )
 		return;
 	else
-		state->material_buffer = new_buffer;
+		state->material_buffer = buffer;
 
 	/* copy the name */
-	state->material_buffer[state->material_count].name = obj_copy_string( name );
+	state->material_buffer[state->material_count].name
+		= tl_arena_copy_span( &state->arena, name, name_end );
 
 	/* set default material */
 	memcpy(state->material_buffer[state->material_count].ambient, defAmbient, sizeof(float) * 4);
@@ -158,46 +367,158 @@ static void obj_state_add_material( tlObjState *state, char *name )
 }
 
 /*----------------------------------------------------------------------------*/
-static void obj_material_set_property( tlObjState *state, float *props )
+static int obj_keyword_is(
+	const char *command,
+	size_t command_length,
+	const char *name,
+	size_t name_length )
+{
+	return command_length == name_length
+		&& memcmp( command, name, name_length ) == 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* one switch on the first character, new keywords only add a case */
+static tlObjKeyword obj_classify_keyword(
+	const char *command,
+	size_t command_length )
+{
+	if( command_length == 0 )
+		return OBJ_KEYWORD_UNKNOWN;
+
+	switch( command[0] )
+	{
+	case 'o':
+		if( command_length == 1 )
+			return OBJ_KEYWORD_OBJECT;
+		break;
+
+	case 'v':
+		if( command_length == 1 )
+			return OBJ_KEYWORD_VERTEX;
+		if( command_length == 2 )
+		{
+			if( command[1] == 'n' )
+				return OBJ_KEYWORD_NORMAL;
+			if( command[1] == 't' )
+				return OBJ_KEYWORD_TEXCOORD;
+		}
+		break;
+
+	case 'f':
+		if( command_length == 1 )
+			return OBJ_KEYWORD_FACE;
+		break;
+
+	case 'm':
+		if( obj_keyword_is( command, command_length, "mtllib", 6 ) )
+			return OBJ_KEYWORD_MTLLIB;
+		break;
+
+	case 'u':
+		if( obj_keyword_is( command, command_length, "usemtl", 6 ) )
+			return OBJ_KEYWORD_USEMTL;
+		break;
+
+	case 'n':
+		if( obj_keyword_is( command, command_length, "newmtl", 6 ) )
+			return OBJ_KEYWORD_NEWMTL;
+		break;
+
+	case 'K':
+		if( command_length == 2 )
+		{
+			switch( command[1] )
+			{
+			case 'a': return OBJ_KEYWORD_AMBIENT;
+			case 'd': return OBJ_KEYWORD_DIFFUSE;
+			case 's': return OBJ_KEYWORD_SPECULAR;
+			}
+		}
+		break;
+
+	case 'N':
+		if( command_length == 2 && command[1] == 's' )
+			return OBJ_KEYWORD_SHININESS;
+		break;
+
+	case 'T':
+		if( command_length == 2 && command[1] == 'r' )
+			return OBJ_KEYWORD_TRANSPARENCY;
+		break;
+	}
+
+	return OBJ_KEYWORD_UNKNOWN;
+}
+
+/*----------------------------------------------------------------------------*/
+static void obj_material_set_property(
+	tlObjState *state,
+	tlObjKeyword keyword,
+	float *props )
 {
-	int last_mat_index = state->material_count - 1;
+	size_t last_mat_index;
+
+	/* only if the default materials could not be allocated */
+	if( state->material_count == 0 )
+		return;
+
+	last_mat_index = state->material_count - 1;
 
-	if( strcmp(state->command_buffer, "Ka") == 0 )
+	switch( keyword )
+	{
+	case OBJ_KEYWORD_AMBIENT:
 		memcpy( state->material_buffer[last_mat_index].ambient, props, sizeof(float) * 3 );
-	else if( strcmp(state->command_buffer, "Kd") == 0 )
-		memcpy(state->material_buffer[last_mat_index].diffuse, props, sizeof(float) * 3 );
-	else if( strcmp(state->command_buffer, "Ks") == 0 )
+		break;
+
+	case OBJ_KEYWORD_DIFFUSE:
+		memcpy( state->material_buffer[last_mat_index].diffuse, props, sizeof(float) * 3 );
+		break;
+
+	case OBJ_KEYWORD_SPECULAR:
 		memcpy( state->material_buffer[last_mat_index].specular, props, sizeof(float) * 3 );
-	else if( strcmp(state->command_buffer, "Ns") == 0 )
+		break;
+
+	case OBJ_KEYWORD_SHININESS:
 		state->material_buffer[last_mat_index].shininess = *props / 255.0f;
-	else if( strcmp(state->command_buffer, "Tr") == 0 )
-	{
-		float opacity = 1.0f - (*props / 255.0f);
+		break;
+
+	case OBJ_KEYWORD_TRANSPARENCY:
+		{
+			float opacity = 1.0f - (*props / 255.0f);
+
+			state->material_buffer[last_mat_index].ambient[3]   = opacity;
+			state->material_buffer[last_mat_index].diffuse[3]   = opacity;
+			state->material_buffer[last_mat_index].specular[3]  = opacity;
+		}
+		break;
 
-		state->material_buffer[last_mat_index].ambient[3]   = opacity;
-		state->material_buffer[last_mat_index].diffuse[3]   = opacity;
-		state->material_buffer[last_mat_index].specular[3]  = opacity;
+	default:
+		break;
 	}
 }
 
+/* white, red, green, blue, yellow, magenta, cyan and black */
+#define OBJ_DEFAULT_MATERIAL_COUNT 8
+
 /*----------------------------------------------------------------------------*/
 static void obj_material_add_defaults( tlObjState *state )
 {
-	int last_mat_index = state->material_count;
+	size_t last_mat_index = state->material_count;
 	float defAmbient[4] = {1.0, 1.0, 1.0, 1.0};
 	float defSpecular[4] = {0.0, 0.0, 0.0, 1.0};
-	unsigned int new_size = (last_mat_index + 8 ) * sizeof(tlObjMaterial);
-	tlObjMaterial *new_buffer = realloc( state->material_buffer, new_size );
+	void *buffer = state->material_buffer;
 
-	if( new_buffer == NULL )
+	if( obj_grow_buffer( &buffer, &state->material_buffer_size,
+		last_mat_index + OBJ_DEFAULT_MATERIAL_COUNT, sizeof(tlObjMaterial) ) )
 		return;
 	else
-		state->material_buffer = new_buffer;
+		state->material_buffer = buffer;
 
 	defAmbient[0] = 1.0;
 	defAmbient[1] = 1.0;
 	defAmbient[2] = 1.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "white" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "white" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4 );
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4 );
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4 );
@@ -207,7 +528,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 1.0;
 	defAmbient[1] = 0.0;
 	defAmbient[2] = 0.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "red" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "red" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -217,7 +538,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 0.0;
 	defAmbient[1] = 1.0;
 	defAmbient[2] = 0.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "green" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "green" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -227,7 +548,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 0.0;
 	defAmbient[1] = 0.0;
 	defAmbient[2] = 1.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "blue" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "blue" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -237,7 +558,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 1.0;
 	defAmbient[1] = 1.0;
 	defAmbient[2] = 0.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "yellow" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "yellow" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -247,7 +568,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 1.0;
 	defAmbient[1] = 0.0;
 	defAmbient[2] = 1.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "magenta" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "magenta" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -257,7 +578,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 0.0;
 	defAmbient[1] = 1.0;
 	defAmbient[2] = 1.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "cyan" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "cyan" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -267,7 +588,7 @@ static void obj_material_add_defaults( tlObjState *state )
 	defAmbient[0] = 0.0;
 	defAmbient[1] = 0.0;
 	defAmbient[2] = 0.0;
-	state->material_buffer[last_mat_index].name = obj_copy_string( "black" );
+	state->material_buffer[last_mat_index].name = obj_state_copy_string( state, "black" );
 	memcpy( state->material_buffer[last_mat_index].ambient, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].diffuse, defAmbient, sizeof(float) * 4);
 	memcpy( state->material_buffer[last_mat_index].specular, defSpecular, sizeof(float) * 4);
@@ -275,29 +596,33 @@ static void obj_material_add_defaults( tlObjState *state )
 	last_mat_index++;
 
 	state->material_count = last_mat_index;
+	state->default_material_count = OBJ_DEFAULT_MATERIAL_COUNT;
 }
 
 /*----------------------------------------------------------------------------*/
-static void obj_add_material_reference( tlObjState *state, char *name )
+static void obj_add_material_reference(
+	tlObjState *state,
+	const char *name,
+	const char *name_end )
 {
-	unsigned int new_size = (state->material_reference_count + 1) * sizeof(tlObjMaterialReference);
-	tlObjMaterialReference *new_buffer = realloc( state->material_reference_buffer, new_size );
+	void *buffer = state->material_reference_buffer;
 
-	if( new_buffer == NULL )
+	if( obj_grow_buffer( &buffer, &state->material_reference_buffer_size,
+		state->material_reference_count + 1, sizeof(tlObjMaterialReference) ) )
 		return;
 	else
-		state->material_reference_buffer = new_buffer;
+		state->material_reference_buffer = buffer;
 
 	state->material_reference_buffer[state->material_reference_count].name
-		= obj_copy_string( name );
+		= tl_arena_copy_span( &state->arena, name, name_end );
 	state->material_reference_count++;
 }
 
 /*----------------------------------------------------------------------------*/
 static void obj_material_reference_set_range(
 	tlObjState *state,
-	unsigned int face_index,
-	unsigned int face_count )
+	size_t face_index,
+	size_t face_count )
 {
 	state->material_reference_buffer[state->material_reference_count - 1].face_index
 		= face_index;
@@ -305,345 +630,547 @@ static void obj_material_reference_set_range(
 		= face_count;
 }
 
+/*----------------------------------------------------------------------------*/
+/* ' ', '\t', '\n' and '\r' */
+static const unsigned char obj_whitespace_table[256] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
 /*----------------------------------------------------------------------------*/
 static int obj_is_whitespace( char c )
 {
-	if( c == ' ' )
-		return 1;
+	return obj_whitespace_table[ (unsigned char)c ];
+}
 
-	if( c == '\n' )
-		return 1;
 
-	if( c == '\t' )
-		return 1;
+/*----------------------------------------------------------------------------*/
+static const char *obj_skip_whitespace( const char *ptr, const char *end )
+{
+	while( ptr < end && obj_is_whitespace( *ptr ) )
+		ptr++;
 
-	if( c == '\r' )
-		return 1;
+	return ptr;
+}
 
-	return 0;
+
+#ifdef OBJ_SIMD_SSE2
+/*----------------------------------------------------------------------------*/
+static unsigned int obj_first_bit( unsigned int mask )
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward( &index, mask );
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz( mask );
+#endif
 }
+#endif
 
 
 /*----------------------------------------------------------------------------*/
-static int obj_state_add_point(
-	tlObjState *state,
-	double x,
-	double y,
-	double z )
+/* find the first a or b, 64 bytes per step where the cpu allows it */
+static const char *obj_find_either(
+	const char *ptr,
+	const char *end,
+	char a,
+	char b )
 {
-	unsigned int needed_size = (state->point_count + 1) * 3 * sizeof(double);
+#ifdef OBJ_SIMD_AVX2
+	const __m256i a32 = _mm256_set1_epi8( a );
+	const __m256i b32 = _mm256_set1_epi8( b );
 
-	if( needed_size > state->point_buffer_size )
+	while( end - ptr >= 64 )
 	{
-		unsigned int new_size = 128;
-		double *new_buffer;
+		__m256i lo = _mm256_loadu_si256( (const __m256i *)ptr );
+		__m256i hi = _mm256_loadu_si256( (const __m256i *)(ptr + 32) );
+		unsigned int lo_mask = (unsigned int)_mm256_movemask_epi8( _mm256_or_si256(
+			_mm256_cmpeq_epi8( lo, a32 ), _mm256_cmpeq_epi8( lo, b32 ) ) );
+		unsigned int hi_mask = (unsigned int)_mm256_movemask_epi8( _mm256_or_si256(
+			_mm256_cmpeq_epi8( hi, a32 ), _mm256_cmpeq_epi8( hi, b32 ) ) );
 
-		while( new_size < needed_size )
-			new_size = new_size * 2;
+		if( lo_mask )
+			return ptr + obj_first_bit( lo_mask );
 
-		new_buffer = realloc( state->point_buffer, new_size );
-		if( new_buffer == 0 )
-			return 1;
+		if( hi_mask )
+			return ptr + 32 + obj_first_bit( hi_mask );
 
-		state->point_buffer = new_buffer;
-		state->point_buffer_size = new_size;
+		ptr += 64;
 	}
+#endif
 
-	state->point_buffer[state->point_count*3] = x;
-	state->point_buffer[state->point_count*3+1] = y;
-	state->point_buffer[state->point_count*3+2] = z;
-	state->point_count++;
+#ifdef OBJ_SIMD_SSE2
+	{
+		const __m128i a16 = _mm_set1_epi8( a );
+		const __m128i b16 = _mm_set1_epi8( b );
 
-	return 0;
+		while( end - ptr >= 16 )
+		{
+			__m128i block = _mm_loadu_si128( (const __m128i *)ptr );
+			unsigned int mask = (unsigned int)_mm_movemask_epi8( _mm_or_si128(
+				_mm_cmpeq_epi8( block, a16 ), _mm_cmpeq_epi8( block, b16 ) ) );
+
+			if( mask )
+				return ptr + obj_first_bit( mask );
+
+			ptr += 16;
+		}
+	}
+#endif
+
+	while( ptr < end )
+	{
+		if( *ptr == a || *ptr == b )
+			return ptr;
+		ptr++;
+	}
+
+	return NULL;
 }
 
 
 /*----------------------------------------------------------------------------*/
-static int obj_state_add_normal(
-	tlObjState *state,
-	double x,
-	double y,
-	double z )
+/* find the end of a token, 16 bytes per step where the cpu allows it */
+static const char *obj_find_whitespace( const char *ptr, const char *end )
 {
-	unsigned int needed_size = (state->normal_count + 1) * 3 * sizeof(double);
+#ifdef OBJ_SIMD_SSE2
+	const __m128i space = _mm_set1_epi8( ' ' );
+	const __m128i tab = _mm_set1_epi8( '\t' );
+	const __m128i cr = _mm_set1_epi8( '\r' );
+	const __m128i lf = _mm_set1_epi8( '\n' );
 
-	if( needed_size > state->normal_buffer_size )
+	while( end - ptr >= 16 )
 	{
-		unsigned int new_size = 128;
-		double *new_buffer;
-
-		while( new_size < needed_size )
-			new_size = new_size * 2;
+		__m128i block = _mm_loadu_si128( (const __m128i *)ptr );
+		__m128i ws = _mm_or_si128(
+			_mm_or_si128( _mm_cmpeq_epi8( block, space ), _mm_cmpeq_epi8( block, tab ) ),
+			_mm_or_si128( _mm_cmpeq_epi8( block, cr ), _mm_cmpeq_epi8( block, lf ) ) );
+		unsigned int mask = (unsigned int)_mm_movemask_epi8( ws );
 
-		new_buffer = realloc( state->normal_buffer, new_size );
-		if( new_buffer == NULL )
-			return 1;
+		if( mask )
+			return ptr + obj_first_bit( mask );
 
-		state->normal_buffer = new_buffer;
-		state->normal_buffer_size = new_size;
+		ptr += 16;
 	}
+#endif
 
-	state->normal_buffer[state->normal_count*3] = x;
-	state->normal_buffer[state->normal_count*3+1] = y;
-	state->normal_buffer[state->normal_count*3+2] = z;
-	state->normal_count++;
+	while( ptr < end && !obj_is_whitespace( *ptr ) )
+		ptr++;
 
-	return 0;
+	return ptr;
 }
 
+
 /*----------------------------------------------------------------------------*/
-static int obj_state_add_texcoord( tlObjState *state, double u, double v )
+static double obj_parse_real( const char **ptr, const char *end )
 {
-	unsigned int needed_size = (state->texcoord_count + 1) * 2 * sizeof(double);
+	double value;
 
-	if( needed_size > state->texcoord_buffer_size )
-	{
-		unsigned int new_size = 128;
-		double *new_buffer;
+	*ptr = obj_skip_whitespace( *ptr, end );
+	*ptr = tl_parse_double( *ptr, end, &value );
 
-		while( new_size < needed_size )
-			new_size = new_size * 2;
+	return value;
+}
 
-		new_buffer = realloc( state->texcoord_buffer, new_size );
-		if( new_buffer == NULL )
-			return 1;
 
-		state->texcoord_buffer = new_buffer;
-		state->texcoord_buffer_size = new_size;
-	}
+/*----------------------------------------------------------------------------*/
+/* count numbers straight into values, as float if real_size says so */
+static void obj_parse_reals(
+	const char *ptr,
+	const char *end,
+	void *values,
+	unsigned int count,
+	size_t real_size )
+{
+	unsigned int i;
+
+	if( real_size == sizeof(float) )
+	{
+		float *value = (float *)values;
 
-	state->texcoord_buffer[state->texcoord_count*2] = u;
-	state->texcoord_buffer[state->texcoord_count*2+1] = v;
-	state->texcoord_count++;
+		for( i = 0; i < count; i++ )
+		{
+			ptr = obj_skip_whitespace( ptr, end );
+			ptr = tl_parse_float( ptr, end, &value[i] );
+		}
+	}
+	else
+	{
+		double *value = (double *)values;
 
-	return 0;
+		for( i = 0; i < count; i++ )
+		{
+			ptr = obj_skip_whitespace( ptr, end );
+			ptr = tl_parse_double( ptr, end, &value[i] );
+		}
+	}
 }
 
+
 /*----------------------------------------------------------------------------*/
-static int obj_vertex_map_item_cmp( obj_vertex_map_item *a, obj_vertex_map_item *b )
+static double obj_state_real( const tlObjState *state, const void *buffer, size_t index )
 {
-	if( a->v > b->v )
-		return 1;
-	else if( a->v < b->v )
-		return -1;
-
-	if( a->vt > b->vt )
-		return 1;
-	else if( a->vt < b->vt )
-		return -1;
-
-	if( a->vn > b->vn )
-		return 1;
-	else if( a->vn < b->vn )
-		return -1;
+	if( state->real_size == sizeof(float) )
+		return ((const float *)buffer)[index];
 
-	return 0;
+	return ((const double *)buffer)[index];
 }
 
+
 /*----------------------------------------------------------------------------*/
-static int obj_state_map_vertex_find(
-	tlObjState *state,
-	unsigned int v,
-	unsigned int vt,
-	unsigned int vn,
-	unsigned int *index )
+/* number of leading digits in 8 bytes, their values are left in *digits */
+static unsigned int obj_digit_count_8( const char *ptr, tl_uint64 *digits )
 {
-	/* try to find an existing one */
-	if( state->vertex_map_count > 0 )
+	const unsigned char *bytes = (const unsigned char *)ptr;
+	tl_uint64 x, mask;
+	unsigned int count;
+
+	/* little endian load regardless of the host, compilers merge this */
+	x = (tl_uint64)bytes[0] | ((tl_uint64)bytes[1] << 8) |
+		((tl_uint64)bytes[2] << 16) | ((tl_uint64)bytes[3] << 24) |
+		((tl_uint64)bytes[4] << 32) | ((tl_uint64)bytes[5] << 40) |
+		((tl_uint64)bytes[6] << 48) | ((tl_uint64)bytes[7] << 56);
+
+	/* digits become 0..9, the high bit marks every other byte */
+	x ^= TL_U64( 0x30303030, 0x30303030 );
+	mask = (((x & TL_U64( 0x7F7F7F7F, 0x7F7F7F7F )) + TL_U64( 0x76767676, 0x76767676 )) | x) &
+		TL_U64( 0x80808080, 0x80808080 );
+
+	if( mask == 0 )
+		count = 8;
+	else
 	{
-   		obj_vertex_map_item a = { v, vt, vn, 0 };
-   	    int left = 0;
-    	int center = 1;
-    	int right = state->vertex_map_count - 1;
-
-		while( left <= right )
+#if defined(__GNUC__)
+		count = (unsigned int)__builtin_ctzll( mask ) >> 3;
+#else
+		count = 0;
+		while( !(mask & 0x80) )
 		{
-			int cmp;
-			center = (left + right) / 2;
-
-			cmp = obj_vertex_map_item_cmp( &state->vertex_map_buffer[center], &a );
-			if( cmp == 0 )
-			{
-				*index = state->vertex_map_buffer[center].index;
-				return 1;
-			}
-			else if( cmp > 0 )
-				right = center - 1;
-			else
-				left = center + 1;
-    	}
+			mask >>= 8;
+			count++;
+		}
+#endif
 	}
 
-	return 0;
+	*digits = x;
+	return count;
 }
 
+
 /*----------------------------------------------------------------------------*/
-static unsigned int obj_state_map_vertex_insert(
-	tlObjState *state,
-	unsigned int v,
-	unsigned int vt,
-	unsigned int vn )
+/* converts 8 digit values (first digit in the lowest byte) in three multiplies */
+static unsigned int obj_digits_value_8( tl_uint64 x )
 {
-	unsigned int i = 0;
-   	unsigned int left = 0;
-   	obj_vertex_map_item a = {v, vt, vn, 0 };
+	const tl_uint64 mask = TL_U64( 0x000000FF, 0x000000FF );
 
-	/* bring us close */
-   	if( state->vertex_map_count > 8 )
-   	{
-	   	unsigned int right = state->vertex_map_count - 1;
+	x = (x * 10) + (x >> 8);
+	x = (((x & mask) * TL_U64( 0x000F4240, 0x00000064 )) +
+		(((x >> 16) & mask) * TL_U64( 0x00002710, 0x00000001 ))) >> 32;
 
-		while( (right - left) > 4 )
-		{
-			i = left + ((right - left) / 2);
+	return (unsigned int)x;
+}
 
-			if( obj_vertex_map_item_cmp( &state->vertex_map_buffer[i], &a ) >= 0 )
-				right = i - 1;
-			else
-				left = i + 1;
-		}
-   	}
 
-	/* find first greater */
-	for( i = left; i < state->vertex_map_count; i++ )
+/*----------------------------------------------------------------------------*/
+/* decimal integer with optional sign, no whitespace skipping, the
+ * magnitude is clamped to INT_MAX */
+static const char *obj_scan_index( const char *ptr, const char *end, int *value )
+{
+	const char *start = ptr;
+	unsigned int result = 0;
+	int negative = 0;
+
+	*value = 0;
+
+	if( ptr < end && (*ptr == '-' || *ptr == '+') )
 	{
-		if( obj_vertex_map_item_cmp( &state->vertex_map_buffer[i], &a ) >= 0 )
-			break;
+		negative = (*ptr == '-');
+		ptr++;
 	}
 
-	/* move the rest */
-	if( i < state->vertex_map_count )
+	/* eight bytes at a time while the span allows it */
+	if( end - ptr >= 8 )
 	{
-		memmove(
-			&state->vertex_map_buffer[i+1],
-			&state->vertex_map_buffer[i],
-			sizeof(obj_vertex_map_item) * (state->vertex_map_count-i) );
+		tl_uint64 digits;
+		unsigned int count = obj_digit_count_8( ptr, &digits );
+
+		if( count == 0 )
+			return start;
+
+		if( count < 8 )
+			digits <<= (8 - count) * 8;
+
+		result = obj_digits_value_8( digits );
+		ptr += count;
+
+		if( count < 8 )
+		{
+			*value = negative ? -(int)result : (int)result;
+			return ptr;
+		}
 	}
+	else if( ptr >= end || (unsigned char)(*ptr - '0') > 9 )
+		return start;
+
+	/* saturates at INT_MAX like strtol, so no index wraps into range */
+	while( ptr < end && (unsigned char)(*ptr - '0') <= 9 )
+	{
+		unsigned int digit = (unsigned int)(*ptr - '0');
 
-	/* insert new vertex */
-	state->vertex_map_buffer[i].v = v;
-	state->vertex_map_buffer[i].vt = vt;
-	state->vertex_map_buffer[i].vn = vn;
-	state->vertex_map_buffer[i].index = state->vertex_map_count;
+		if( result > (INT_MAX - digit) / 10 )
+			result = INT_MAX;
+		else
+			result = result * 10 + digit;
 
-	state->vertex_map_count++;
+		ptr++;
+	}
 
-	return state->vertex_map_count - 1;
+	*value = negative ? -(int)result : (int)result;
+	return ptr;
 }
 
+
 /*----------------------------------------------------------------------------*/
-static void obj_state_map_vertex_increase( tlObjState *state )
+/* one face corner: v, v/vt, v//vn or v/vt/vn, relative indices are kept */
+static const char *obj_parse_corner(
+	const char *ptr,
+	const char *end,
+	int *v,
+	int *vt,
+	int *vn )
 {
-	/* check if there is enough room for another element */
-	unsigned int needed_size = (state->vertex_map_count + 1) * sizeof(obj_vertex_map_item);
+	*vt = 0;
+	*vn = 0;
 
-	if( needed_size > state->vertex_map_buffer_size )
-	{
-		unsigned int new_size = 128;
-		obj_vertex_map_item *new_buffer;
+	ptr = obj_scan_index( ptr, end, v );
 
-		while( new_size < needed_size )
-			new_size = new_size * 2;
+	if( ptr < end && *ptr == '/' )
+	{
+		ptr++;
 
-		new_buffer = realloc( state->vertex_map_buffer, new_size );
+		/* v//vn skips the texcoord without a scan */
+		if( ptr < end && *ptr == '/' )
+			ptr = obj_scan_index( ptr + 1, end, vn );
+		else
+		{
+			ptr = obj_scan_index( ptr, end, vt );
 
-		state->vertex_map_buffer = new_buffer;
-		state->vertex_map_buffer_size = new_size;
+			if( ptr < end && *ptr == '/' )
+				ptr = obj_scan_index( ptr + 1, end, vn );
+		}
 	}
+
+	return ptr;
 }
 
+
 /*----------------------------------------------------------------------------*/
-static unsigned int obj_state_map_vertex(
+/* parses one v, vt or vn line of components numbers into a state buffer */
+static int obj_state_add_reals(
 	tlObjState *state,
+	void **buffer,
+	size_t *buffer_size,
+	size_t *count,
+	unsigned int components,
+	const char *ptr,
+	const char *end )
+{
+	size_t element_size = components * state->real_size;
+
+	if( obj_state_grow_buffer( state, buffer, buffer_size, *count + 1, element_size ) )
+		return 1;
+
+	obj_parse_reals( ptr, end, (char *)*buffer + *count * element_size,
+		components, state->real_size );
+	(*count)++;
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+static unsigned int obj_vertex_hash(
 	unsigned int v,
 	unsigned int vt,
 	unsigned int vn )
 {
-	unsigned int index;
-
-	if( obj_state_map_vertex_find( state, v, vt, vn, &index ) )
-		return index;
+	unsigned int h = v * 0x9E3779B1u ^ vt * 0x85EBCA77u ^ vn * 0xC2B2AE3Du;
 
-	obj_state_map_vertex_increase( state );
+	/* fold the high bits down, the table is indexed with the low ones */
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
 
-	return obj_state_map_vertex_insert( state, v, vt, vn );
+	return h;
 }
 
 /*----------------------------------------------------------------------------*/
-void obj_quicksort_vertex_map( obj_vertex_map_item *map, int left, int right )
+/* slot holding the index of the triple, or the empty slot where it belongs */
+static unsigned int *obj_vertex_hash_slot(
+	const tlObjState *state,
+	unsigned int *table,
+	size_t mask,
+	int v,
+	unsigned int vt,
+	unsigned int vn )
 {
-	if( right > left )
+	size_t i = obj_vertex_hash( (unsigned int)v, vt, vn ) & mask;
+
+	/* linear probing, the load factor stays below one half */
+	for( ;; )
 	{
-		int i = left;
-		int j = right;
-		unsigned int pivot = (right+left)/2;
-		obj_vertex_map_item tmp;
+		unsigned int *slot = &table[i];
+		const obj_vertex_map_item *item;
 
-		while( i <= j)
-        {
-            while( map[i].index < pivot ) i++;
-            while( map[j].index > pivot ) j--;
-            if( i <= j )
-            {
-            	tmp = map[i];
-				map[i] = map[j];
-				map[j] = tmp;
-                i++; j--;
-            }
-        }
+		if( *slot == OBJ_VERTEX_HASH_EMPTY )
+			return slot;
 
-        if( left < j )
-        	obj_quicksort_vertex_map( map, left, j );
+		item = &state->vertex_map_buffer[*slot];
+		if( item->v == v && item->vt == vt && item->vn == vn )
+			return slot;
 
-        if( i < right )
-        	obj_quicksort_vertex_map( map, i, right );
+		i = (i + 1) & mask;
 	}
 }
 
-
 /*----------------------------------------------------------------------------*/
-static int obj_state_add_mtllib( tlObjState *state, char *name )
+/* capacity has to be a power of two */
+static int obj_vertex_hash_resize( tlObjState *state, size_t capacity )
 {
-	char **new_buffer;
+	unsigned int *table;
+	size_t i;
 
-	new_buffer = realloc( state->mtllib_buffer, state->mtllib_count + 1 );
+	if( capacity > (size_t)-1 / sizeof(unsigned int) )
+		return 1;
 
-	if( new_buffer == NULL )
+	table = malloc( capacity * sizeof(unsigned int) );
+	if( table == NULL )
 		return 1;
 
-	state->mtllib_buffer = new_buffer;
-	state->mtllib_buffer[state->mtllib_count] = obj_copy_string( name );
-	state->mtllib_count++;
+	memset( table, 0xFF, capacity * sizeof(unsigned int) );
+
+	/* rehash from the records, all keys are distinct */
+	for( i = 0; i < state->vertex_map_count; i++ )
+	{
+		const obj_vertex_map_item *item = &state->vertex_map_buffer[i];
+		*obj_vertex_hash_slot( state, table, capacity - 1, item->v, item->vt, item->vn )
+			= (unsigned int)i;
+	}
+
+	if( state->vertex_hash_buffer )
+		free( state->vertex_hash_buffer );
+
+	state->vertex_hash_buffer = table;
+	state->vertex_hash_mask = capacity - 1;
 
 	return 0;
 }
 
-
 /*----------------------------------------------------------------------------*/
-static int obj_state_add_face(
+static int obj_state_map_vertex_increase( tlObjState *state )
+{
+	void *buffer = state->vertex_map_buffer;
+
+	/* vertex indices are 32 bit, the largest one marks empty hash slots */
+	if( state->vertex_map_count + 1 >= OBJ_VERTEX_HASH_EMPTY )
+		return 1;
+
+	/* check if there is enough room for another element */
+	if( obj_state_grow_buffer( state, &buffer, &state->vertex_map_buffer_size,
+		state->vertex_map_count + 1, sizeof(obj_vertex_map_item) ) )
+		return 1;
+
+	state->vertex_map_buffer = buffer;
+
+	/* keep the hash less than half full */
+	if( (state->vertex_map_count + 1) * 2 > state->vertex_hash_mask + 1 )
+		return obj_vertex_hash_resize( state,
+			state->vertex_hash_mask ? (state->vertex_hash_mask + 1) * 2 : 256 );
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* vertices are appended in order of their first appearance */
+static unsigned int obj_state_map_vertex(
+	tlObjState *state,
+	unsigned int v,
+	unsigned int vt,
+	unsigned int vn )
+{
+	unsigned int *slot;
+	obj_vertex_map_item *item;
+
+	if( obj_state_map_vertex_increase( state ) )
+		return 0;
+
+	slot = obj_vertex_hash_slot( state,
+		state->vertex_hash_buffer, state->vertex_hash_mask, (int)v, vt, vn );
+
+	if( *slot != OBJ_VERTEX_HASH_EMPTY )
+		return *slot;
+
+	item = &state->vertex_map_buffer[state->vertex_map_count];
+	item->v = (int)v;
+	item->vt = vt;
+	item->vn = vn;
+
+	*slot = (unsigned int)state->vertex_map_count++;
+
+	return *slot;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int obj_state_add_mtllib(
+	tlObjState *state,
+	const char *name,
+	const char *name_end )
+{
+	void *buffer = state->mtllib_buffer;
+
+	if( obj_grow_buffer( &buffer, &state->mtllib_buffer_size,
+		state->mtllib_count + 1, sizeof(char *) ) )
+		return 1;
+
+	state->mtllib_buffer = buffer;
+	state->mtllib_buffer[state->mtllib_count]
+		= tl_arena_copy_span( &state->arena, name, name_end );
+	state->mtllib_count++;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int obj_state_add_face(
 	tlObjState *state,
 	unsigned int a,
 	unsigned int b,
 	unsigned int c )
 {
-	unsigned int needed_size
-		= (state->face_count + 1) * 3 * sizeof(unsigned int);
+	void *buffer = state->face_buffer;
 
-	if( needed_size > state->face_buffer_size )
-	{
-		unsigned int new_size = 128;
-		unsigned int *new_buffer;
-
-		while( new_size < needed_size )
-			new_size = new_size * 2;
-
-		new_buffer = realloc( state->face_buffer, new_size );
-		if( new_buffer == NULL )
-			return 1;
+	if( obj_state_grow_buffer( state, &buffer, &state->face_buffer_size,
+		state->face_count + 1, 3 * sizeof(unsigned int) ) )
+		return 1;
 
-		state->face_buffer = new_buffer;
-		state->face_buffer_size = new_size;
-	}
+	state->face_buffer = buffer;
 
 	state->face_buffer[state->face_count*3] = a;
 	state->face_buffer[state->face_count*3+1] = b;
@@ -655,40 +1182,56 @@ static int obj_state_add_face(
 }
 
 
+/*----------------------------------------------------------------------------*/
+/* corner number count (starting at 1) of a polygon, faces are made as a fan */
+static void obj_state_add_corner(
+	tlObjState *state,
+	unsigned int count,
+	unsigned int *buffer,
+	unsigned int v,
+	unsigned int vt,
+	unsigned int vn )
+{
+	if( count < 4 )
+	{
+		buffer[count-1] = obj_state_map_vertex( state, v, vt, vn );
+	}
+	else
+	{
+		buffer[1] = buffer[2];
+		buffer[2] = obj_state_map_vertex( state, v, vt, vn );
+	}
+
+	if( count > 2 )
+	{
+		obj_state_add_face( state, buffer[0], buffer[1], buffer[2] );
+	}
+}
+
+
 /*----------------------------------------------------------------------------*/
 static int obj_state_add_object(
 	tlObjState *state,
 	const char *name,
-	unsigned int name_size )
+	size_t name_length )
 {
-	unsigned int needed_size
-		= (state->object_count + 1) * sizeof(tlObjObject *);
 	tlObjObject *obj = 0;
+	void *buffer;
 
 	if( state == NULL )
 		return 1;
 
-	if( needed_size > state->object_buffer_size )
-	{
-		unsigned int new_size = 128;
-		tlObjObject **new_buffer;
-
-		while( new_size < needed_size )
-			new_size = new_size * 2;
-
-		new_buffer = realloc( state->object_buffer, new_size );
-		if( new_buffer == NULL )
-			return 1;
+	buffer = state->object_buffer;
+	if( obj_state_grow_buffer( state, &buffer, &state->object_buffer_size,
+		state->object_count + 1, sizeof(tlObjObject) ) )
+		return 1;
 
-		state->object_buffer = new_buffer;
-		state->object_buffer_size = new_size;
-	}
+	state->object_buffer = buffer;
 
-	obj = malloc( sizeof(tlObjObject) );
+	obj = &state->object_buffer[ state->object_count ];
 	obj->index = state->face_count;
-	obj->name = malloc( name_size );
-	memcpy( obj->name, name, name_size );
-	state->object_buffer[ state->object_count ] = obj;
+	obj->count = 0;
+	obj->name = tl_arena_copy_span( &state->arena, name, name + name_length );
 	state->object_count++;
 
 	return 0;
@@ -696,145 +1239,308 @@ static int obj_state_add_object(
 
 
 /*----------------------------------------------------------------------------*/
-static void obj_process_command( tlObjState *state )
+/* absolute index starting at 1 of a parsed one, 0 if there is none */
+static size_t obj_resolve_index( int index, size_t count )
 {
-	if( state == NULL )
-		return;
+	size_t back;
+
+	if( index >= 0 )
+		return (size_t)index;
+
+	/* relative to the elements read so far */
+	back = 0 - (size_t)index;
+
+	return back <= count ? count + 1 - back : 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static const char *obj_callback_name(
+	tlObjState *state,
+	const char *name,
+	const char *name_end )
+{
+	void *buffer = state->name_buffer;
+	size_t length = name_end - name;
+
+	if( obj_grow_buffer( &buffer, &state->name_buffer_size, length + 1, 1 ) )
+		return NULL;
+
+	state->name_buffer = buffer;
+	memcpy( state->name_buffer, name, length );
+	state->name_buffer[length] = 0;
+
+	return state->name_buffer;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_callback_face(
+	tlObjState *state,
+	const char *ptr,
+	const char *end )
+{
+	size_t count = 0;
 
-	if( strcmp( state->command_buffer, "o" ) == 0 )
+	while( ptr < end )
 	{
-		/* safe face count */
-		if( state->object_count > 0 )
-		{
-			tlObjObject *obj = state->object_buffer[ state->object_count - 1 ];
-			obj->count = state->face_count - obj->index;
-		}
+		void *buffer = state->corner_buffer;
+		int v, vt, vn;
+		const char *start = ptr;
 
-		obj_state_add_object(
-			state,
-			state->parameter_buffer,
-			state->parameter_buffer_length );
+		ptr = obj_parse_corner( ptr, end, &v, &vt, &vn );
+
+		/* garbage, stop here */
+		if( ptr == start )
+			break;
+
+		ptr = obj_skip_whitespace( ptr, end );
+
+		if( obj_grow_buffer( &buffer, &state->corner_buffer_size,
+			count + 1, sizeof(tlObjCorner) ) )
+			return;
+
+		state->corner_buffer = buffer;
+		state->corner_buffer[count].v = obj_resolve_index( v, state->point_count );
+		state->corner_buffer[count].vt = obj_resolve_index( vt, state->texcoord_count );
+		state->corner_buffer[count].vn = obj_resolve_index( vn, state->normal_count );
+		count++;
 	}
-	else if( strcmp( state->command_buffer, "v" ) == 0 )
+
+	if( count > 0 )
+		state->callbacks.on_face( state->callbacks.user_data, state->corner_buffer, count );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* streaming counterpart of obj_process_command */
+static void obj_callback_command(
+	tlObjState *state,
+	tlObjKeyword keyword,
+	const char *parameter,
+	const char *parameter_end )
+{
+	const tlObjCallbacks *callbacks = &state->callbacks;
+	void (*on_name)( void *, const char * ) = NULL;
+	double values[3];
+	float props[3];
+	int property = 0;
+
+	switch( keyword )
 	{
-		double x, y, z;
-		char *ptr = state->parameter_buffer;
-		x = strtod( ptr, &ptr );
-		y = strtod( ptr, &ptr );
-		z = strtod( ptr, &ptr );
+	case OBJ_KEYWORD_VERTEX:
+	case OBJ_KEYWORD_NORMAL:
+		values[0] = values[1] = values[2] = 0;
+		obj_parse_reals( parameter, parameter_end, values, 3, sizeof(double) );
+
+		if( keyword == OBJ_KEYWORD_VERTEX )
+		{
+			state->point_count++;
+			if( callbacks->on_vertex )
+				callbacks->on_vertex( callbacks->user_data, values[0], values[1], values[2] );
+		}
+		else
+		{
+			state->normal_count++;
+			if( callbacks->on_normal )
+				callbacks->on_normal( callbacks->user_data, values[0], values[1], values[2] );
+		}
+		return;
+
+	case OBJ_KEYWORD_TEXCOORD:
+		values[0] = values[1] = 0;
+		obj_parse_reals( parameter, parameter_end, values, 2, sizeof(double) );
+
+		state->texcoord_count++;
+		if( callbacks->on_texcoord )
+			callbacks->on_texcoord( callbacks->user_data, values[0], values[1] );
+		return;
+
+	case OBJ_KEYWORD_FACE:
+		if( callbacks->on_face )
+			obj_callback_face( state, parameter, parameter_end );
+		return;
 
-		obj_state_add_point( state, x, y, z );
+	case OBJ_KEYWORD_OBJECT:
+		on_name = callbacks->on_object;
+		break;
+
+	case OBJ_KEYWORD_USEMTL:
+		on_name = callbacks->on_usemtl;
+		break;
+
+	case OBJ_KEYWORD_MTLLIB:
+		on_name = callbacks->on_mtllib;
+		break;
+
+	case OBJ_KEYWORD_NEWMTL:
+		on_name = callbacks->on_material;
+		break;
+
+	case OBJ_KEYWORD_AMBIENT:
+		property = TL_OBJ_MATERIAL_AMBIENT;
+		break;
+
+	case OBJ_KEYWORD_DIFFUSE:
+		property = TL_OBJ_MATERIAL_DIFFUSE;
+		break;
+
+	case OBJ_KEYWORD_SPECULAR:
+		property = TL_OBJ_MATERIAL_SPECULAR;
+		break;
+
+	case OBJ_KEYWORD_SHININESS:
+		property = TL_OBJ_MATERIAL_SHININESS;
+		break;
+
+	case OBJ_KEYWORD_TRANSPARENCY:
+		property = TL_OBJ_MATERIAL_TRANSPARENCY;
+		break;
+
+	default:
+		return;
 	}
-	else if( strcmp( state->command_buffer, "vn" ) == 0 )
-	{
-		double x, y, z;
-		char *ptr = state->parameter_buffer;
-		x = strtod( ptr, &ptr );
-		y = strtod( ptr, &ptr );
-		z = strtod( ptr, &ptr );
 
-		obj_state_add_normal( state, x, y, z );
+	if( on_name )
+	{
+		const char *name = obj_callback_name( state, parameter, parameter_end );
+		if( name )
+			on_name( callbacks->user_data, name );
 	}
-	else if( strcmp( state->command_buffer, "vt" ) == 0 )
+	else if( property && callbacks->on_material_property )
 	{
-		double u, v;
-		char *ptr = state->parameter_buffer;
-		u = strtod( ptr, &ptr );
-		v = strtod( ptr, &ptr );
+		const char *ptr = parameter;
+		int i, count = property <= TL_OBJ_MATERIAL_SPECULAR ? 3 : 1;
 
-		obj_state_add_texcoord( state, u, v );
+		for( i = 0; i < count; i++ )
+			props[i] = (float)obj_parse_real( &ptr, parameter_end );
+
+		callbacks->on_material_property( callbacks->user_data, property, props );
 	}
-	else if( strcmp( state->command_buffer, "f" ) == 0 )
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_process_command(
+	tlObjState *state,
+	const char *command,
+	size_t command_length,
+	const char *parameter,
+	const char *parameter_end )
+{
+	tlObjKeyword keyword;
+
+	if( state == NULL )
+		return;
+
+	keyword = obj_classify_keyword( command, command_length );
+
+	if( state->use_callbacks )
 	{
-		unsigned int count = 0;
-		int buffer[3];
-		char *ptr = state->parameter_buffer;
+		obj_callback_command( state, keyword, parameter, parameter_end );
+		return;
+	}
 
-		while( *ptr != 0 )
+	switch( keyword )
+	{
+	case OBJ_KEYWORD_OBJECT:
+		/* safe face count */
+		if( state->object_count > 0 )
 		{
-			int v = 0, vn = 0, vt = 0;
+			tlObjObject *obj = &state->object_buffer[ state->object_count - 1 ];
+			obj->count = state->face_count - obj->index;
+		}
 
-			/* parse vertex index */
-			v = strtol( ptr, &ptr, 10 );
+		obj_state_add_object(
+			state,
+			parameter,
+			(size_t)(parameter_end - parameter) );
+		break;
+
+	case OBJ_KEYWORD_VERTEX:
+		obj_state_add_reals( state, &state->point_buffer, &state->point_buffer_size,
+			&state->point_count, 3, parameter, parameter_end );
+		break;
+
+	case OBJ_KEYWORD_NORMAL:
+		obj_state_add_reals( state, &state->normal_buffer, &state->normal_buffer_size,
+			&state->normal_count, 3, parameter, parameter_end );
+		break;
+
+	case OBJ_KEYWORD_TEXCOORD:
+		obj_state_add_reals( state, &state->texcoord_buffer, &state->texcoord_buffer_size,
+			&state->texcoord_count, 2, parameter, parameter_end );
+		break;
+
+	case OBJ_KEYWORD_FACE:
+		{
+			unsigned int count = 0;
+			unsigned int buffer[3];
+			const char *ptr = parameter;
 
-			/* parse texcoord index */
-			if( *ptr == '/' )
+			while( ptr < parameter_end )
 			{
-				ptr++;
-				vt = strtol( ptr, &ptr, 10 );
-			}
+				int v, vt, vn;
+				const char *start = ptr;
 
-			/* parse normal index */
-			if( *ptr == '/' )
-			{
-				ptr++;
-				vn = strtol( ptr, &ptr, 10 );
-			}
+				ptr = obj_parse_corner( ptr, parameter_end, &v, &vt, &vn );
 
-			/* skip spaces */
-			while( *ptr == ' ' )
-				ptr++;
+				/* garbage, stop here */
+				if( ptr == start )
+					break;
 
-			count++;
+				/* skip spaces */
+				ptr = obj_skip_whitespace( ptr, parameter_end );
 
-			if( v < 0 )
-				v += state->point_count + 1;
+				if( v < 0 )
+					v += state->point_count + 1;
 
-			if( vt < 0 )
-				vt += state->texcoord_count + 1;
+				if( vt < 0 )
+					vt += state->texcoord_count + 1;
 
-			if( vn < 0 )
-				vn += state->normal_count + 1;
+				if( vn < 0 )
+					vn += state->normal_count + 1;
 
-			/* make tris from fan */
-			if( count < 4 )
-			{
-				buffer[count-1] = obj_state_map_vertex( state, v, vt, vn );
-			}
-			else
-			{
-				buffer[1] = buffer[2];
-				buffer[2] = obj_state_map_vertex( state, v, vt, vn );
+				count++;
+				obj_state_add_corner( state, count, buffer, v, vt, vn );
 			}
+		}
+		break;
 
-			if( count > 2 )
-			{
-				obj_state_add_face( state, buffer[0], buffer[1], buffer[2] );
-			}
+	case OBJ_KEYWORD_MTLLIB:
+		obj_state_add_mtllib( state, parameter, parameter_end );
+		break;
 
+	case OBJ_KEYWORD_NEWMTL:
+		obj_state_add_material( state, parameter, parameter_end );
+		break;
+
+	case OBJ_KEYWORD_AMBIENT:
+	case OBJ_KEYWORD_DIFFUSE:
+	case OBJ_KEYWORD_SPECULAR:
+		{
+			float color[3];
+			const char *ptr = parameter;
+			color[0] = (float)obj_parse_real( &ptr, parameter_end );
+			color[1] = (float)obj_parse_real( &ptr, parameter_end );
+			color[2] = (float)obj_parse_real( &ptr, parameter_end );
+
+			obj_material_set_property( state, keyword, color );
 		}
-	}
-	else if( strcmp( state->command_buffer, "mtllib" ) == 0 )
-	{
-		obj_state_add_mtllib( state, state->parameter_buffer );
-	}
-	else if( strcmp( state->command_buffer, "newmtl" ) == 0 )
-	{
-		obj_state_add_material( state, state->parameter_buffer );
-	}
-	else if( (strcmp( state->command_buffer, "Ka" ) == 0) ||
-		(strcmp( state->command_buffer, "Kd" ) == 0) ||
-		(strcmp( state->command_buffer, "Ks" ) == 0) )
-	{
-		float color[3];
-		char *ptr = state->parameter_buffer;
-		color[0] = (float)strtod( ptr, &ptr );
-		color[1] = (float)strtod( ptr, &ptr );
-		color[2] = (float)strtod( ptr, &ptr );
+		break;
 
-		obj_material_set_property(state, color);
-	}
-	else if( (strcmp( state->command_buffer, "Ns" ) == 0) ||
-		(strcmp( state->command_buffer, "Tr" ) == 0) )
-	{
-		float param;
-		char *ptr = state->parameter_buffer;
+	case OBJ_KEYWORD_SHININESS:
+	case OBJ_KEYWORD_TRANSPARENCY:
+		{
+			float param;
+			const char *ptr = parameter;
 
-		param = (float)strtod( ptr, &ptr );
-		obj_material_set_property(state, &param);
-	}
-	else if( strcmp( state->command_buffer, "usemtl" ) == 0 )
-	{
+			param = (float)obj_parse_real( &ptr, parameter_end );
+			obj_material_set_property( state, keyword, &param );
+		}
+		break;
+
+	case OBJ_KEYWORD_USEMTL:
 		if( state->material_reference_count )
 		{
 			obj_material_reference_set_range(
@@ -842,306 +1548,1145 @@ static void obj_process_command( tlObjState *state )
 				state->last_material_face,
 				state->face_count - state->last_material_face );
 		}
-		obj_add_material_reference( state, state->parameter_buffer );
+		obj_add_material_reference( state, parameter, parameter_end );
 		state->last_material_face = state->face_count;
-	}
+		break;
+
+	default:
 #ifdef  DEBUG
-	else
+		fprintf(stderr, "Unknown command %.*s, params: %.*s\n",
+			(int)command_length, command,
+			(int)(parameter_end - parameter), parameter );
+#endif
+		break;
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the line has to be free of comments */
+static void obj_process_line( tlObjState *state, const char *ptr, const char *end )
+{
+	const char *command;
+
+	/* trim */
+	ptr = obj_skip_whitespace( ptr, end );
+	while( end > ptr && obj_is_whitespace( end[-1] ) )
+		end--;
+
+	if( ptr == end )
+		return;
+
+	/* split command and parameter */
+	command = ptr;
+	ptr = obj_find_whitespace( ptr, end );
+
+	obj_process_command(
+		state,
+		command,
+		(size_t)(ptr - command),
+		obj_skip_whitespace( ptr, end ),
+		end );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int obj_line_buffer_add(
+	tlObjState *state,
+	const char *bytes,
+	size_t size )
+{
+	void *buffer = state->line_buffer;
+
+	/* always keep room for the terminating zero */
+	if( size > (size_t)-1 - state->line_buffer_length - 1
+		|| obj_grow_buffer( &buffer, &state->line_buffer_size,
+			state->line_buffer_length + size + 1, 1 ) )
+		return 1;
+
+	state->line_buffer = buffer;
+
+	memcpy( state->line_buffer + state->line_buffer_length, bytes, size );
+	state->line_buffer_length += size;
+	state->line_buffer[ state->line_buffer_length ] = 0;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_process_line_buffer( tlObjState *state )
+{
+	const char *end = state->line_buffer + state->line_buffer_length;
+	const char *comment = memchr( state->line_buffer, '#', state->line_buffer_length );
+
+	obj_process_line(
+		state,
+		state->line_buffer,
+		comment != NULL ? comment : end );
+
+	state->line_buffer_length = 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlObjState *tlObjCreateState()
+{
+	return tlObjCreateStateEx( 0 );
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlObjState *tlObjCreateStateEx( unsigned int flags )
+{
+	tlObjState *state = malloc( sizeof(tlObjState) );
+
+	if( state )
 	{
-		fprintf(stderr, "Unknown command %s, params: %s\n", state->command_buffer, state->parameter_buffer);
+		memset( state, 0, sizeof(tlObjState) );
+
+		state->real_size = (flags & TL_OBJ_SINGLE_PRECISION) ? sizeof(float) : sizeof(double);
+		obj_material_add_defaults(state);
+		state->parsing_state = OBJ_STATE_PARSE_LINES;
 	}
-#endif
+
+	return state;
 }
 
 
 /*----------------------------------------------------------------------------*/
-static int obj_command_buffer_add( tlObjState *state, char c )
+int tlObjResetState( tlObjState *state )
 {
-	unsigned int needed_size = state->command_buffer_length + 1;
+	size_t real_size, i;
+	int use_callbacks;
+	tlObjCallbacks callbacks;
+
+	/* all names at once */
+	tl_arena_release( &state->arena );
+
+	if( state->mtllib_buffer )
+		free( state->mtllib_buffer );
+
+	if( state->material_buffer )
+		free( state->material_buffer );
+
+	for( i = 0; i < state->adopted_count; i++ )
+		tlMtlDestroyState( state->adopted_buffer[i] );
+
+	if( state->adopted_buffer )
+		free( state->adopted_buffer );
+
+	if( state->material_reference_buffer )
+		free( state->material_reference_buffer );
+
+	if( state->object_buffer )
+		free( state->object_buffer );
+
+	if( state->point_buffer )
+		free( state->point_buffer );
+
+	if( state->face_buffer )
+		free( state->face_buffer );
+
+	if( state->vertex_map_buffer )
+		free( state->vertex_map_buffer );
+
+	if( state->vertex_hash_buffer )
+		free( state->vertex_hash_buffer );
+
+	if( state->normal_buffer )
+		free( state->normal_buffer );
+
+	if( state->texcoord_buffer )
+		free( state->texcoord_buffer );
+
+	if( state->line_buffer )
+		free( state->line_buffer );
+
+	if( state->name_buffer )
+		free( state->name_buffer );
+
+	if( state->corner_buffer )
+		free( state->corner_buffer );
+
+	obj_state_free_retired( state );
+
+	/* the storage mode and the callbacks outlive a reset */
+	real_size = state->real_size;
+	use_callbacks = state->use_callbacks;
+	callbacks = state->callbacks;
+	memset( state, 0, sizeof(tlObjState) );
+
+	state->real_size = real_size;
+	state->use_callbacks = use_callbacks;
+	state->callbacks = callbacks;
+	state->parsing_state = OBJ_STATE_PARSE_LINES;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tlObjDestroyState( tlObjState *state )
+{
+	if( state )
+	{
+		tlObjResetState( state );
+		free( state );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlObjParse(
+	tlObjState *state,
+	const char *bytes,
+	size_t size,
+	int last )
+{
+	const char *ptr = bytes, *end = bytes + size;
+
+	if( state == NULL )
+		return 1;
+
+	while( ptr < end )
+	{
+		const char *line_end = obj_find_either( ptr, end, '\n', '#' );
+		const char *comment = NULL;
+
+		/* skip the comment in one go, libc memchr is vectorised as well */
+		if( line_end != NULL && *line_end == '#' )
+		{
+			comment = line_end;
+			line_end = memchr( comment, '\n', end - comment );
+		}
+
+		/* incomplete line, keep it for the next call */
+		if( line_end == NULL )
+		{
+			if( obj_line_buffer_add( state, ptr, (size_t)(end - ptr) ) )
+				return 1;
+			break;
+		}
+
+		/* complete a line started in a previous call */
+		if( state->line_buffer_length > 0 )
+		{
+			if( obj_line_buffer_add( state, ptr, (size_t)(line_end - ptr) ) )
+				return 1;
+			obj_process_line_buffer( state );
+		}
+		else
+			obj_process_line( state, ptr, comment != NULL ? comment : line_end );
+
+		ptr = line_end + 1;
+	}
+
+	if( last != 0 )
+	{
+		tlObjObject *object = NULL;
+
+		/* last line without line break */
+		if( state->line_buffer_length > 0 )
+			obj_process_line_buffer( state );
+
+		/* nothing was stored that needs closing */
+		if( state->use_callbacks )
+		{
+			state->parsing_state = OBJ_STATE_DONE;
+			return 0;
+		}
+
+		/* make sure we have at least one object */
+		if( state->object_count == 0 )
+		{
+			obj_state_add_object( state, "n/a", 3 );
+			state->object_buffer[ state->object_count - 1 ].index = 0;
+		}
+
+		object = &state->object_buffer[ state->object_count - 1 ];
+		object->count = state->face_count - object->index;
+
+		/* Close last material */
+		if( state->material_reference_count )
+		{
+			obj_material_reference_set_range(
+				state, state->last_material_face,
+				state->face_count - state->last_material_face );
+		}
+		state->parsing_state = OBJ_STATE_DONE;
+	}
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* a face corner parsed by a worker, flags mark indices relative to the chunk */
+typedef struct obj_chunk_corner
+{
+	int v, vt, vn;
+	unsigned int flags;
+} obj_chunk_corner;
+
+#define OBJ_CORNER_RELATIVE_V   1
+#define OBJ_CORNER_RELATIVE_VT  2
+#define OBJ_CORNER_RELATIVE_VN  4
+
+/*----------------------------------------------------------------------------*/
+/* any other line, replayed in order after face line face_line of the chunk */
+typedef struct obj_chunk_line
+{
+	const char *begin, *end;
+	size_t face_line;
+} obj_chunk_line;
+
+/*----------------------------------------------------------------------------*/
+/* everything a worker collects from one newline aligned piece of the input */
+typedef struct obj_chunk
+{
+	const char *begin, *end;
+	int failed;
+
+	/* coordinates in the precision of the state */
+	size_t real_size;
+
+	void *points;
+	size_t point_count, point_capacity;
+
+	void *texcoords;
+	size_t texcoord_count, texcoord_capacity;
+
+	void *normals;
+	size_t normal_count, normal_capacity;
+
+	obj_chunk_corner *corners;
+	size_t corner_count, corner_capacity;
+
+	/* corner count of every face line */
+	unsigned int *faces;
+	size_t face_count, face_capacity;
+
+	obj_chunk_line *lines;
+	size_t line_count, line_capacity;
+} obj_chunk;
+
+
+/*----------------------------------------------------------------------------*/
+/* room for one more element, capacity counts elements */
+static int obj_chunk_reserve(
+	void **buffer,
+	size_t *capacity,
+	size_t count,
+	size_t element_size )
+{
+	if( count >= *capacity )
+	{
+		size_t new_capacity = *capacity ? *capacity * 2 : 1024;
+		void *new_buffer;
+
+		if( new_capacity < *capacity || new_capacity > (size_t)-1 / element_size )
+			return 1;
+
+		new_buffer = realloc( *buffer, new_capacity * element_size );
+		if( new_buffer == NULL )
+			return 1;
+
+		*buffer = new_buffer;
+		*capacity = new_capacity;
+	}
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_chunk_add_reals(
+	obj_chunk *chunk,
+	void **buffer,
+	size_t *count,
+	size_t *capacity,
+	unsigned int components,
+	const char *ptr,
+	const char *end )
+{
+	size_t element_size = components * chunk->real_size;
+
+	if( obj_chunk_reserve( buffer, capacity, *count, element_size ) )
+	{
+		chunk->failed = 1;
+		return;
+	}
+
+	obj_parse_reals( ptr, end, (char *)*buffer + *count * element_size,
+		components, chunk->real_size );
+	(*count)++;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_chunk_add_face( obj_chunk *chunk, const char *ptr, const char *end )
+{
+	unsigned int count = 0;
+
+	while( ptr < end )
+	{
+		obj_chunk_corner *corner;
+		int v, vt, vn;
+		const char *start = ptr;
+
+		ptr = obj_parse_corner( ptr, end, &v, &vt, &vn );
+
+		/* garbage, stop here */
+		if( ptr == start )
+			break;
+
+		ptr = obj_skip_whitespace( ptr, end );
+
+		if( obj_chunk_reserve( (void **)&chunk->corners, &chunk->corner_capacity,
+			chunk->corner_count, sizeof(obj_chunk_corner) ) )
+		{
+			chunk->failed = 1;
+			return;
+		}
+
+		/* relative to what this chunk has seen so far, the merge adds the rest */
+		corner = &chunk->corners[chunk->corner_count++];
+		corner->flags = 0;
+
+		if( v < 0 )
+		{
+			v += chunk->point_count + 1;
+			corner->flags |= OBJ_CORNER_RELATIVE_V;
+		}
+
+		if( vt < 0 )
+		{
+			vt += chunk->texcoord_count + 1;
+			corner->flags |= OBJ_CORNER_RELATIVE_VT;
+		}
+
+		if( vn < 0 )
+		{
+			vn += chunk->normal_count + 1;
+			corner->flags |= OBJ_CORNER_RELATIVE_VN;
+		}
+
+		corner->v = v;
+		corner->vt = vt;
+		corner->vn = vn;
+		count++;
+	}
+
+	if( obj_chunk_reserve( (void **)&chunk->faces, &chunk->face_capacity,
+		chunk->face_count, sizeof(unsigned int) ) )
+	{
+		chunk->failed = 1;
+		return;
+	}
+
+	chunk->faces[chunk->face_count++] = count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* same splitting as obj_process_line, the line has to be free of comments */
+static void obj_chunk_process_line( obj_chunk *chunk, const char *ptr, const char *end )
+{
+	const char *command, *parameter;
+	obj_chunk_line *line;
+
+	ptr = obj_skip_whitespace( ptr, end );
+	while( end > ptr && obj_is_whitespace( end[-1] ) )
+		end--;
+
+	if( ptr == end )
+		return;
+
+	command = ptr;
+	parameter = obj_find_whitespace( ptr, end );
+
+	switch( obj_classify_keyword( command, (size_t)(parameter - command) ) )
+	{
+	case OBJ_KEYWORD_VERTEX:
+		obj_chunk_add_reals( chunk, &chunk->points, &chunk->point_count,
+			&chunk->point_capacity, 3, parameter, end );
+		return;
+
+	case OBJ_KEYWORD_NORMAL:
+		obj_chunk_add_reals( chunk, &chunk->normals, &chunk->normal_count,
+			&chunk->normal_capacity, 3, parameter, end );
+		return;
+
+	case OBJ_KEYWORD_TEXCOORD:
+		obj_chunk_add_reals( chunk, &chunk->texcoords, &chunk->texcoord_count,
+			&chunk->texcoord_capacity, 2, parameter, end );
+		return;
+
+	case OBJ_KEYWORD_FACE:
+		obj_chunk_add_face( chunk, obj_skip_whitespace( parameter, end ), end );
+		return;
+
+	default:
+		break;
+	}
+
+	/* objects, materials and unknown lines touch the shared state */
+	if( obj_chunk_reserve( (void **)&chunk->lines, &chunk->line_capacity,
+		chunk->line_count, sizeof(obj_chunk_line) ) )
+	{
+		chunk->failed = 1;
+		return;
+	}
+
+	line = &chunk->lines[chunk->line_count++];
+	line->begin = command;
+	line->end = end;
+	line->face_line = chunk->face_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* thread entry, the same line and comment handling as tlObjParse */
+static void obj_chunk_parse( void *data )
+{
+	obj_chunk *chunk = (obj_chunk *)data;
+	const char *ptr = chunk->begin, *end = chunk->end;
+
+	while( ptr < end && chunk->failed == 0 )
+	{
+		const char *line_end = obj_find_either( ptr, end, '\n', '#' );
+		const char *comment = NULL;
+
+		if( line_end != NULL && *line_end == '#' )
+		{
+			comment = line_end;
+			line_end = memchr( comment, '\n', end - comment );
+		}
+
+		/* only the last chunk can end without a line break */
+		if( line_end == NULL )
+			line_end = end;
+
+		obj_chunk_process_line( chunk, ptr, comment != NULL ? comment : line_end );
+
+		ptr = line_end + 1;
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_chunk_free( obj_chunk *chunk )
+{
+	free( chunk->points );
+	free( chunk->texcoords );
+	free( chunk->normals );
+	free( chunk->corners );
+	free( chunk->faces );
+	free( chunk->lines );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* append count elements of element_size bytes to one of the state buffers */
+static int obj_state_append_reals(
+	tlObjState *state,
+	void **buffer,
+	size_t *buffer_size,
+	size_t *buffer_count,
+	const void *values,
+	size_t count,
+	size_t element_size )
+{
+	if( count == 0 )
+		return 0;
+
+	if( count > (size_t)-1 - *buffer_count
+		|| obj_state_grow_buffer( state, buffer, buffer_size, *buffer_count + count, element_size ) )
+		return 1;
+
+	memcpy( (char *)*buffer + *buffer_count * element_size, values,
+		count * element_size );
+	*buffer_count += count;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* serial part: global indices, dedup, objects and materials in file order */
+static int obj_state_merge_chunk( tlObjState *state, const obj_chunk *chunk )
+{
+	size_t point_base = state->point_count;
+	size_t texcoord_base = state->texcoord_count;
+	size_t normal_base = state->normal_count;
+	const obj_chunk_corner *corner = chunk->corners;
+	size_t face = 0, line;
+
+	if( obj_state_append_reals( state, &state->point_buffer, &state->point_buffer_size,
+			&state->point_count, chunk->points, chunk->point_count, 3 * state->real_size )
+		|| obj_state_append_reals( state, &state->texcoord_buffer, &state->texcoord_buffer_size,
+			&state->texcoord_count, chunk->texcoords, chunk->texcoord_count, 2 * state->real_size )
+		|| obj_state_append_reals( state, &state->normal_buffer, &state->normal_buffer_size,
+			&state->normal_count, chunk->normals, chunk->normal_count, 3 * state->real_size ) )
+		return 1;
+
+	for( line = 0; line <= chunk->line_count; line++ )
+	{
+		size_t face_end = line < chunk->line_count
+			? chunk->lines[line].face_line : chunk->face_count;
+
+		for( ; face < face_end; face++ )
+		{
+			unsigned int buffer[3];
+			unsigned int count;
+
+			for( count = 1; count <= chunk->faces[face]; count++, corner++ )
+			{
+				unsigned int v = corner->v, vt = corner->vt, vn = corner->vn;
+
+				if( corner->flags & OBJ_CORNER_RELATIVE_V )
+					v += point_base;
+
+				if( corner->flags & OBJ_CORNER_RELATIVE_VT )
+					vt += texcoord_base;
+
+				if( corner->flags & OBJ_CORNER_RELATIVE_VN )
+					vn += normal_base;
+
+				obj_state_add_corner( state, count, buffer, v, vt, vn );
+			}
+		}
+
+		if( line < chunk->line_count )
+			obj_process_line( state, chunk->lines[line].begin, chunk->lines[line].end );
+	}
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlObjParseParallel(
+	tlObjState *state,
+	const char *bytes,
+	size_t size,
+	unsigned int thread_count )
+{
+	obj_chunk *chunks;
+	tl_thread **threads;
+	const char *ptr = bytes, *end = bytes + size;
+	unsigned int chunk_count = 0, i;
+	int result = 0;
+
+	if( state == NULL )
+		return 1;
+
+	if( thread_count == 0 )
+		thread_count = tl_thread_cpu_count();
+
+	/* small pieces are not worth a thread */
+	if( thread_count > size / OBJ_PARALLEL_MIN_CHUNK )
+		thread_count = (unsigned int)(size / OBJ_PARALLEL_MIN_CHUNK);
+
+	/* a line carried over from tlObjParse has to be completed first,
+	 * callbacks expect the file order */
+	if( thread_count < 2 || state->line_buffer_length > 0 || state->use_callbacks )
+		return tlObjParse( state, bytes, size, 1 );
+
+	chunks = calloc( thread_count, sizeof(obj_chunk) );
+	threads = calloc( thread_count, sizeof(tl_thread *) );
+	if( chunks == NULL || threads == NULL )
+	{
+		free( chunks );
+		free( threads );
+		return tlObjParse( state, bytes, size, 1 );
+	}
+
+	/* split behind line breaks */
+	while( ptr < end && chunk_count < thread_count )
+	{
+		const char *chunk_end = end;
+
+		if( chunk_count + 1 < thread_count && (size_t)(end - ptr) > size / thread_count )
+		{
+			chunk_end = memchr( ptr + size / thread_count, '\n',
+				end - (ptr + size / thread_count) );
+			chunk_end = chunk_end ? chunk_end + 1 : end;
+		}
+
+		chunks[chunk_count].begin = ptr;
+		chunks[chunk_count].end = chunk_end;
+		chunks[chunk_count].real_size = state->real_size;
+		chunk_count++;
+
+		ptr = chunk_end;
+	}
+
+	/* the calling thread takes the first chunk itself */
+	for( i = 1; i < chunk_count; i++ )
+		threads[i] = tl_thread_start( obj_chunk_parse, &chunks[i] );
+
+	obj_chunk_parse( &chunks[0] );
+
+	for( i = 0; i < chunk_count; i++ )
+	{
+		if( i > 0 )
+		{
+			if( threads[i] == NULL )
+				chunks[i].failed = 1;
+
+			tl_thread_join( threads[i] );
+		}
+
+		if( result == 0 && chunks[i].failed == 0 )
+			result = obj_state_merge_chunk( state, &chunks[i] );
+		else
+			result = 1;
+
+		obj_chunk_free( &chunks[i] );
+	}
+
+	free( chunks );
+	free( threads );
+
+	if( result != 0 )
+		return result;
+
+	/* closes objects and materials like the last tlObjParse call does */
+	return tlObjParse( state, bytes, 0, 1 );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t obj_estimate_count( double count )
+{
+	return count < (double)(size_t)-1 ? (size_t)count : (size_t)-1;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* makes sure a state buffer holds at least count elements of element_size */
+static int obj_buffer_reserve(
+	void **buffer,
+	size_t *buffer_size,
+	size_t count,
+	size_t element_size )
+{
+	void *new_buffer;
+
+	if( count > (size_t)-1 / element_size )
+		return 1;
+
+	if( count == 0 || count * element_size <= *buffer_size )
+		return 0;
+
+	new_buffer = realloc( *buffer, count * element_size );
+	if( new_buffer == NULL )
+		return 1;
+
+	*buffer = new_buffer;
+	*buffer_size = count * element_size;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlObjReserve(
+	tlObjState *state,
+	size_t points,
+	size_t texcoords,
+	size_t normals,
+	size_t faces,
+	size_t vertices )
+{
+	int result = 0;
+
+	if( state == NULL )
+		return 1;
+
+	/* nothing to reserve when nothing is stored, snapshots pin the buffers */
+	if( state->use_callbacks || state->snapshot_list != NULL )
+		return 0;
+
+	result |= obj_buffer_reserve( &state->point_buffer,
+		&state->point_buffer_size, points, 3 * state->real_size );
+	result |= obj_buffer_reserve( &state->texcoord_buffer,
+		&state->texcoord_buffer_size, texcoords, 2 * state->real_size );
+	result |= obj_buffer_reserve( &state->normal_buffer,
+		&state->normal_buffer_size, normals, 3 * state->real_size );
+	result |= obj_buffer_reserve( (void **)&state->face_buffer,
+		&state->face_buffer_size, faces, 3 * sizeof(unsigned int) );
+	result |= obj_buffer_reserve( (void **)&state->vertex_map_buffer,
+		&state->vertex_map_buffer_size, vertices, sizeof(obj_vertex_map_item) );
+
+	/* the hash stays less than half full */
+	if( vertices > 0 && vertices < OBJ_VERTEX_HASH_EMPTY && vertices <= (size_t)-1 / 8 )
+	{
+		size_t capacity = 256;
+
+		while( capacity < vertices * 2 )
+			capacity *= 2;
+
+		if( capacity > state->vertex_hash_mask + 1 )
+			result |= obj_vertex_hash_resize( state, capacity );
+	}
+
+	return result;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlObjReserveEstimate(
+	tlObjState *state,
+	const char *buffer,
+	size_t length,
+	size_t total_length )
+{
+	double points = 0, texcoords = 0, normals = 0, faces = 0, scale;
+	size_t sampled = 0, window_size = length;
+	unsigned int windows = 1, i;
+
+	if( state == NULL || buffer == NULL || length == 0 )
+		return 1;
+
+	if( total_length < length )
+		total_length = length;
+
+	/* large buffers are sampled at a few places, files often list all v first */
+	if( length > OBJ_ESTIMATE_WINDOWS * OBJ_ESTIMATE_WINDOW_SIZE )
+	{
+		windows = OBJ_ESTIMATE_WINDOWS;
+		window_size = OBJ_ESTIMATE_WINDOW_SIZE;
+	}
 
-	if( needed_size > state->command_buffer_size )
+	for( i = 0; i < windows; i++ )
 	{
-		unsigned int new_size = 128;
-		char *new_buffer;
+		const char *ptr = buffer + (length / windows) * i;
+		const char *end = ptr + window_size;
+
+		/* start at a line */
+		if( i > 0 )
+		{
+			ptr = memchr( ptr, '\n', end - ptr );
+			if( ptr == NULL )
+				continue;
+			ptr++;
+		}
 
-		while( new_size < needed_size )
-			new_size = new_size * 2;
+		sampled += (size_t)(end - ptr);
 
-		new_buffer = realloc( state->command_buffer, new_size );
-		if( new_buffer == NULL )
-			return 1;
+		while( ptr < end )
+		{
+			const char *line_end = memchr( ptr, '\n', end - ptr );
+			const char *command;
+			tlObjKeyword keyword;
+
+			if( line_end == NULL )
+				line_end = end;
+
+			ptr = obj_skip_whitespace( ptr, line_end );
+			command = ptr;
+			ptr = obj_find_whitespace( ptr, line_end );
+			keyword = obj_classify_keyword( command, (size_t)(ptr - command) );
+
+			if( keyword == OBJ_KEYWORD_VERTEX )
+				points++;
+			else if( keyword == OBJ_KEYWORD_TEXCOORD )
+				texcoords++;
+			else if( keyword == OBJ_KEYWORD_NORMAL )
+				normals++;
+			else if( keyword == OBJ_KEYWORD_FACE )
+			{
+				/* a polygon of n corners gives n - 2 triangles */
+				unsigned int corners = 0;
+
+				ptr = obj_skip_whitespace( ptr, line_end );
+				while( ptr < line_end && *ptr != '#' )
+				{
+					ptr = obj_skip_whitespace( obj_find_whitespace( ptr, line_end ), line_end );
+					corners++;
+				}
+
+				if( corners > 2 )
+					faces += corners - 2;
+			}
 
-		state->command_buffer = new_buffer;
-		state->command_buffer_size = new_size;
+			ptr = line_end + 1;
+		}
 	}
 
-	state->command_buffer[ state->command_buffer_length ] = c;
-	state->command_buffer_length++;
+	if( sampled == 0 )
+		return 0;
 
-	return 0;
+	scale = (double)total_length / (double)sampled;
+	points *= scale;
+	texcoords *= scale;
+	normals *= scale;
+	faces *= scale;
+
+	/* every (v, vt, vn) triple is a vertex, at least the largest list of them */
+	return tlObjReserve( state,
+		obj_estimate_count( points ),
+		obj_estimate_count( texcoords ),
+		obj_estimate_count( normals ),
+		obj_estimate_count( faces ),
+		obj_estimate_count( points > texcoords
+			? (points > normals ? points : normals)
+			: (texcoords > normals ? texcoords : normals) ) );
 }
 
 
 /*----------------------------------------------------------------------------*/
-static int obj_parameter_buffer_add( tlObjState *state, char c )
+int tlObjSetCallbacks(
+	tlObjState *state,
+	const tlObjCallbacks *callbacks )
 {
-	unsigned int needed_size = state->parameter_buffer_length + 1;
+	if( state == NULL )
+		return 1;
 
-	if( needed_size > state->parameter_buffer_size )
+	if( callbacks != NULL )
 	{
-		unsigned int new_size = 128;
-		char *new_buffer;
-
-		while( new_size < needed_size )
-			new_size = new_size * 2;
-
-		new_buffer = realloc( state->parameter_buffer, new_size );
-		if( new_buffer == NULL )
-			return 1;
-
-		state->parameter_buffer = new_buffer;
-		state->parameter_buffer_size = new_size;
+		state->callbacks = *callbacks;
+		state->use_callbacks = 1;
+	}
+	else
+	{
+		memset( &state->callbacks, 0, sizeof(tlObjCallbacks) );
+		state->use_callbacks = 0;
 	}
-
-	state->parameter_buffer[ state->parameter_buffer_length ] = c;
-	state->parameter_buffer_length++;
 
 	return 0;
 }
 
 
 /*----------------------------------------------------------------------------*/
-tlObjState *tlObjCreateState()
+tlObjSnapshot *tlObjSnapshotCreate( tlObjState *state )
 {
-	tlObjState *state = malloc( sizeof(tlObjState) );
+	tlObjSnapshot *snapshot, **link;
 
-	if( state )
-	{
-		memset( state, 0, sizeof(tlObjState) );
+	if( state == NULL || state->use_callbacks )
+		return NULL;
 
-		obj_material_add_defaults(state);
-		state->parsing_state = OBJ_STATE_SEARCH_COMMAND;
-		state->previous_parsing_state = OBJ_STATE_SEARCH_COMMAND;
-	}
+	snapshot = malloc( sizeof(tlObjSnapshot) );
+	if( snapshot == NULL )
+		return NULL;
 
-	return state;
+	snapshot->state = state;
+	snapshot->next = NULL;
+	snapshot->epoch = ++state->snapshot_epoch;
+	snapshot->real_size = state->real_size;
+
+	/* the last object still collects faces until parsing is done */
+	snapshot->objects = state->object_buffer;
+	snapshot->object_count = state->object_count;
+	if( state->parsing_state != OBJ_STATE_DONE && snapshot->object_count > 0 )
+		snapshot->object_count--;
+
+	snapshot->faces = state->face_buffer;
+	snapshot->face_count = state->face_count;
+
+	snapshot->vertices = state->vertex_map_buffer;
+	snapshot->vertex_count = state->vertex_map_count;
+
+	snapshot->points = state->point_buffer;
+	snapshot->point_count = state->point_count;
+	snapshot->texcoords = state->texcoord_buffer;
+	snapshot->texcoord_count = state->texcoord_count;
+	snapshot->normals = state->normal_buffer;
+	snapshot->normal_count = state->normal_count;
+
+	/* keep the list sorted by epoch */
+	link = &state->snapshot_list;
+	while( *link != NULL )
+		link = &(*link)->next;
+	*link = snapshot;
+
+	return snapshot;
 }
 
 
 /*----------------------------------------------------------------------------*/
-int tlObjResetState( tlObjState *state )
+void tlObjSnapshotRelease( tlObjSnapshot *snapshot )
 {
-	unsigned int i = 0;
+	tlObjState *state;
+	tlObjSnapshot **link;
 
-	for( i = 0; i<state->object_count; i++ )
-	{
-		tlObjObject *obj = state->object_buffer[i];
-		if( obj == NULL )
-			continue;
+	if( snapshot == NULL )
+		return;
 
-		if( obj->name )
-			free( obj->name );
-		obj->name = NULL;
+	state = snapshot->state;
 
-		free( obj );
-	}
+	link = &state->snapshot_list;
+	while( *link != NULL && *link != snapshot )
+		link = &(*link)->next;
 
-	for( i = 0; i<state->material_count; i++ )
-	{
-		if( state->material_buffer[i].name )
-			free( state->material_buffer[i].name );
-		state->material_buffer[i].name = NULL;
-	}
+	if( *link != NULL )
+		*link = snapshot->next;
 
-	for( i = 0; i<state->material_reference_count; i++ )
-	{
-		if( state->material_reference_buffer[i].name )
-			free( state->material_reference_buffer[i].name );
-		state->material_reference_buffer[i].name = NULL;
-	}
+	free( snapshot );
 
-	if( state->material_buffer )
-		free( state->material_buffer );
+	obj_state_free_retired( state );
+}
 
-	if( state->material_reference_buffer )
-		free( state->material_reference_buffer );
 
-	if( state->object_buffer )
-		free( state->object_buffer );
+/*----------------------------------------------------------------------------*/
+size_t tlObjSnapshotObjectCount( const tlObjSnapshot *snapshot )
+{
+	if( snapshot == NULL )
+		return 0;
 
-	if( state->point_buffer )
-		free( state->point_buffer );
+	return snapshot->object_count;
+}
 
-	if( state->face_buffer )
-		free( state->face_buffer );
 
-	if( state->vertex_map_buffer )
-		free( state->vertex_map_buffer );
+/*----------------------------------------------------------------------------*/
+const char *tlObjSnapshotObjectName( const tlObjSnapshot *snapshot, size_t object )
+{
+	if( snapshot == NULL || object >= snapshot->object_count )
+		return NULL;
 
-	if( state->normal_buffer )
-		free( state->normal_buffer );
+	return snapshot->objects[object].name;
+}
 
-	if( state->texcoord_buffer )
-		free( state->texcoord_buffer );
 
-	if( state->command_buffer )
-		free( state->command_buffer );
+/*----------------------------------------------------------------------------*/
+size_t tlObjSnapshotObjectFaceIndex( const tlObjSnapshot *snapshot, size_t object )
+{
+	if( snapshot == NULL || object >= snapshot->object_count )
+		return 0;
 
-	if( state->parameter_buffer )
-		free( state->parameter_buffer );
+	return snapshot->objects[object].index;
+}
 
-	memset( state, 0, sizeof(tlObjState) );
 
-	state->parsing_state = OBJ_STATE_SEARCH_COMMAND;
-	state->previous_parsing_state = OBJ_STATE_SEARCH_COMMAND;
+/*----------------------------------------------------------------------------*/
+size_t tlObjSnapshotObjectFaceCount( const tlObjSnapshot *snapshot, size_t object )
+{
+	if( snapshot == NULL || object >= snapshot->object_count )
+		return 0;
 
-	return 0;
+	return snapshot->objects[object].count;
 }
 
 
 /*----------------------------------------------------------------------------*/
-void tlObjDestroyState( tlObjState *state )
+size_t tlObjSnapshotVertexCount( const tlObjSnapshot *snapshot )
 {
-	if( state )
-	{
-		tlObjResetState( state );
-		free( state );
-	}
+	if( snapshot == NULL )
+		return 0;
+
+	return snapshot->vertex_count;
 }
 
 
 /*----------------------------------------------------------------------------*/
-int tlObjParse(
-	tlObjState *state,
-	const char *bytes,
-	unsigned int size,
-	int last )
+static float obj_snapshot_real(
+	const tlObjSnapshot *snapshot,
+	const void *buffer,
+	size_t index )
 {
-	unsigned int i = 0;
+	if( snapshot->real_size == sizeof(float) )
+		return ((const float *)buffer)[index];
 
-	if( state == NULL )
-		return 1;
+	return (float)((const double *)buffer)[index];
+}
 
-	while( i < size )
-	{
-		char c = bytes[i];
 
-		if( c == '#' && (state->parsing_state != OBJ_STATE_SKIP_COMMENT) )
-		{
-			state->previous_parsing_state = state->parsing_state;
-			state->parsing_state = OBJ_STATE_SKIP_COMMENT;
-			i++;
-			continue;
-		}
+/*----------------------------------------------------------------------------*/
+int tlObjSnapshotGetVertex(
+	const tlObjSnapshot *snapshot,
+	size_t index,
+	float *x, float *y, float *z,
+	float *tu, float *tv,
+	float *nx, float *ny, float *nz )
+{
+	size_t v = 0, vt = 0, vn = 0;
 
-		if( state->parsing_state == OBJ_STATE_SKIP_COMMENT )
-		{
-			if( c == '\n' )
-				state->parsing_state = state->previous_parsing_state;
-			i++;
-			continue;
-		}
+	if( snapshot == NULL )
+		return 1;
 
-		switch( state->parsing_state )
-		{
-		case OBJ_STATE_SEARCH_COMMAND:
-			if( obj_is_whitespace( c ) )
-				i++;
-			else
-				state->parsing_state = OBJ_STATE_PARSE_COMMAND;
+	if( index >= snapshot->vertex_count )
+		return 1;
 
-			break;
+	v = (size_t)(snapshot->vertices[index].v - 1);
+	vt = (size_t)snapshot->vertices[index].vt - 1;
+	vn = (size_t)snapshot->vertices[index].vn - 1;
 
-		case OBJ_STATE_PARSE_COMMAND:
-			if( obj_is_whitespace( c ) )
-			{
-				state->parsing_state = OBJ_STATE_SEARCH_PARAMETER;
-				obj_command_buffer_add( state, 0 );
-				continue;
-			}
+	if( snapshot->points && v < snapshot->point_count )
+	{
+		if( x )
+			*x = obj_snapshot_real( snapshot, snapshot->points, v * 3 );
 
-			obj_command_buffer_add( state, c );
+		if( y )
+			*y = obj_snapshot_real( snapshot, snapshot->points, v * 3 + 1 );
 
-			i++;
+		if( z )
+			*z = obj_snapshot_real( snapshot, snapshot->points, v * 3 + 2 );
+	}
 
-			break;
+	if( snapshot->texcoords && vt < snapshot->texcoord_count )
+	{
+		if( tu )
+			*tu = obj_snapshot_real( snapshot, snapshot->texcoords, vt * 2 );
 
-		case OBJ_STATE_SEARCH_PARAMETER:
-			/* handle missing paramter */
-			if( c == '\n' )
-			{
-				state->parsing_state = OBJ_STATE_PARSE_PARAMETER;
-				continue;
-			}
+		if( tv )
+			*tv = obj_snapshot_real( snapshot, snapshot->texcoords, vt * 2 + 1 );
+	}
 
-			if( obj_is_whitespace( c ) )
-				i++;
-			else
-				state->parsing_state = OBJ_STATE_PARSE_PARAMETER;
+	if( snapshot->normals && vn < snapshot->normal_count )
+	{
+		if( nx )
+			*nx = obj_snapshot_real( snapshot, snapshot->normals, vn * 3 );
 
-			break;
+		if( ny )
+			*ny = obj_snapshot_real( snapshot, snapshot->normals, vn * 3 + 1 );
 
-		case OBJ_STATE_PARSE_PARAMETER:
-			if( c == '\n' )
-			{
-				/* trim */
-				while( (state->parameter_buffer_length > 0) &&
-						obj_is_whitespace( state->parameter_buffer[ state->parameter_buffer_length-1 ] ) )
-					state->parameter_buffer_length--;
-				obj_parameter_buffer_add( state, 0 );
+		if( nz )
+			*nz = obj_snapshot_real( snapshot, snapshot->normals, vn * 3 + 2 );
+	}
 
-				obj_process_command( state );
+	return 0;
+}
 
-				state->parameter_buffer_length = 0;
-				state->command_buffer_length = 0;
-				state->parsing_state = OBJ_STATE_SEARCH_COMMAND;
-			}
-			else
-			{
-				obj_parameter_buffer_add( state, c );
-				i++;
-			}
 
-			break;
+/*----------------------------------------------------------------------------*/
+size_t tlObjSnapshotFaceCount( const tlObjSnapshot *snapshot )
+{
+	if( snapshot == NULL )
+		return 0;
 
-		default:
-			i++;
-			break;
-		}
-	}
+	return snapshot->face_count;
+}
 
-	if( last != 0 )
-	{
-		tlObjObject *object = NULL;
 
-		/* make sure we have at least one object */
-		if( state->object_count == 0 )
-		{
-			obj_state_add_object( state, "n/a", 4 );
-			state->object_buffer[ state->object_count - 1 ]->index = 0;
-		}
+/*----------------------------------------------------------------------------*/
+int tlObjSnapshotGetFaceInt(
+	const tlObjSnapshot *snapshot,
+	size_t index,
+	unsigned int *a,
+	unsigned int *b,
+	unsigned int *c )
+{
+	if( snapshot == NULL || index >= snapshot->face_count )
+		return 1;
 
-		object = state->object_buffer[ state->object_count - 1 ];
-		object->count = state->face_count - object->index;
+	if( a )
+		*a = snapshot->faces[ index * 3 ];
 
-		/* Close last material */
-		if( state->material_reference_count )
-		{
-			obj_material_reference_set_range(
-				state, state->last_material_face,
-				state->face_count - state->last_material_face );
-		}
+	if( b )
+		*b = snapshot->faces[ index * 3 + 1 ];
 
-		/* sort map, so face access is correct */
-		obj_quicksort_vertex_map( state->vertex_map_buffer, 0, state->vertex_map_count - 1 );
-		state->parsing_state = OBJ_STATE_DONE;
-	}
+	if( c )
+		*c = snapshot->faces[ index * 3 + 2 ];
 
 	return 0;
 }
 
+
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjObjectCount( tlObjState *state )
+size_t tlObjObjectCount( tlObjState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1154,7 +2699,7 @@ unsigned int tlObjObjectCount( tlObjState *state )
 
 
 /*----------------------------------------------------------------------------*/
-const char *tlObjObjectName( tlObjState *state, unsigned int object )
+const char *tlObjObjectName( tlObjState *state, size_t object )
 {
 	if( state == NULL )
 		return NULL;
@@ -1165,21 +2710,49 @@ const char *tlObjObjectName( tlObjState *state, unsigned int object )
 	if( object >= state->object_count )
 		return NULL;
 
-	return state->object_buffer[object]->name;
+	return state->object_buffer[object].name;
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjMaterialCount( tlObjState *state )
+size_t tlObjMaterialCount( tlObjState *state )
 {
+	size_t count, i;
+
 	if (state == NULL)
 		return 0;
 
-	return state->material_count;
+	count = state->material_count;
+	for( i = 0; i < state->adopted_count; i++ )
+		count += tlMtlMaterialCount( state->adopted_buffer[i] );
+
+	return count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the adopted library with the material, index becomes relative to it */
+static tlMtlState *obj_adopted_material( tlObjState *state, size_t *index )
+{
+	size_t i;
+
+	*index -= state->material_count;
+
+	for( i = 0; i < state->adopted_count; i++ )
+	{
+		size_t count = tlMtlMaterialCount( state->adopted_buffer[i] );
+
+		if( *index < count )
+			return state->adopted_buffer[i];
+
+		*index -= count;
+	}
+
+	return NULL;
 }
 
 
 /*----------------------------------------------------------------------------*/
-const char *tlObjMaterialName( tlObjState *state, unsigned int object )
+const char *tlObjMaterialName( tlObjState *state, size_t object )
 {
 
     if (state == NULL)
@@ -1189,14 +2762,17 @@ const char *tlObjMaterialName( tlObjState *state, unsigned int object )
 		return NULL;
 
 	if( object >=  state->material_count)
-		return NULL;
+	{
+		tlMtlState *library = obj_adopted_material( state, &object );
+		return tlMtlMaterialName( library, object );
+	}
 
     return state->material_buffer[object].name;
 }
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjMaterialLibCount( tlObjState *state )
+size_t tlObjMaterialLibCount( tlObjState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1206,7 +2782,7 @@ unsigned int tlObjMaterialLibCount( tlObjState *state )
 
 
 /*----------------------------------------------------------------------------*/
-const char *tlObjMaterialLibName( tlObjState *state, unsigned int object )
+const char *tlObjMaterialLibName( tlObjState *state, size_t object )
 {
 	if( state == NULL )
 		return 0;
@@ -1218,9 +2794,101 @@ const char *tlObjMaterialLibName( tlObjState *state, unsigned int object )
 }
 
 
+/*----------------------------------------------------------------------------*/
+int tlObjMergeMaterials( tlObjState *state, tlObjState *source )
+{
+	void *buffer;
+	size_t count, i;
+
+	if( state == NULL || source == NULL )
+		return 1;
+
+	count = tlObjMaterialCount( source );
+	if( count <= source->default_material_count )
+		return 0;
+
+	buffer = state->material_buffer;
+	if( obj_grow_buffer( &buffer, &state->material_buffer_size,
+		state->material_count + count - source->default_material_count,
+		sizeof(tlObjMaterial) ) )
+		return 1;
+
+	state->material_buffer = buffer;
+
+	for( i = source->default_material_count; i < count; i++ )
+	{
+		tlObjMaterial *material = &state->material_buffer[state->material_count];
+		size_t index = i;
+		const char *name;
+
+		if( i < source->material_count )
+		{
+			*material = source->material_buffer[i];
+			name = material->name;
+		}
+		else
+		{
+			tlMtlState *library = obj_adopted_material( source, &index );
+
+			tlMtlGetMaterial( library, index, material->ambient, material->diffuse,
+				material->specular, &material->shininess );
+			name = tlMtlMaterialName( library, index );
+		}
+
+		material->name = obj_state_copy_string( state, name );
+		if( material->name == NULL )
+			return 1;
+
+		state->material_count++;
+	}
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlObjAdoptMaterials( tlObjState *state, tlMtlState *materials )
+{
+	void *buffer;
+
+	if( state == NULL || materials == NULL )
+		return 1;
+
+	buffer = state->adopted_buffer;
+	if( obj_grow_buffer( &buffer, &state->adopted_buffer_size,
+		state->adopted_count + 1, sizeof(tlMtlState *) ) )
+		return 1;
+
+	state->adopted_buffer = buffer;
+	state->adopted_buffer[state->adopted_count++] = materials;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+size_t tlObjAdoptedCount( tlObjState *state )
+{
+	if( state == NULL )
+		return 0;
+
+	return state->adopted_count;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlMtlState *tlObjAdoptedMaterials( tlObjState *state, size_t index )
+{
+	if( state == NULL || index >= state->adopted_count )
+		return NULL;
+
+	return state->adopted_buffer[index];
+}
+
+
 /*----------------------------------------------------------------------------*/
 int tlObjGetMaterial(    tlObjState *state,
-                         unsigned int index,
+                         size_t index,
                          float *ambient, float *diffuse, float *specular,
                          float *shininess )
 {
@@ -1229,7 +2897,10 @@ int tlObjGetMaterial(    tlObjState *state,
 		return 1;
 
 	if( index >= state->material_count)
-		return 1;
+	{
+		tlMtlState *library = obj_adopted_material( state, &index );
+		return tlMtlGetMaterial( library, index, ambient, diffuse, specular, shininess );
+	}
 
 	if( ambient )
 		memcpy( ambient, state->material_buffer[index].ambient, sizeof(float) * 4 );
@@ -1247,7 +2918,7 @@ int tlObjGetMaterial(    tlObjState *state,
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjMaterialReferenceCount( tlObjState *state )
+size_t tlObjMaterialReferenceCount( tlObjState *state )
 {
     if (state == NULL)
         return 0;
@@ -1257,7 +2928,7 @@ unsigned int tlObjMaterialReferenceCount( tlObjState *state )
 
 
 /*----------------------------------------------------------------------------*/
-const char *tlObjMaterialReferenceName( tlObjState *state, unsigned int object )
+const char *tlObjMaterialReferenceName( tlObjState *state, size_t object )
 {
     if (state == NULL)
         return NULL;
@@ -1274,9 +2945,9 @@ const char *tlObjMaterialReferenceName( tlObjState *state, unsigned int object )
 
 /*----------------------------------------------------------------------------*/
 int tlObjGetMaterialReference( tlObjState *state,
-								unsigned int index,
-								unsigned int *face_index,
-								unsigned int *face_count)
+								size_t index,
+								size_t *face_index,
+								size_t *face_count)
 {
 	if( state == NULL )
 		return 1;
@@ -1294,7 +2965,7 @@ int tlObjGetMaterialReference( tlObjState *state,
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjObjectFaceCount( tlObjState *state, unsigned int object )
+size_t tlObjObjectFaceCount( tlObjState *state, size_t object )
 {
 	if( state == NULL )
 		return 0;
@@ -1305,12 +2976,12 @@ unsigned int tlObjObjectFaceCount( tlObjState *state, unsigned int object )
 	if( object >= state->object_count )
 		return 0;
 
-	return state->object_buffer[object]->count;
+	return state->object_buffer[object].count;
 }
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjObjectFaceIndex( tlObjState *state, unsigned int object )
+size_t tlObjObjectFaceIndex( tlObjState *state, size_t object )
 {
 
 	if( state == NULL )
@@ -1322,12 +2993,12 @@ unsigned int tlObjObjectFaceIndex( tlObjState *state, unsigned int object )
 	if( object >= state->object_count )
 		return 0;
 
-	return state->object_buffer[object]->index;
+	return state->object_buffer[object].index;
 }
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjVertexCount( tlObjState *state )
+size_t tlObjVertexCount( tlObjState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1342,12 +3013,12 @@ unsigned int tlObjVertexCount( tlObjState *state )
 /*----------------------------------------------------------------------------*/
 int tlObjGetVertexDouble(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	double *x, double *y, double *z,
 	double *tu, double *tv,
 	double *nx, double *ny, double *nz )
 {
-	unsigned int v = 0, vt = 0, vn = 0;
+	size_t v = 0, vt = 0, vn = 0;
 
 	if( state == NULL )
 		return 1;
@@ -1355,41 +3026,42 @@ int tlObjGetVertexDouble(
 	if( index >= state->vertex_map_count )
 		return 1;
 
-	v = state->vertex_map_buffer[index].v - 1;
-	vt = state->vertex_map_buffer[index].vt - 1;
-	vn = state->vertex_map_buffer[index].vn - 1;
+	/* missing indices are 0 and wrap around to a value out of range */
+	v = (size_t)(state->vertex_map_buffer[index].v - 1);
+	vt = (size_t)state->vertex_map_buffer[index].vt - 1;
+	vn = (size_t)state->vertex_map_buffer[index].vn - 1;
 
 	if( state->point_buffer && v < state->point_count )
 	{
 		if( x )
-			*x = state->point_buffer[ v * 3 ];
+			*x = obj_state_real( state, state->point_buffer, v * 3 );
 
 		if( y )
-			*y = state->point_buffer[ v * 3 + 1];
+			*y = obj_state_real( state, state->point_buffer, v * 3 + 1 );
 
 		if( z )
-			*z = state->point_buffer[ v * 3 + 2];
+			*z = obj_state_real( state, state->point_buffer, v * 3 + 2 );
 	}
 
 	if( state->texcoord_buffer && vt < state->texcoord_count )
 	{
 		if( tu )
-			*tu = state->texcoord_buffer[ vt * 2 ];
+			*tu = obj_state_real( state, state->texcoord_buffer, vt * 2 );
 
 		if( tv )
-			*tv = state->texcoord_buffer[ vt * 2 + 1];
+			*tv = obj_state_real( state, state->texcoord_buffer, vt * 2 + 1 );
 	}
 
 	if( state->normal_buffer && vn < state->normal_count )
 	{
 		if( nx )
-			*nx = state->normal_buffer[ vn * 3 ];
+			*nx = obj_state_real( state, state->normal_buffer, vn * 3 );
 
 		if( ny )
-			*ny = state->normal_buffer[ vn * 3 + 1];
+			*ny = obj_state_real( state, state->normal_buffer, vn * 3 + 1 );
 
 		if( nz )
-			*nz = state->normal_buffer[ vn * 3 + 2];
+			*nz = obj_state_real( state, state->normal_buffer, vn * 3 + 2 );
 	}
 
 
@@ -1400,12 +3072,12 @@ int tlObjGetVertexDouble(
 /*----------------------------------------------------------------------------*/
 int tlObjGetVertex(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	float *x, float *y, float *z,
 	float *tu, float *tv,
 	float *nx, float *ny, float *nz )
 {
-	unsigned int v = 0, vt = 0, vn = 0;
+	size_t v = 0, vt = 0, vn = 0;
 
 	if( state == NULL )
 		return 1;
@@ -1413,41 +3085,41 @@ int tlObjGetVertex(
 	if( index >= state->vertex_map_count )
 		return 1;
 
-	v = state->vertex_map_buffer[index].v - 1;
-	vt = state->vertex_map_buffer[index].vt - 1;
-	vn = state->vertex_map_buffer[index].vn - 1;
+	v = (size_t)(state->vertex_map_buffer[index].v - 1);
+	vt = (size_t)state->vertex_map_buffer[index].vt - 1;
+	vn = (size_t)state->vertex_map_buffer[index].vn - 1;
 
 	if( state->point_buffer && v < state->point_count )
 	{
 		if( x )
-			*x = (float)state->point_buffer[ v * 3 ];
+			*x = (float)obj_state_real( state, state->point_buffer, v * 3 );
 
 		if( y )
-			*y = (float)state->point_buffer[ v * 3 + 1];
+			*y = (float)obj_state_real( state, state->point_buffer, v * 3 + 1 );
 
 		if( z )
-			*z = (float)state->point_buffer[ v * 3 + 2];
+			*z = (float)obj_state_real( state, state->point_buffer, v * 3 + 2 );
 	}
 
 	if( state->texcoord_buffer && vt < state->texcoord_count )
 	{
 		if( tu )
-			*tu = (float)state->texcoord_buffer[ vt * 2 ];
+			*tu = (float)obj_state_real( state, state->texcoord_buffer, vt * 2 );
 
 		if( tv )
-			*tv = (float)state->texcoord_buffer[ vt * 2 + 1];
+			*tv = (float)obj_state_real( state, state->texcoord_buffer, vt * 2 + 1 );
 	}
 
 	if( state->normal_buffer && vn < state->normal_count )
 	{
 		if( nx )
-			*nx = (float)state->normal_buffer[ vn * 3 ];
+			*nx = (float)obj_state_real( state, state->normal_buffer, vn * 3 );
 
 		if( ny )
-			*ny = (float)state->normal_buffer[ vn * 3 + 1];
+			*ny = (float)obj_state_real( state, state->normal_buffer, vn * 3 + 1 );
 
 		if( nz )
-			*nz = (float)state->normal_buffer[ vn * 3 + 2];
+			*nz = (float)obj_state_real( state, state->normal_buffer, vn * 3 + 2 );
 	}
 
 
@@ -1456,7 +3128,7 @@ int tlObjGetVertex(
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjFaceCount( tlObjState *state )
+size_t tlObjFaceCount( tlObjState *state )
 {
 	if( state == NULL )
 		return 0;
@@ -1468,12 +3140,12 @@ unsigned int tlObjFaceCount( tlObjState *state )
 /*----------------------------------------------------------------------------*/
 int tlObjGetFaceInt(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	unsigned int *a,
 	unsigned int *b,
 	unsigned int *c )
 {
-	unsigned int face = 0;
+	size_t face = 0;
 
 	if( state == NULL )
 		return 1;
@@ -1497,12 +3169,12 @@ int tlObjGetFaceInt(
 /*----------------------------------------------------------------------------*/
 int tlObjGetFace(
 	tlObjState *state,
-	unsigned int index,
+	size_t index,
 	unsigned short *a,
 	unsigned short *b,
 	unsigned short *c )
 {
-	unsigned int face = 0;
+	size_t face = 0;
 
 	if( state == NULL )
 		return 1;
@@ -1523,10 +3195,30 @@ int tlObjGetFace(
 }
 
 
+/*----------------------------------------------------------------------------*/
+/* "gz" or "zst", the loaders decompress these */
+static int obj_is_compressed_extension( const char *ext )
+{
+	if( (ext[0] == 'g' || ext[0] == 'G')
+		&& (ext[1] == 'z' || ext[1] == 'Z')
+		&& (ext[2] == 0) )
+		return 1;
+
+	if( (ext[0] == 'z' || ext[0] == 'Z')
+		&& (ext[1] == 's' || ext[1] == 'S')
+		&& (ext[2] == 't' || ext[2] == 'T')
+		&& (ext[3] == 0) )
+		return 1;
+
+	return 0;
+}
+
+
 /*----------------------------------------------------------------------------*/
 int tlObjCheckFileExtension( const char *filename )
 {
-	const char *ext = 0, *tmp = filename;
+	const char *ext = 0, *previous = 0, *tmp = filename;
+	char end = 0;
 
 	if( filename == NULL )
 		return 1;
@@ -1534,7 +3226,10 @@ int tlObjCheckFileExtension( const char *filename )
 	while( *tmp != 0 )
 	{
 		if( *tmp == '.' )
+		{
+			previous = ext;
 			ext = tmp + 1;
+		}
 
 		tmp++;
 	}
@@ -1543,10 +3238,17 @@ int tlObjCheckFileExtension( const char *filename )
 	if( ext == 0 )
 		return 1;
 
+	/* look through a compression suffix */
+	if( previous != 0 && obj_is_compressed_extension( ext ) )
+	{
+		ext = previous;
+		end = '.';
+	}
+
 	if( (ext[0] == 'o' || ext[0] == 'O')
 		&& (ext[1] == 'b' || ext[1] == 'B')
 		&& (ext[2] == 'j' || ext[2] == 'J')
-		&& (ext[3] == 0) )
+		&& (ext[3] == end) )
 		return 0;
 
 	return 1;
@@ -1554,7 +3256,7 @@ int tlObjCheckFileExtension( const char *filename )
 
 
 /*----------------------------------------------------------------------------*/
-unsigned int tlObjHasNormals( tlObjState *state )
+size_t tlObjHasNormals( tlObjState *state )
 {
     return (state->normal_count);
 }
@@ -0,0 +1,830 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "trimeshloader/tlreader.h"
+#include "tlthread.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_FCNTL_H) && defined(HAVE_SYS_STAT_H)
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#define TL_READER_POSIX
+#endif
+
+#if defined(TL_READER_POSIX) && defined(HAVE_SYS_MMAN_H)
+	#include <sys/mman.h>
+	#define TL_READER_MMAP
+#endif
+
+/* 64 bit file offsets where long is not enough */
+#if defined(_MSC_VER)
+	#define tl_fseek _fseeki64
+	#define tl_ftell _ftelli64
+	typedef __int64 tl_off;
+#elif defined(HAVE_FSEEKO)
+	#include <sys/types.h>
+	#define tl_fseek fseeko
+	#define tl_ftell ftello
+	typedef off_t tl_off;
+#else
+	#define tl_fseek fseek
+	#define tl_ftell ftell
+	typedef long tl_off;
+#endif
+
+/* read ahead of the descriptor reader, doubled on every sequential refill */
+#define TL_READER_BLOCK_MIN (64 * 1024)
+#define TL_READER_BLOCK_MAX (4 * 1024 * 1024)
+
+/* defaults of the read ahead reader */
+#define TL_READ_AHEAD_BLOCK_SIZE (1024 * 1024)
+#define TL_READ_AHEAD_BLOCK_COUNT 3
+
+
+/*----------------------------------------------------------------------------*/
+static size_t file_read( void *user_data, void *buffer, size_t size )
+{
+	return fread( buffer, 1, size, (FILE *)user_data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int file_seek( void *user_data, size_t offset )
+{
+	return tl_fseek( (FILE *)user_data, (tl_off)offset, SEEK_SET ) != 0 ? 1 : 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* 0 if the size is unknown, the position is kept */
+static size_t file_size( void *user_data )
+{
+	FILE *file = (FILE *)user_data;
+	tl_off position, size;
+
+	position = tl_ftell( file );
+	if( position < 0 || tl_fseek( file, 0, SEEK_END ) != 0 )
+		return 0;
+
+	size = tl_ftell( file );
+
+	if( tl_fseek( file, position, SEEK_SET ) != 0 || size < 0 )
+		return 0;
+
+	return (size_t)size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void file_close( void *user_data )
+{
+	fclose( (FILE *)user_data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpenFile( tlReader *reader, const char *filename )
+{
+	FILE *file;
+
+	if( reader == NULL || filename == NULL )
+		return 1;
+
+	file = fopen( filename, "rb" );
+	if( file == NULL )
+		return 1;
+
+	reader->user_data = file;
+	reader->read = file_read;
+	reader->seek = file_seek;
+	reader->size = file_size;
+	reader->close = file_close;
+	reader->map = NULL;
+
+	return 0;
+}
+
+
+#ifdef TL_READER_POSIX
+/*----------------------------------------------------------------------------*/
+typedef struct descriptor_reader
+{
+	int fd;
+	size_t size;
+
+	/* read ahead, served from block_position up to block_length */
+	char *block;
+	size_t block_capacity;
+	size_t block_length;
+	size_t block_position;
+
+	/* bytes to read ahead next time */
+	size_t read_size;
+} descriptor_reader;
+
+
+/*----------------------------------------------------------------------------*/
+/* reads until size bytes, the end of the file or an error */
+static size_t descriptor_read_full( int fd, char *buffer, size_t size )
+{
+	size_t length = 0;
+
+	while( length < size )
+	{
+		ssize_t result = read( fd, buffer + length, size - length );
+
+		if( result < 0 && errno == EINTR )
+			continue;
+
+		if( result <= 0 )
+			break;
+
+		length += (size_t)result;
+	}
+
+	return length;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t descriptor_read( void *user_data, void *buffer, size_t size )
+{
+	descriptor_reader *reader = (descriptor_reader *)user_data;
+	char *out = (char *)buffer;
+	size_t length = 0;
+
+	while( length < size )
+	{
+		size_t available = reader->block_length - reader->block_position;
+
+		if( available > 0 )
+		{
+			if( available > size - length )
+				available = size - length;
+
+			memcpy( out + length, reader->block + reader->block_position, available );
+			reader->block_position += available;
+			length += available;
+			continue;
+		}
+
+		/* a block used up without seeking, take more at once this time */
+		if( reader->block_length > 0 && reader->read_size < TL_READER_BLOCK_MAX )
+			reader->read_size *= 2;
+
+		/* no point in copying what fills a block anyway */
+		if( size - length >= reader->read_size )
+			return length + descriptor_read_full( reader->fd, out + length, size - length );
+
+		if( reader->read_size > reader->block_capacity )
+		{
+			char *block = realloc( reader->block, reader->read_size );
+
+			if( block != NULL )
+			{
+				reader->block = block;
+				reader->block_capacity = reader->read_size;
+			}
+			else if( reader->block == NULL )
+				return length + descriptor_read_full( reader->fd, out + length, size - length );
+			else
+				reader->read_size = reader->block_capacity;
+		}
+
+		reader->block_length = descriptor_read_full( reader->fd, reader->block, reader->read_size );
+		reader->block_position = 0;
+
+		if( reader->block_length == 0 )
+			break;
+	}
+
+	return length;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int descriptor_seek( void *user_data, size_t offset )
+{
+	descriptor_reader *reader = (descriptor_reader *)user_data;
+
+	/* the block is useless after a jump, start small again */
+	reader->block_length = 0;
+	reader->block_position = 0;
+	reader->read_size = TL_READER_BLOCK_MIN;
+
+	if( (off_t)offset < 0 || (size_t)(off_t)offset != offset )
+		return 1;
+
+	return lseek( reader->fd, (off_t)offset, SEEK_SET ) == (off_t)-1 ? 1 : 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t descriptor_size( void *user_data )
+{
+	return ((descriptor_reader *)user_data)->size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void descriptor_close( void *user_data )
+{
+	descriptor_reader *reader = (descriptor_reader *)user_data;
+
+	close( reader->fd );
+	free( reader->block );
+	free( reader );
+}
+#endif
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpenDescriptor( tlReader *reader, const char *filename )
+{
+#ifdef TL_READER_POSIX
+	descriptor_reader *descriptor;
+	struct stat status;
+	int flags = O_RDONLY;
+
+	if( reader == NULL || filename == NULL )
+		return 1;
+
+#ifdef O_CLOEXEC
+	flags |= O_CLOEXEC;
+#endif
+
+	descriptor = malloc( sizeof(descriptor_reader) );
+	if( descriptor == NULL )
+		return 1;
+
+	memset( descriptor, 0, sizeof(descriptor_reader) );
+	descriptor->read_size = TL_READER_BLOCK_MIN;
+
+	descriptor->fd = open( filename, flags );
+	if( descriptor->fd < 0 )
+	{
+		free( descriptor );
+		return 1;
+	}
+
+	if( fstat( descriptor->fd, &status ) == 0 && S_ISREG( status.st_mode )
+		&& status.st_size >= 0 && (off_t)(size_t)status.st_size == status.st_size )
+		descriptor->size = (size_t)status.st_size;
+
+	reader->user_data = descriptor;
+	reader->read = descriptor_read;
+	reader->seek = descriptor_seek;
+	reader->size = descriptor_size;
+	reader->close = descriptor_close;
+	reader->map = NULL;
+
+	return 0;
+#else
+	(void)reader;
+	(void)filename;
+
+	return 1;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct memory_reader
+{
+	const char *data;
+	size_t size;
+	size_t position;
+} memory_reader;
+
+
+/*----------------------------------------------------------------------------*/
+static size_t memory_read( void *user_data, void *buffer, size_t size )
+{
+	memory_reader *reader = (memory_reader *)user_data;
+	size_t available = reader->size - reader->position;
+
+	if( size > available )
+		size = available;
+
+	if( size > 0 )
+		memcpy( buffer, reader->data + reader->position, size );
+	reader->position += size;
+
+	return size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int memory_seek( void *user_data, size_t offset )
+{
+	memory_reader *reader = (memory_reader *)user_data;
+
+	if( offset > reader->size )
+		return 1;
+
+	reader->position = offset;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t memory_size( void *user_data )
+{
+	return ((memory_reader *)user_data)->size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static const void *memory_map( void *user_data, size_t *size )
+{
+	memory_reader *reader = (memory_reader *)user_data;
+
+	*size = reader->size;
+
+	return reader->data;
+}
+
+
+#ifdef TL_READER_MMAP
+/*----------------------------------------------------------------------------*/
+/* a memory reader over a mapping */
+typedef struct mapped_reader
+{
+	memory_reader memory;
+	void *address;
+} mapped_reader;
+
+
+/*----------------------------------------------------------------------------*/
+static void mapped_close( void *user_data )
+{
+	mapped_reader *reader = (mapped_reader *)user_data;
+
+	munmap( reader->address, reader->memory.size );
+	free( reader );
+}
+#endif
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpenMapped( tlReader *reader, const char *filename, unsigned int flags )
+{
+#ifdef TL_READER_MMAP
+	mapped_reader *mapped;
+	struct stat status;
+	int fd, map_flags = MAP_PRIVATE;
+
+	if( reader == NULL || filename == NULL )
+		return 1;
+
+#ifdef MAP_POPULATE
+	if( flags & TL_READER_MAP_POPULATE )
+		map_flags |= MAP_POPULATE;
+#endif
+
+#ifdef O_CLOEXEC
+	fd = open( filename, O_RDONLY | O_CLOEXEC );
+#else
+	fd = open( filename, O_RDONLY );
+#endif
+	if( fd < 0 )
+		return 1;
+
+	/* nothing to map in empty files, pipes and the like */
+	if( fstat( fd, &status ) != 0 || !S_ISREG( status.st_mode ) || status.st_size <= 0
+		|| (off_t)(size_t)status.st_size != status.st_size )
+	{
+		close( fd );
+		return 1;
+	}
+
+	mapped = malloc( sizeof(mapped_reader) );
+	if( mapped == NULL )
+	{
+		close( fd );
+		return 1;
+	}
+
+	mapped->memory.size = (size_t)status.st_size;
+	mapped->memory.position = 0;
+	mapped->address = mmap( NULL, mapped->memory.size, PROT_READ, map_flags, fd, 0 );
+
+	/* the mapping keeps the file open */
+	close( fd );
+
+	if( mapped->address == MAP_FAILED )
+	{
+		free( mapped );
+		return 1;
+	}
+
+	mapped->memory.data = (const char *)mapped->address;
+
+#ifdef MADV_SEQUENTIAL
+	madvise( mapped->address, mapped->memory.size, MADV_SEQUENTIAL );
+#endif
+
+	reader->user_data = mapped;
+	reader->read = memory_read;
+	reader->seek = memory_seek;
+	reader->size = memory_size;
+	reader->close = mapped_close;
+	reader->map = memory_map;
+
+	return 0;
+#else
+	(void)reader;
+	(void)filename;
+	(void)flags;
+
+	return 1;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpenMemory( tlReader *reader, const void *data, size_t size )
+{
+	memory_reader *memory;
+
+	if( reader == NULL || (data == NULL && size > 0) )
+		return 1;
+
+	memory = malloc( sizeof(memory_reader) );
+	if( memory == NULL )
+		return 1;
+
+	memory->data = (const char *)data;
+	memory->size = size;
+	memory->position = 0;
+
+	reader->user_data = memory;
+	reader->read = memory_read;
+	reader->seek = memory_seek;
+	reader->size = memory_size;
+	reader->close = free;
+	reader->map = memory_map;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpen( void *open_data, const char *filename, tlReader *reader )
+{
+	(void)open_data;
+
+	if( tlReaderOpenDescriptor( reader, filename ) == 0 )
+		return 0;
+
+	return tlReaderOpenFile( reader, filename );
+}
+
+
+/*----------------------------------------------------------------------------*/
+typedef struct read_ahead_reader
+{
+	tlReader source;
+	size_t size;
+
+	/* ring of blocks, the thread fills them and the caller empties them */
+	char **blocks;
+	size_t *lengths;
+	size_t block_size;
+	size_t block_count;
+
+	/* blocks filled and emptied so far, the caller's offset in the next */
+	size_t produced;
+	size_t consumed;
+	size_t position;
+
+	/* the thread reached the end or is asked to stop */
+	int end;
+	int stop;
+
+	tl_mutex *mutex;
+	tl_condition *changed;
+	tl_thread *thread;
+
+	/* read without the thread right after a seek, there may be more */
+	int seeking;
+} read_ahead_reader;
+
+
+/*----------------------------------------------------------------------------*/
+static void read_ahead_fill( void *data )
+{
+	read_ahead_reader *reader = (read_ahead_reader *)data;
+
+	tl_mutex_lock( reader->mutex );
+
+	for( ;; )
+	{
+		size_t slot, length;
+
+		/* wait for the caller when all blocks are full */
+		while( !reader->stop && reader->produced - reader->consumed == reader->block_count )
+			tl_condition_wait( reader->changed, reader->mutex );
+
+		if( reader->stop )
+			break;
+
+		slot = reader->produced % reader->block_count;
+
+		tl_mutex_unlock( reader->mutex );
+		length = reader->source.read( reader->source.user_data,
+			reader->blocks[slot], reader->block_size );
+		tl_mutex_lock( reader->mutex );
+
+		reader->lengths[slot] = length;
+		reader->produced++;
+		if( length < reader->block_size )
+			reader->end = 1;
+
+		tl_condition_broadcast( reader->changed );
+
+		if( reader->end )
+			break;
+	}
+
+	tl_mutex_unlock( reader->mutex );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void read_ahead_stop( read_ahead_reader *reader )
+{
+	if( reader->thread == NULL )
+		return;
+
+	tl_mutex_lock( reader->mutex );
+	reader->stop = 1;
+	tl_condition_broadcast( reader->changed );
+	tl_mutex_unlock( reader->mutex );
+
+	tl_thread_join( reader->thread );
+	reader->thread = NULL;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t read_ahead_read( void *user_data, void *buffer, size_t size )
+{
+	read_ahead_reader *reader = (read_ahead_reader *)user_data;
+	char *out = (char *)buffer;
+	size_t length = 0;
+
+	if( reader->thread == NULL )
+	{
+		/* a single read after a seek is likely a sample */
+		if( reader->seeking )
+		{
+			reader->seeking = 0;
+			return reader->source.read( reader->source.user_data, buffer, size );
+		}
+
+		reader->produced = 0;
+		reader->consumed = 0;
+		reader->position = 0;
+		reader->end = 0;
+		reader->stop = 0;
+
+		reader->thread = tl_thread_spawn( read_ahead_fill, reader );
+		if( reader->thread == NULL )
+			return reader->source.read( reader->source.user_data, buffer, size );
+	}
+
+	while( length < size )
+	{
+		size_t slot, available;
+
+		tl_mutex_lock( reader->mutex );
+		while( reader->produced == reader->consumed && !reader->end )
+			tl_condition_wait( reader->changed, reader->mutex );
+
+		if( reader->produced == reader->consumed )
+		{
+			tl_mutex_unlock( reader->mutex );
+			break;
+		}
+		tl_mutex_unlock( reader->mutex );
+
+		/* the thread leaves this block alone until it is consumed */
+		slot = reader->consumed % reader->block_count;
+		available = reader->lengths[slot] - reader->position;
+		if( available > size - length )
+			available = size - length;
+
+		memcpy( out + length, reader->blocks[slot] + reader->position, available );
+		reader->position += available;
+		length += available;
+
+		if( reader->position == reader->lengths[slot] )
+		{
+			tl_mutex_lock( reader->mutex );
+			reader->consumed++;
+			reader->position = 0;
+			tl_condition_broadcast( reader->changed );
+			tl_mutex_unlock( reader->mutex );
+		}
+	}
+
+	return length;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int read_ahead_seek( void *user_data, size_t offset )
+{
+	read_ahead_reader *reader = (read_ahead_reader *)user_data;
+
+	read_ahead_stop( reader );
+	reader->seeking = 1;
+
+	return reader->source.seek( reader->source.user_data, offset );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static size_t read_ahead_size( void *user_data )
+{
+	return ((read_ahead_reader *)user_data)->size;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void read_ahead_close( void *user_data )
+{
+	read_ahead_reader *reader = (read_ahead_reader *)user_data;
+	size_t i;
+
+	read_ahead_stop( reader );
+	tlReaderClose( &reader->source );
+
+	for( i = 0; reader->blocks != NULL && i < reader->block_count; i++ )
+		free( reader->blocks[i] );
+
+	free( reader->blocks );
+	free( reader->lengths );
+	tl_condition_destroy( reader->changed );
+	tl_mutex_destroy( reader->mutex );
+	free( reader );
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderReadAhead(
+	tlReader *reader,
+	tlReader *source,
+	size_t block_size,
+	unsigned int block_count )
+{
+	read_ahead_reader *ahead;
+	size_t i;
+
+	if( reader == NULL || source == NULL || source->read == NULL )
+		return 1;
+
+	/* nothing to wait for in memory */
+	if( source->map != NULL )
+	{
+		*reader = *source;
+		return 0;
+	}
+
+	ahead = malloc( sizeof(read_ahead_reader) );
+	if( ahead == NULL )
+	{
+		tlReaderClose( source );
+		return 1;
+	}
+
+	memset( ahead, 0, sizeof(read_ahead_reader) );
+	ahead->source = *source;
+	ahead->block_size = block_size > 0 ? block_size : TL_READ_AHEAD_BLOCK_SIZE;
+	ahead->block_count = block_count > 0 ? block_count : TL_READ_AHEAD_BLOCK_COUNT;
+	if( ahead->block_count < 2 )
+		ahead->block_count = 2;
+
+	/* the source is busy on the thread later on */
+	if( source->size != NULL )
+		ahead->size = source->size( source->user_data );
+
+	/* no threads, read directly */
+	ahead->mutex = tl_mutex_create();
+	ahead->changed = tl_condition_create();
+	if( ahead->mutex == NULL || ahead->changed == NULL )
+	{
+		tl_condition_destroy( ahead->changed );
+		tl_mutex_destroy( ahead->mutex );
+		free( ahead );
+
+		*reader = *source;
+		return 0;
+	}
+
+	ahead->blocks = calloc( ahead->block_count, sizeof(char *) );
+	ahead->lengths = calloc( ahead->block_count, sizeof(size_t) );
+	if( ahead->blocks == NULL || ahead->lengths == NULL )
+	{
+		read_ahead_close( ahead );
+		return 1;
+	}
+
+	for( i = 0; i < ahead->block_count; i++ )
+	{
+		ahead->blocks[i] = malloc( ahead->block_size );
+		if( ahead->blocks[i] == NULL )
+		{
+			read_ahead_close( ahead );
+			return 1;
+		}
+	}
+
+	reader->user_data = ahead;
+	reader->read = read_ahead_read;
+	reader->seek = source->seek != NULL ? read_ahead_seek : NULL;
+	reader->size = read_ahead_size;
+	reader->close = read_ahead_close;
+	reader->map = NULL;
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpenReadAhead( void *open_data, const char *filename, tlReader *reader )
+{
+	const tlReadAheadOptions *options = (const tlReadAheadOptions *)open_data;
+	tlReader source;
+	int result;
+
+	if( options != NULL && options->open != NULL )
+		result = options->open( options->open_data, filename, &source );
+	else
+		result = tlReaderOpen( NULL, filename, &source );
+
+	if( result != 0 )
+		return 1;
+
+	if( options != NULL )
+		return tlReaderReadAhead( reader, &source, options->block_size, options->block_count );
+
+	return tlReaderReadAhead( reader, &source, 0, 0 );
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tlReaderOpenMap( void *open_data, const char *filename, tlReader *reader )
+{
+	unsigned int flags = open_data != NULL ? *(const unsigned int *)open_data : 0;
+
+	if( tlReaderOpenMapped( reader, filename, flags ) == 0 )
+		return 0;
+
+	return tlReaderOpen( NULL, filename, reader );
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tlReaderClose( tlReader *reader )
+{
+	if( reader == NULL )
+		return;
+
+	if( reader->close )
+		reader->close( reader->user_data );
+
+	memset( reader, 0, sizeof(tlReader) );
+}
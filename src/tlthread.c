@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
+#include "tlthread.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	/* condition variables came with Vista */
+	#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+		#undef _WIN32_WINNT
+		#define _WIN32_WINNT 0x0600
+	#endif
+	#include <windows.h>
+	#define TL_THREAD_WIN32
+#elif defined(HAVE_PTHREAD)
+	#include <pthread.h>
+	#include <unistd.h>
+	#define TL_THREAD_POSIX
+#endif
+
+/*----------------------------------------------------------------------------*/
+struct tl_thread
+{
+	tl_thread_function function;
+	void *data;
+
+#if defined(TL_THREAD_WIN32)
+	HANDLE handle;
+#elif defined(TL_THREAD_POSIX)
+	pthread_t handle;
+#endif
+};
+
+
+/*----------------------------------------------------------------------------*/
+struct tl_mutex
+{
+#if defined(TL_THREAD_WIN32)
+	CRITICAL_SECTION handle;
+#elif defined(TL_THREAD_POSIX)
+	pthread_mutex_t handle;
+#else
+	int unused;
+#endif
+};
+
+
+/*----------------------------------------------------------------------------*/
+struct tl_condition
+{
+#if defined(TL_THREAD_WIN32)
+	CONDITION_VARIABLE handle;
+#elif defined(TL_THREAD_POSIX)
+	pthread_cond_t handle;
+#else
+	int unused;
+#endif
+};
+
+
+#if defined(TL_THREAD_WIN32)
+/*----------------------------------------------------------------------------*/
+static DWORD WINAPI tl_thread_main( LPVOID parameter )
+{
+	tl_thread *thread = (tl_thread *)parameter;
+	thread->function( thread->data );
+	return 0;
+}
+#elif defined(TL_THREAD_POSIX)
+/*----------------------------------------------------------------------------*/
+static void *tl_thread_main( void *parameter )
+{
+	tl_thread *thread = (tl_thread *)parameter;
+	thread->function( thread->data );
+	return NULL;
+}
+#endif
+
+
+/*----------------------------------------------------------------------------*/
+tl_thread *tl_thread_start( tl_thread_function function, void *data )
+{
+	tl_thread *thread = malloc( sizeof(tl_thread) );
+
+	if( thread == NULL )
+		return NULL;
+
+	thread->function = function;
+	thread->data = data;
+
+#if defined(TL_THREAD_WIN32)
+	thread->handle = CreateThread( NULL, 0, tl_thread_main, thread, 0, NULL );
+	if( thread->handle != NULL )
+		return thread;
+#elif defined(TL_THREAD_POSIX)
+	if( pthread_create( &thread->handle, NULL, tl_thread_main, thread ) == 0 )
+		return thread;
+#endif
+
+	/* no threads (left), do the work right here */
+	function( data );
+	thread->function = NULL;
+
+	return thread;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tl_thread *tl_thread_spawn( tl_thread_function function, void *data )
+{
+#if defined(TL_THREAD_WIN32) || defined(TL_THREAD_POSIX)
+	tl_thread *thread = malloc( sizeof(tl_thread) );
+
+	if( thread == NULL )
+		return NULL;
+
+	thread->function = function;
+	thread->data = data;
+
+#if defined(TL_THREAD_WIN32)
+	thread->handle = CreateThread( NULL, 0, tl_thread_main, thread, 0, NULL );
+	if( thread->handle != NULL )
+		return thread;
+#else
+	if( pthread_create( &thread->handle, NULL, tl_thread_main, thread ) == 0 )
+		return thread;
+#endif
+
+	free( thread );
+#else
+	(void)function;
+	(void)data;
+#endif
+
+	return NULL;
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_thread_join( tl_thread *thread )
+{
+	if( thread == NULL )
+		return;
+
+#if defined(TL_THREAD_WIN32)
+	if( thread->function )
+	{
+		WaitForSingleObject( thread->handle, INFINITE );
+		CloseHandle( thread->handle );
+	}
+#elif defined(TL_THREAD_POSIX)
+	if( thread->function )
+		pthread_join( thread->handle, NULL );
+#endif
+
+	free( thread );
+}
+
+
+/*----------------------------------------------------------------------------*/
+unsigned int tl_thread_cpu_count( void )
+{
+#if defined(TL_THREAD_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+#elif defined(TL_THREAD_POSIX) && defined(_SC_NPROCESSORS_ONLN)
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (unsigned int)count : 1;
+#else
+	return 1;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+int tl_thread_supported( void )
+{
+#if defined(TL_THREAD_WIN32) || defined(TL_THREAD_POSIX)
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+tl_mutex *tl_mutex_create( void )
+{
+#if defined(TL_THREAD_WIN32) || defined(TL_THREAD_POSIX)
+	tl_mutex *mutex = malloc( sizeof(tl_mutex) );
+
+	if( mutex == NULL )
+		return NULL;
+
+#if defined(TL_THREAD_WIN32)
+	InitializeCriticalSection( &mutex->handle );
+#else
+	if( pthread_mutex_init( &mutex->handle, NULL ) != 0 )
+	{
+		free( mutex );
+		return NULL;
+	}
+#endif
+
+	return mutex;
+#else
+	return NULL;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_mutex_destroy( tl_mutex *mutex )
+{
+	if( mutex == NULL )
+		return;
+
+#if defined(TL_THREAD_WIN32)
+	DeleteCriticalSection( &mutex->handle );
+#elif defined(TL_THREAD_POSIX)
+	pthread_mutex_destroy( &mutex->handle );
+#endif
+
+	free( mutex );
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_mutex_lock( tl_mutex *mutex )
+{
+	if( mutex == NULL )
+		return;
+
+#if defined(TL_THREAD_WIN32)
+	EnterCriticalSection( &mutex->handle );
+#elif defined(TL_THREAD_POSIX)
+	pthread_mutex_lock( &mutex->handle );
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_mutex_unlock( tl_mutex *mutex )
+{
+	if( mutex == NULL )
+		return;
+
+#if defined(TL_THREAD_WIN32)
+	LeaveCriticalSection( &mutex->handle );
+#elif defined(TL_THREAD_POSIX)
+	pthread_mutex_unlock( &mutex->handle );
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+tl_condition *tl_condition_create( void )
+{
+#if defined(TL_THREAD_WIN32) || defined(TL_THREAD_POSIX)
+	tl_condition *condition = malloc( sizeof(tl_condition) );
+
+	if( condition == NULL )
+		return NULL;
+
+#if defined(TL_THREAD_WIN32)
+	InitializeConditionVariable( &condition->handle );
+#else
+	if( pthread_cond_init( &condition->handle, NULL ) != 0 )
+	{
+		free( condition );
+		return NULL;
+	}
+#endif
+
+	return condition;
+#else
+	return NULL;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_condition_destroy( tl_condition *condition )
+{
+	if( condition == NULL )
+		return;
+
+#if defined(TL_THREAD_POSIX)
+	pthread_cond_destroy( &condition->handle );
+#endif
+
+	free( condition );
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_condition_wait( tl_condition *condition, tl_mutex *mutex )
+{
+	if( condition == NULL || mutex == NULL )
+		return;
+
+#if defined(TL_THREAD_WIN32)
+	SleepConditionVariableCS( &condition->handle, &mutex->handle, INFINITE );
+#elif defined(TL_THREAD_POSIX)
+	pthread_cond_wait( &condition->handle, &mutex->handle );
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tl_condition_broadcast( tl_condition *condition )
+{
+	if( condition == NULL )
+		return;
+
+#if defined(TL_THREAD_WIN32)
+	WakeAllConditionVariable( &condition->handle );
+#elif defined(TL_THREAD_POSIX)
+	pthread_cond_broadcast( &condition->handle );
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2007-2017 Gero Mueller <post@geromueller.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *    1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ *
+ *    2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ *
+ *    3. This notice may not be removed or altered from any source
+ *    distribution.
+ */
+
+#ifndef TRIMESH_LOADER_THREAD_H
+#define TRIMESH_LOADER_THREAD_H
+
+/*
+ * Minimal internal thread wrapper. POSIX threads are used when configure
+ * found them (HAVE_PTHREAD), Win32 threads on Windows. Without either,
+ * tl_thread_start runs the function right away on the calling thread, so
+ * callers get the same results, only without the parallelism.
+ */
+
+typedef struct tl_thread tl_thread;
+
+typedef void (*tl_thread_function)( void *data );
+
+/* returns NULL only if the function could not be run at all */
+tl_thread *tl_thread_start( tl_thread_function function, void *data );
+
+/* returns NULL instead of running the function if no thread can be started,
+ * for functions that wait for the caller */
+tl_thread *tl_thread_spawn( tl_thread_function function, void *data );
+
+/* waits for the thread and frees it */
+void tl_thread_join( tl_thread *thread );
+
+/* number of processors online, at least 1 */
+unsigned int tl_thread_cpu_count( void );
+
+/* 1 if threads are built in, a NULL from the create functions below is
+ * an error then */
+int tl_thread_supported( void );
+
+/*
+ * Locks and conditions for threads from tl_thread_spawn. Without thread
+ * support create returns NULL and the other functions do nothing.
+ */
+
+typedef struct tl_mutex tl_mutex;
+
+typedef struct tl_condition tl_condition;
+
+tl_mutex *tl_mutex_create( void );
+
+void tl_mutex_destroy( tl_mutex *mutex );
+
+void tl_mutex_lock( tl_mutex *mutex );
+
+void tl_mutex_unlock( tl_mutex *mutex );
+
+tl_condition *tl_condition_create( void );
+
+void tl_condition_destroy( tl_condition *condition );
+
+/* mutex has to be locked, it is again when this returns */
+void tl_condition_wait( tl_condition *condition, tl_mutex *mutex );
+
+/* wakes all waiting threads */
+void tl_condition_broadcast( tl_condition *condition );
+
+#endif
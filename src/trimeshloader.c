@@ -21,11 +21,22 @@
  *    distribution.
  */
 
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+
 #include "trimeshloader/trimeshloader.h"
+#include "tlthread.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+
+#if defined(WIN32) || defined(HAVE_SYS_STAT_H)
+	#include <sys/types.h>
+	#include <sys/stat.h>
+#endif
 
 #ifdef WIN32
 	#define PATH_SEPARATOR  '\\'
@@ -33,12 +44,117 @@
 	#define PATH_SEPARATOR  '/'
 #endif
 
+/* bytes handed to the parsers at once */
+#define LOAD_BUFFER_SIZE (256 * 1024)
+
+/* bytes sampled for the OBJ reservation estimate */
+#define LOAD_SAMPLE_SIZE (64 * 1024)
+
+/* 3DS chunks skipped by seeking, shorter ones are cheaper to read through */
+#define LOAD_SEEK_SIZE (64 * 1024)
+
+
+/*----------------------------------------------------------------------------*/
+/* 0 if the size is unknown */
+static size_t reader_size( tlReader *reader )
+{
+	if( reader->size == NULL )
+		return 0;
+
+	return reader->size( reader->user_data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the whole file if the reader has it in memory, NULL otherwise */
+static const char *reader_map( tlReader *reader, size_t *size )
+{
+	if( reader->map == NULL )
+		return NULL;
+
+	return (const char *)reader->map( reader->user_data, size );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* fills buffer with blocks from a few places of the file and rewinds it,
+ * 0 if the reader cannot seek */
+static size_t read_file_sample( tlReader *reader, size_t file_size, char *buffer, size_t size )
+{
+	size_t blocks = file_size > size ? 8 : 1;
+	size_t block_size = size / blocks, length = 0, i;
+
+	if( reader->seek == NULL )
+		return 0;
+
+	for( i = 0; i < blocks; i++ )
+	{
+		if( reader->seek( reader->user_data, (file_size / blocks) * i ) != 0 )
+			break;
+
+		length += reader->read( reader->user_data, buffer + length, block_size );
+	}
+
+	if( reader->seek( reader->user_data, 0 ) != 0 )
+		return 0;
+
+	return length;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the whole data, read into *owned if the reader does not have it in memory */
+static const char *reader_data( tlReader *reader, size_t *size, char **owned )
+{
+	const char *data = reader_map( reader, size );
+	size_t buffer_size, length = 0, count;
+	char *buffer = NULL;
+
+	*owned = NULL;
+	if( data != NULL )
+		return data;
+
+	buffer_size = reader_size( reader ) + 1;
+	if( buffer_size < LOAD_BUFFER_SIZE )
+		buffer_size = LOAD_BUFFER_SIZE;
+
+	for( ;; )
+	{
+		if( length == buffer_size || buffer == NULL )
+		{
+			char *new_buffer;
+
+			if( buffer != NULL )
+				buffer_size = buffer_size <= (size_t)-1 / 2 ? buffer_size * 2 : (size_t)-1;
+
+			new_buffer = buffer_size > length ? realloc( buffer, buffer_size ) : NULL;
+			if( new_buffer == NULL )
+			{
+				free( buffer );
+				return NULL;
+			}
+
+			buffer = new_buffer;
+		}
+
+		count = reader->read( reader->user_data, buffer + length, buffer_size - length );
+		length += count;
+		if( count == 0 )
+			break;
+	}
+
+	*owned = buffer;
+	*size = length;
+
+	return buffer;
+}
+
 
 /*----------------------------------------------------------------------------*/
 tlTrimesh *tlCreateTrimeshFrom3dsState( tl3dsState *state, unsigned int vertex_format )
 {
 	tlTrimesh *trimesh = NULL;
-	unsigned int i = 0, index = 0;
+	size_t i = 0, index = 0;
 
 	if( state == NULL )
 		return NULL;
@@ -84,11 +200,11 @@ tlTrimesh *tlCreateTrimeshFrom3dsState( tl3dsState *state, unsigned int vertex_f
 	}
 
 	trimesh->face_count = tl3dsFaceCount( state );
-	trimesh->faces = malloc( sizeof(unsigned short) * trimesh->face_count * 3 );
+	trimesh->faces = malloc( sizeof(unsigned int) * trimesh->face_count * 3 );
 	for( i = 0; i < trimesh->face_count; i++ )
 	{
-		unsigned int offset = i * 3;
-		tl3dsGetFace( state, i,
+		size_t offset = i * 3;
+		tl3dsGetFaceInt( state, i,
 			&trimesh->faces[offset],
 			&trimesh->faces[offset + 1],
 			&trimesh->faces[offset + 2] );
@@ -135,39 +251,213 @@ tlTrimesh *tlCreateTrimeshFrom3dsState( tl3dsState *state, unsigned int vertex_f
 
 
 /*----------------------------------------------------------------------------*/
-tlTrimesh *tlLoad3DS( const char *filename, unsigned int vertex_format )
+static tlTrimesh *load_3ds_reader( tlReader *reader, unsigned int vertex_format )
 {
-	FILE *f = 0;
 	tlTrimesh *trimesh = NULL;
+	tl3dsState *state = NULL;
+	char *buffer = NULL;
+	const char *data = NULL;
+	size_t data_size = 0;
+
+	/* parse in place what is in memory already */
+	data = reader_map( reader, &data_size );
+	if( data != NULL )
+	{
+		state = tl3dsCreateState();
+		if( state == NULL )
+			return NULL;
 
-	if( filename == NULL )
+		tl3dsReserveEstimate( state, data, data_size, data_size );
+		tl3dsParse( state, data, data_size, 1 );
+
+		trimesh = tlCreateTrimeshFrom3dsState( state, vertex_format );
+
+		tl3dsDestroyState( state );
+
+		return trimesh;
+	}
+
+	buffer = malloc( LOAD_BUFFER_SIZE );
+	if( buffer == NULL )
 		return NULL;
 
-	f = fopen( filename, "rb" );
-	if( f )
+	state = tl3dsCreateState();
+	if( state )
 	{
-		tl3dsState *state = NULL;
+		size_t size = 0, offset = 0, skip;
+		size_t file_size = reader_size( reader );
+		int first = 1;
 
-		state = tl3dsCreateState();
-		if( state )
+		do
 		{
-			char buffer[1024];
-			unsigned int size = 0;
+			size = reader->read( reader->user_data, buffer, LOAD_BUFFER_SIZE );
+			offset += size;
+
+			/* the chunk headers tell how much room the arrays need */
+			if( first && file_size > 0 )
+				tl3dsReserveEstimate( state, buffer, size, file_size );
+			first = 0;
+
+			tl3dsParse( state, buffer, size, size < LOAD_BUFFER_SIZE ? 1 : 0 );
+
+			/* seek past large chunks nobody reads, like animation tracks */
+			skip = tl3dsSkipLength( state );
+			if( size == LOAD_BUFFER_SIZE && skip >= LOAD_SEEK_SIZE
+				&& reader->seek != NULL && offset <= file_size
+				&& skip <= file_size - offset
+				&& reader->seek( reader->user_data, offset + skip ) == 0 )
+			{
+				tl3dsSkip( state, skip );
+				offset += skip;
+			}
+		}
+		while( size == LOAD_BUFFER_SIZE );
+
+		trimesh = tlCreateTrimeshFrom3dsState( state, vertex_format );
+
+		tl3dsDestroyState( state );
+	}
+
+	free( buffer );
+
+	return trimesh;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoad3DSReader( tlReader *reader, unsigned int vertex_format )
+{
+	tlTrimesh *trimesh = NULL;
+	tlReader borrowed, input;
 
-			while( !feof( f ) )
+	if( reader == NULL || reader->read == NULL )
+		return NULL;
+
+	/* the caller closes the reader */
+	borrowed = *reader;
+	borrowed.close = NULL;
+
+	if( tlReaderDecompress( &input, &borrowed ) != 0 )
+		return NULL;
+
+	trimesh = load_3ds_reader( &input, vertex_format );
+
+	tlReaderClose( &input );
+
+	return trimesh;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static tlTrimesh *load_3ds_file(
+	const char *filename,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format )
+{
+	tlTrimesh *trimesh = NULL;
+	tlReader reader;
+
+	if( filename == NULL )
+		return NULL;
+
+	if( open( open_data, filename, &reader ) != 0 )
+		return NULL;
+
+	trimesh = tlLoad3DSReader( &reader, vertex_format );
+
+	tlReaderClose( &reader );
+
+	return trimesh;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoad3DS( const char *filename, unsigned int vertex_format )
+{
+	return load_3ds_file( filename, tlReaderOpen, NULL, vertex_format );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static tlTrimesh *load_3ds_objects( tlReader *reader, const char *const *names,
+	size_t name_count, unsigned int vertex_format )
+{
+	tlTrimesh *trimesh = NULL;
+	tl3dsIndex *index;
+	tl3dsState *state;
+	size_t size = 0, count = 0, i, j;
+	size_t *objects;
+	const char *data;
+	char *owned;
+
+	data = reader_data( reader, &size, &owned );
+	if( data == NULL )
+		return NULL;
+
+	index = tl3dsIndexCreate( data, size );
+	objects = malloc( sizeof(size_t) * (tl3dsIndexObjectCount( index ) + 1) );
+	if( index != NULL && objects != NULL )
+	{
+		/* every object with one of the names, in file order */
+		for( i = 0; i < tl3dsIndexObjectCount( index ); i++ )
+		{
+			for( j = 0; j < name_count; j++ )
 			{
-				size = (unsigned int) fread( buffer, 1, sizeof(buffer), f );
-				tl3dsParse( state, buffer, size, size < sizeof(buffer) ? 1 : 0 );
+				if( names[j] != NULL && strcmp( tl3dsIndexObjectName( index, i ), names[j] ) == 0 )
+				{
+					objects[count++] = i;
+					break;
+				}
 			}
+		}
 
-			trimesh = tlCreateTrimeshFrom3dsState( state, vertex_format );
+		state = count > 0 ? tl3dsCreateState() : NULL;
+		if( state != NULL )
+		{
+			if( tl3dsIndexParse( index, state, objects, count ) == 0 )
+				trimesh = tlCreateTrimeshFrom3dsState( state, vertex_format );
 
 			tl3dsDestroyState( state );
 		}
+	}
+
+	free( objects );
+	tl3dsIndexDestroy( index );
+	free( owned );
+
+	return trimesh;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoad3DSObjects(
+	const char *filename,
+	const char *const *names,
+	size_t name_count,
+	unsigned int vertex_format )
+{
+	tlTrimesh *trimesh = NULL;
+	tlReader reader, borrowed, input;
+
+	if( filename == NULL || names == NULL )
+		return NULL;
+
+	/* mapped, only the chunk headers and the objects are paged in */
+	if( tlReaderOpenMap( NULL, filename, &reader ) != 0 )
+		return NULL;
+
+	borrowed = reader;
+	borrowed.close = NULL;
 
-		fclose( f );
+	if( tlReaderDecompress( &input, &borrowed ) == 0 )
+	{
+		trimesh = load_3ds_objects( &input, names, name_count, vertex_format );
+		tlReaderClose( &input );
 	}
 
+	tlReaderClose( &reader );
+
 	return trimesh;
 }
 
@@ -176,7 +466,8 @@ tlTrimesh *tlLoad3DS( const char *filename, unsigned int vertex_format )
 tlTrimesh *tlCreateTrimeshFromObjState( tlObjState *state, unsigned int vertex_format )
 {
 	tlTrimesh *trimesh = NULL;
-	unsigned int i = 0, index = 0;
+	size_t i = 0, index = 0;
+	size_t own_material_count;
 
 	if( state == NULL )
 		return NULL;
@@ -195,14 +486,35 @@ tlTrimesh *tlCreateTrimeshFromObjState( tlObjState *state, unsigned int vertex_f
 		trimesh->objects[i].face_count = tlObjObjectFaceCount( state, i );
 	}
 
-	/* materials */
+	/* materials, those of the libraries come last and keep their names */
 	trimesh->material_count = tlObjMaterialCount( state );
 	trimesh->materials = malloc( sizeof(tlMaterial) * trimesh->material_count );
+
+	own_material_count = trimesh->material_count;
+	trimesh->material_library_count = tlObjAdoptedCount( state );
+	if( trimesh->material_library_count > 0 )
+		trimesh->material_libraries = malloc( sizeof(tlMtlState *) * trimesh->material_library_count );
+
+	for( i = 0; i < trimesh->material_library_count; i++ )
+	{
+		tlMtlState *library = tlObjAdoptedMaterials( state, i );
+
+		tlMtlRetainState( library );
+		trimesh->material_libraries[i] = library;
+		own_material_count -= tlMtlMaterialCount( library );
+	}
+
 	for( i = 0; i < trimesh->material_count; i++ )
 	{
-		size_t length = strlen( tlObjMaterialName( state, i ) ) + 1;
-		trimesh->materials[i].name = malloc( length );
-		memcpy( trimesh->materials[i].name, tlObjMaterialName( state, i ), length );
+		if( i < own_material_count )
+		{
+			size_t length = strlen( tlObjMaterialName( state, i ) ) + 1;
+			trimesh->materials[i].name = malloc( length );
+			memcpy( trimesh->materials[i].name, tlObjMaterialName( state, i ), length );
+		}
+		else
+			trimesh->materials[i].name = (char *)tlObjMaterialName( state, i );
+
 		tlObjGetMaterial( state, i,
 	                         trimesh->materials[i].ambient,
 	                         trimesh->materials[i].diffuse,
@@ -222,11 +534,11 @@ tlTrimesh *tlCreateTrimeshFromObjState( tlObjState *state, unsigned int vertex_f
 
 
 	trimesh->face_count = tlObjFaceCount( state );
-	trimesh->faces = malloc( sizeof(unsigned short) * trimesh->face_count * 3 );
+	trimesh->faces = malloc( sizeof(unsigned int) * trimesh->face_count * 3 );
 	for( i = 0; i < trimesh->face_count; i++ )
 	{
-		unsigned int offset = i * 3;
-		tlObjGetFace( state, i,
+		size_t offset = i * 3;
+		tlObjGetFaceInt( state, i,
 			&trimesh->faces[offset],
 			&trimesh->faces[offset + 1],
 			&trimesh->faces[offset + 2] );
@@ -280,10 +592,10 @@ static char *get_dirname( const char *filename )
 	/* find last sperator */
 	separator = strrchr( filename, PATH_SEPARATOR );
 
-	/* copy dirname */
+	/* copy dirname, including the separator */
     if( separator && (*separator == PATH_SEPARATOR) )
 	{
-		size_t length = (separator - filename);
+		size_t length = (separator - filename) + 1;
 		dirname = malloc( length + 1 );
 		strncpy( dirname, filename, length );
 		dirname[length] = 0;
@@ -299,98 +611,710 @@ static char *get_dirname( const char *filename )
 
 
 /*----------------------------------------------------------------------------*/
-static int parse_obj_file( tlObjState *state, const char *filename )
+/* a material library, opened and parsed on a thread of its own */
+typedef struct obj_library
+{
+	char *path;
+	tlOpenFunction open;
+	void *open_data;
+	tlMaterialCache *cache;
+	tlMtlState *materials;
+	tl_thread *thread;
+} obj_library;
+
+
+/*----------------------------------------------------------------------------*/
+/* the material libraries of an OBJ file, started while it is parsed */
+typedef struct obj_libraries
+{
+	char *dirname;
+	size_t dirname_length;
+	tlOpenFunction open;
+	void *open_data;
+
+	obj_library **libraries;
+	size_t size;
+	size_t count;
+
+	/* libraries before this are done, at most thread_count run at once */
+	size_t joined;
+	unsigned int thread_count;
+
+	tlMaterialCache *cache;
+} obj_libraries;
+
+
+/*----------------------------------------------------------------------------*/
+/* a cached library, materials is NULL while it is loaded */
+typedef struct material_cache_entry
+{
+	char *path;
+
+	/* open and open_data are only compared for other readers than
+	 * tlReaderOpen and tlReaderOpenMap, path is not resolved for them */
+	int file_system;
+	time_t modified;
+	size_t size;
+	tlOpenFunction open;
+	void *open_data;
+
+	tlMtlState *materials;
+} material_cache_entry;
+
+
+/*----------------------------------------------------------------------------*/
+struct tlMaterialCache
+{
+	tl_mutex *lock;
+
+	/* signaled when a library finished loading */
+	tl_condition *loaded;
+
+	material_cache_entry **entries;
+	size_t size;
+	size_t count;
+};
+
+
+/* used by all loaders, see tlSetMaterialCache */
+static tlMaterialCache *material_cache = NULL;
+
+
+/*----------------------------------------------------------------------------*/
+/* parses compressed files as well, the reader is not closed */
+static int parse_mtl_reader( tlMtlState *state, tlReader *reader )
+{
+	tlReader borrowed, input;
+	char *buffer = NULL;
+	const char *data = NULL;
+	size_t size = 0;
+
+	borrowed = *reader;
+	borrowed.close = NULL;
+
+	if( tlReaderDecompress( &input, &borrowed ) != 0 )
+		return 1;
+
+	data = reader_map( &input, &size );
+	if( data != NULL )
+	{
+		tlMtlParse( state, data, size, 1 );
+		tlReaderClose( &input );
+
+		return 0;
+	}
+
+	buffer = malloc( LOAD_BUFFER_SIZE );
+	if( buffer == NULL )
+	{
+		tlReaderClose( &input );
+		return 1;
+	}
+
+	do
+	{
+		size = input.read( input.user_data, buffer, LOAD_BUFFER_SIZE );
+		tlMtlParse( state, buffer, size, size < LOAD_BUFFER_SIZE ? 1 : 0 );
+	}
+	while( size == LOAD_BUFFER_SIZE );
+
+	free( buffer );
+	tlReaderClose( &input );
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* NULL if the file can not be opened */
+static tlMtlState *load_mtl_file( const char *path, tlOpenFunction open, void *open_data )
+{
+	tlMtlState *materials;
+	tlReader reader;
+
+	if( open( open_data, path, &reader ) != 0 )
+		return NULL;
+
+	materials = tlMtlCreateState();
+	if( materials != NULL )
+		parse_mtl_reader( materials, &reader );
+
+	tlReaderClose( &reader );
+
+	return materials;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* absolute path without links if possible, the name itself otherwise */
+static char *material_cache_resolve( const char *path, int file_system )
+{
+	char *resolved = NULL;
+
+#if defined(WIN32)
+	if( file_system )
+		resolved = _fullpath( NULL, path, 0 );
+#elif defined(HAVE_REALPATH)
+	if( file_system )
+		resolved = realpath( path, NULL );
+#else
+	(void)file_system;
+#endif
+
+	if( resolved == NULL )
+	{
+		resolved = malloc( strlen( path ) + 1 );
+		if( resolved != NULL )
+			strcpy( resolved, path );
+	}
+
+	return resolved;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* 0 if the file is on disk, with its modification time and size */
+static int material_cache_stat( const char *path, time_t *modified, size_t *size )
+{
+#if defined(WIN32)
+	struct _stat status;
+
+	if( _stat( path, &status ) != 0 )
+		return 1;
+#elif defined(HAVE_SYS_STAT_H)
+	struct stat status;
+
+	if( stat( path, &status ) != 0 )
+		return 1;
+#else
+	(void)path;
+	(void)modified;
+	(void)size;
+	return 1;
+#endif
+
+#if defined(WIN32) || defined(HAVE_SYS_STAT_H)
+	*modified = status.st_mtime;
+	*size = (size_t)status.st_size;
+
+	return 0;
+#endif
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the entry for path, lock has to be held */
+static size_t material_cache_find(
+	tlMaterialCache *cache,
+	const char *path,
+	int file_system,
+	tlOpenFunction open,
+	void *open_data )
 {
-	FILE *file = fopen( filename, "r" );
-	if( file )
+	size_t i;
+
+	for( i = 0; i < cache->count; i++ )
 	{
-		char buffer[1024];
-		unsigned int size = 0;
+		material_cache_entry *entry = cache->entries[i];
+
+		if( entry->file_system != file_system || strcmp( entry->path, path ) != 0 )
+			continue;
+
+		if( file_system || (entry->open == open && entry->open_data == open_data) )
+			return i;
+	}
+
+	return cache->count;
+}
+
 
-		while( !feof( file ) )
+/*----------------------------------------------------------------------------*/
+/* lock has to be held */
+static void material_cache_remove( tlMaterialCache *cache, size_t index )
+{
+	material_cache_entry *entry = cache->entries[index];
+
+	tlMtlDestroyState( entry->materials );
+	free( entry->path );
+	free( entry );
+
+	cache->entries[index] = cache->entries[--cache->count];
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* a reference to the parsed library, loading it only if no other thread did */
+static tlMtlState *material_cache_load(
+	tlMaterialCache *cache,
+	const char *path,
+	tlOpenFunction open,
+	void *open_data )
+{
+	material_cache_entry *entry = NULL;
+	tlMtlState *materials = NULL;
+	time_t modified = 0;
+	size_t size = 0, index;
+	char *resolved;
+	int file_system;
+
+	/* stat only describes what the file system readers open, other
+	 * readers may return anything for path and are told apart by open
+	 * and open_data, the file on disk only tells when to reload */
+	file_system = open == tlReaderOpen || open == tlReaderOpenMap;
+
+	resolved = material_cache_resolve( path, file_system );
+	if( resolved == NULL )
+		return load_mtl_file( path, open, open_data );
+
+	/* both stay 0 if there is no such file */
+	material_cache_stat( resolved, &modified, &size );
+
+	tl_mutex_lock( cache->lock );
+
+	for( ;; )
+	{
+		index = material_cache_find( cache, resolved, file_system, open, open_data );
+		if( index == cache->count )
+			break;
+
+		entry = cache->entries[index];
+
+		/* another thread loads it right now */
+		if( entry->materials == NULL )
 		{
-			size = (unsigned int)fread( buffer, 1, sizeof(buffer), file );
-			tlObjParse( state, buffer, size, size < sizeof(buffer) ? 1 : 0 );
+			tl_condition_wait( cache->loaded, cache->lock );
+			continue;
 		}
 
-		fclose( file );
+		if( entry->modified == modified && entry->size == size )
+		{
+			materials = entry->materials;
+			tlMtlRetainState( materials );
 
-		return 0;
+			tl_mutex_unlock( cache->lock );
+			free( resolved );
+
+			return materials;
+		}
+
+		/* changed on disk, trimeshes using the old one keep it */
+		material_cache_remove( cache, index );
+	}
+
+	entry = NULL;
+	if( cache->count == cache->size )
+	{
+		size_t new_size = cache->size ? cache->size * 2 : 16;
+		material_cache_entry **entries = realloc( cache->entries,
+			new_size * sizeof(material_cache_entry *) );
+
+		if( entries != NULL )
+		{
+			cache->entries = entries;
+			cache->size = new_size;
+		}
+	}
+
+	if( cache->count < cache->size )
+		entry = malloc( sizeof(material_cache_entry) );
+
+	if( entry != NULL )
+	{
+		memset( entry, 0, sizeof(material_cache_entry) );
+		entry->path = resolved;
+		entry->file_system = file_system;
+		entry->modified = modified;
+		entry->size = size;
+		entry->open = open;
+		entry->open_data = open_data;
+		cache->entries[cache->count++] = entry;
+	}
+
+	tl_mutex_unlock( cache->lock );
+
+	/* parse it unlocked, without an entry it is just not cached */
+	materials = load_mtl_file( path, open, open_data );
+	if( entry == NULL )
+	{
+		free( resolved );
+		return materials;
+	}
+
+	tl_mutex_lock( cache->lock );
+
+	index = 0;
+	while( cache->entries[index] != entry )
+		index++;
+
+	if( materials != NULL )
+	{
+		tlMtlRetainState( materials );
+		entry->materials = materials;
 	}
 	else
-		return 1;
+		material_cache_remove( cache, index );
+
+	tl_condition_broadcast( cache->loaded );
+	tl_mutex_unlock( cache->lock );
+
+	return materials;
 }
 
 
 /*----------------------------------------------------------------------------*/
-tlTrimesh *tlLoadOBJ( const char *filename, unsigned int vertex_format )
+tlMaterialCache *tlMaterialCacheCreate( void )
 {
-	tlTrimesh *trimesh = NULL;
-	tlObjState *state = NULL;
-	char *dirname = NULL;
-	size_t dirname_length = 0;
+	tlMaterialCache *cache = malloc( sizeof(tlMaterialCache) );
 
-	if( filename == NULL )
+	if( cache == NULL )
 		return NULL;
 
-	dirname = get_dirname( filename );
-	dirname_length = strlen( dirname );
+	memset( cache, 0, sizeof(tlMaterialCache) );
+	cache->lock = tl_mutex_create();
+	cache->loaded = tl_condition_create();
 
-	state = tlObjCreateState();
-	if( state )
+	/* without them loads would race and waits would spin */
+	if( tl_thread_supported() && (cache->lock == NULL || cache->loaded == NULL) )
+	{
+		tl_condition_destroy( cache->loaded );
+		tl_mutex_destroy( cache->lock );
+		free( cache );
+		return NULL;
+	}
+
+	return cache;
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tlMaterialCacheDestroy( tlMaterialCache *cache )
+{
+	if( cache == NULL )
+		return;
+
+	while( cache->count > 0 )
+		material_cache_remove( cache, cache->count - 1 );
+
+	free( cache->entries );
+	tl_condition_destroy( cache->loaded );
+	tl_mutex_destroy( cache->lock );
+	free( cache );
+}
+
+
+/*----------------------------------------------------------------------------*/
+void tlSetMaterialCache( tlMaterialCache *cache )
+{
+	material_cache = cache;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void obj_library_load( void *data )
+{
+	obj_library *library = (obj_library *)data;
+
+	if( library->cache != NULL )
+		library->materials = material_cache_load( library->cache,
+			library->path, library->open, library->open_data );
+	else
+		library->materials = load_mtl_file( library->path,
+			library->open, library->open_data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* starts the libraries the state found since the last call */
+static void obj_libraries_start( obj_libraries *libraries, tlObjState *state )
+{
+	size_t count = tlObjMaterialLibCount( state );
+
+	while( libraries->count < count )
 	{
-		unsigned int mtlcount = 0, i;
+		const char *libname = tlObjMaterialLibName( state, libraries->count );
+		size_t path_length = libraries->dirname_length + strlen( libname );
+		obj_library *library;
 
-		if (parse_obj_file( state, filename ) == 1)
+		if( libraries->count == libraries->size )
 		{
-			tlObjDestroyState( state );
-			free( dirname );
-			return NULL;
+			size_t size = libraries->size ? libraries->size * 2 : 8;
+			obj_library **buffer = realloc( libraries->libraries, size * sizeof(obj_library *) );
+
+			if( buffer == NULL )
+				return;
+
+			libraries->libraries = buffer;
+			libraries->size = size;
 		}
 
-		mtlcount = tlObjMaterialLibCount( state );
-		for( i = 0; i  < mtlcount; i++ )
+		library = malloc( sizeof(obj_library) );
+		if( library == NULL )
+			return;
+
+		memset( library, 0, sizeof(obj_library) );
+		library->open = libraries->open;
+		library->open_data = libraries->open_data;
+		library->cache = libraries->cache;
+		library->path = malloc( path_length + 1 );
+		if( library->path == NULL )
 		{
-			const char *libname = tlObjMaterialLibName( state, i );
-			size_t path_length = dirname_length + strlen( libname );
-			char *path = malloc( path_length + 1 );
-			strcpy( path, dirname );
-			strcpy( path + dirname_length, libname );
+			free( library );
+			return;
+		}
+
+		strcpy( library->path, libraries->dirname );
+		strcpy( library->path + libraries->dirname_length, libname );
 
-			parse_obj_file( state, path );
+		libraries->libraries[libraries->count++] = library;
 
-			free( path );
+		/* wait for the oldest library when all threads are busy */
+		if( libraries->count - libraries->joined > libraries->thread_count )
+		{
+			tl_thread_join( libraries->libraries[libraries->joined]->thread );
+			libraries->libraries[libraries->joined]->thread = NULL;
+			libraries->joined++;
 		}
 
-		trimesh = tlCreateTrimeshFromObjState( state, vertex_format );
-		tlObjDestroyState( state );
+		library->thread = tl_thread_start( obj_library_load, library );
+		if( library->thread == NULL )
+			obj_library_load( library );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* waits for all libraries and adopts their materials in file order */
+static void obj_libraries_finish( obj_libraries *libraries, tlObjState *state )
+{
+	size_t i;
+
+	for( i = 0; i < libraries->count; i++ )
+	{
+		obj_library *library = libraries->libraries[i];
+
+		if( library->thread != NULL )
+			tl_thread_join( library->thread );
+
+		if( library->materials != NULL
+			&& tlObjAdoptMaterials( state, library->materials ) != 0 )
+			tlMtlDestroyState( library->materials );
+
+		free( library->path );
+		free( library );
+	}
+
+	free( libraries->libraries );
+	free( libraries->dirname );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int parse_obj_input( tlObjState *state, tlReader *reader, obj_libraries *libraries )
+{
+	char *buffer = NULL;
+	const char *data = NULL;
+	size_t size = 0;
+	size_t file_size = 0;
+	int sampled = 0;
+
+	/* parse in place what is in memory already */
+	data = reader_map( reader, &size );
+	if( data != NULL )
+	{
+		tlObjReserveEstimate( state, data, size, size );
+
+		/* mtllib usually comes first, start the libraries early */
+		if( libraries != NULL && size > LOAD_BUFFER_SIZE )
+		{
+			tlObjParse( state, data, LOAD_BUFFER_SIZE, 0 );
+			obj_libraries_start( libraries, state );
+
+			data += LOAD_BUFFER_SIZE;
+			size -= LOAD_BUFFER_SIZE;
+		}
+
+		tlObjParse( state, data, size, 1 );
+
+		if( libraries != NULL )
+			obj_libraries_start( libraries, state );
+
+		return 0;
+	}
+
+	file_size = reader_size( reader );
+
+	buffer = malloc( LOAD_BUFFER_SIZE );
+	if( buffer == NULL )
+		return 1;
+
+	/* reserve from a sample of the file, material libraries add nothing */
+	if( file_size > 0 )
+	{
+		size = read_file_sample( reader, file_size, buffer, LOAD_SAMPLE_SIZE );
+		if( size > 0 )
+		{
+			tlObjReserveEstimate( state, buffer, size, file_size );
+			sampled = 1;
+		}
+	}
+
+	do
+	{
+		size = reader->read( reader->user_data, buffer, LOAD_BUFFER_SIZE );
+
+		/* without seeking the first block has to do as the sample */
+		if( !sampled && file_size > 0 )
+			tlObjReserveEstimate( state, buffer, size, file_size );
+		sampled = 1;
+
+		tlObjParse( state, buffer, size, size < LOAD_BUFFER_SIZE ? 1 : 0 );
+
+		if( libraries != NULL )
+			obj_libraries_start( libraries, state );
+	}
+	while( size == LOAD_BUFFER_SIZE );
+
+	free( buffer );
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* parses compressed files as well, the reader is not closed */
+static int parse_obj_reader( tlObjState *state, tlReader *reader, obj_libraries *libraries )
+{
+	tlReader borrowed, input;
+	int result;
+
+	borrowed = *reader;
+	borrowed.close = NULL;
+
+	if( tlReaderDecompress( &input, &borrowed ) != 0 )
+		return 1;
 
+	result = parse_obj_input( state, &input, libraries );
+
+	tlReaderClose( &input );
+
+	return result;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoadOBJReader(
+	tlReader *reader,
+	const char *filename,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format )
+{
+	tlTrimesh *trimesh = NULL;
+	tlObjState *state = NULL;
+	obj_libraries libraries;
+	int result;
+
+	if( reader == NULL || reader->read == NULL )
+		return NULL;
+
+	/* the trimesh holds floats, no need to parse doubles */
+	state = tlObjCreateStateEx( TL_OBJ_SINGLE_PRECISION );
+	if( state == NULL )
+		return NULL;
+
+	/* material libraries are relative to the file */
+	memset( &libraries, 0, sizeof(obj_libraries) );
+	if( open != NULL )
+	{
+		libraries.dirname = get_dirname( filename != NULL ? filename : "" );
+		libraries.dirname_length = strlen( libraries.dirname );
+		libraries.open = open;
+		libraries.open_data = open_data;
+		libraries.thread_count = tl_thread_cpu_count();
+		libraries.cache = material_cache;
 	}
 
-	free( dirname );
+	result = parse_obj_reader( state, reader, open != NULL ? &libraries : NULL );
+
+	/* the libraries were parsed meanwhile */
+	obj_libraries_finish( &libraries, state );
+
+	if( result == 1 )
+	{
+		tlObjDestroyState( state );
+		return NULL;
+	}
+
+	trimesh = tlCreateTrimeshFromObjState( state, vertex_format );
+	tlObjDestroyState( state );
 
 	return trimesh;
 }
 
 
 /*----------------------------------------------------------------------------*/
-tlTrimesh *tlLoadTrimesh( const char* filename, unsigned int vertex_format )
+static tlTrimesh *load_obj_file(
+	const char *filename,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format )
+{
+	tlTrimesh *trimesh = NULL;
+	tlReader reader;
+
+	if( filename == NULL )
+		return NULL;
+
+	if( open( open_data, filename, &reader ) != 0 )
+		return NULL;
+
+	trimesh = tlLoadOBJReader( &reader, filename, open, open_data, vertex_format );
+
+	tlReaderClose( &reader );
+
+	return trimesh;
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoadOBJ( const char *filename, unsigned int vertex_format )
+{
+	return load_obj_file( filename, tlReaderOpen, NULL, vertex_format );
+}
+
+
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoadTrimeshEx(
+	const char *filename,
+	tlOpenFunction open,
+	void *open_data,
+	unsigned int vertex_format )
 {
 	tlTrimesh *trimesh = NULL;
 
+	if( open == NULL )
+		return NULL;
+
 	if( tl3dsCheckFileExtension( filename ) == 0 )
-		trimesh = tlLoad3DS( filename, vertex_format );
+		trimesh = load_3ds_file( filename, open, open_data, vertex_format );
 	else if( tlObjCheckFileExtension( filename ) == 0 )
-		trimesh = tlLoadOBJ( filename, vertex_format );
+		trimesh = load_obj_file( filename, open, open_data, vertex_format );
 
 	return trimesh;
 }
 
 
+/*----------------------------------------------------------------------------*/
+tlTrimesh *tlLoadTrimesh( const char* filename, unsigned int vertex_format )
+{
+	return tlLoadTrimeshEx( filename, tlReaderOpen, NULL, vertex_format );
+}
+
+
 /*----------------------------------------------------------------------------*/
 void tlDeleteTrimesh( tlTrimesh *trimesh )
 {
-	unsigned int i = 0;
+	size_t i = 0;
 
 	if( trimesh == NULL )
 		return;
@@ -398,6 +1322,10 @@ void tlDeleteTrimesh( tlTrimesh *trimesh )
 	for( i = 0; i < trimesh->object_count; i++ )
 		free( trimesh->objects[i].name );
 
+	for( i = 0; i < trimesh->material_library_count; i++ )
+		tlMtlDestroyState( trimesh->material_libraries[i] );
+
+	free( trimesh->material_libraries );
 	free( trimesh->objects );
 	free( trimesh->faces );
 	free( trimesh->vertices );
@@ -1,4 +1,4 @@
-char test3ds[] = 
+unsigned char test3ds[] = 
 {
 
 0x4d, 0x4d, 0x77, 0x01, 0x00, 0x00, 0x02, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 
@@ -1,16 +1,889 @@
-#include "tlobj.h"
-#include "tl3ds.h"
+#include "trimeshloader.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-int main( int argc, char **argv )
+#include "test.obj.h"
+#include "test.3ds.h"
+
+/* test.obj with the material library it names */
+#define TEST_OBJ_FILE "test_load.obj"
+#define TEST_MTL_FILE "medium_transport_1.mtl"
+#define TEST_MATERIAL "Material_medium_transport_diff"
+#define TEST_3DS_FILE "test_load.3ds"
+#define TEST_LARGE_FILE "test_large.obj"
+
+/* more vertices than unsigned short indices can hold */
+#define TEST_LARGE_TRIANGLES 23334
+#define TEST_SKIP_FILE "test_skip.3ds"
+
+static const char testmtl[] =
+	"newmtl " TEST_MATERIAL "\n"
+	"Ka 0.1 0.1 0.1\n"
+	"Kd 0.5 0.25 0.125\n"
+	"Ks 0 0 0\n"
+	"Ns 32\n";
+
+/* what open_other_mtl returns for the library instead */
+static const char othermtl[] =
+	"newmtl " TEST_MATERIAL "\n"
+	"Kd 0.5 0.75 0.125\n";
+
+static int failures = 0;
+
+/*----------------------------------------------------------------------------*/
+static void check( int condition, const char *what )
+{
+	if( !condition )
+	{
+		printf( "FAILED: %s\n", what );
+		failures++;
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* compares everything a trimesh is built from */
+static void check_obj_states( tlObjState *a, tlObjState *b, const char *what )
+{
+	size_t i, count;
+	int same = 1;
+
+	count = tlObjVertexCount( a );
+	if( count != tlObjVertexCount( b ) || count == 0 )
+		same = 0;
+
+	for( i = 0; same && i < count; i++ )
+	{
+		float va[8], vb[8];
+
+		memset( va, 0, sizeof(va) );
+		memset( vb, 0, sizeof(vb) );
+		tlObjGetVertex( a, i, &va[0], &va[1], &va[2], &va[3], &va[4], &va[5], &va[6], &va[7] );
+		tlObjGetVertex( b, i, &vb[0], &vb[1], &vb[2], &vb[3], &vb[4], &vb[5], &vb[6], &vb[7] );
+		if( memcmp( va, vb, sizeof(va) ) != 0 )
+			same = 0;
+	}
+
+	count = tlObjFaceCount( a );
+	if( count != tlObjFaceCount( b ) || count == 0 )
+		same = 0;
+
+	for( i = 0; same && i < count; i++ )
+	{
+		unsigned int fa[3], fb[3];
+
+		tlObjGetFaceInt( a, i, &fa[0], &fa[1], &fa[2] );
+		tlObjGetFaceInt( b, i, &fb[0], &fb[1], &fb[2] );
+		if( memcmp( fa, fb, sizeof(fa) ) != 0 )
+			same = 0;
+	}
+
+	count = tlObjObjectCount( a );
+	if( count != tlObjObjectCount( b ) )
+		same = 0;
+
+	for( i = 0; same && i < count; i++ )
+	{
+		if( strcmp( tlObjObjectName( a, i ), tlObjObjectName( b, i ) ) != 0
+			|| tlObjObjectFaceIndex( a, i ) != tlObjObjectFaceIndex( b, i )
+			|| tlObjObjectFaceCount( a, i ) != tlObjObjectFaceCount( b, i ) )
+			same = 0;
+	}
+
+	count = tlObjMaterialReferenceCount( a );
+	if( count != tlObjMaterialReferenceCount( b ) )
+		same = 0;
+
+	for( i = 0; same && i < count; i++ )
+	{
+		size_t index_a = 0, count_a = 0, index_b = 0, count_b = 0;
+
+		tlObjGetMaterialReference( a, i, &index_a, &count_a );
+		tlObjGetMaterialReference( b, i, &index_b, &count_b );
+		if( strcmp( tlObjMaterialReferenceName( a, i ), tlObjMaterialReferenceName( b, i ) ) != 0
+			|| index_a != index_b || count_a != count_b )
+			same = 0;
+	}
+
+	check( same, what );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void test_obj_parallel( void )
+{
+	tlObjState *serial = tlObjCreateState();
+	tlObjState *parallel = tlObjCreateState();
+	unsigned int threads;
+
+	check( serial && parallel, "tlObjCreateState" );
+	if( serial == NULL || parallel == NULL )
+		return;
+
+	check( tlObjParse( serial, testobj, sizeof(testobj), 1 ) == 0, "tlObjParse" );
+
+	/* far below the piece size of a thread, this takes the serial path */
+	for( threads = 1; threads <= 64; threads *= 4 )
+	{
+		tlObjResetState( parallel );
+		check( tlObjParseParallel( parallel, testobj, sizeof(testobj), threads ) == 0,
+			"tlObjParseParallel" );
+		check_obj_states( serial, parallel, "tlObjParseParallel matches tlObjParse" );
+	}
+
+	tlObjDestroyState( parallel );
+	tlObjDestroyState( serial );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static int write_file( const char *filename, const char *data, size_t length )
+{
+	FILE *f = fopen( filename, "wb" );
+	size_t written;
+
+	if( f == NULL )
+		return 1;
+
+	written = fwrite( data, 1, length, f );
+	fclose( f );
+
+	return written == length ? 0 : 1;
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void check_trimeshes( tlTrimesh *a, tlTrimesh *b, const char *what )
+{
+	size_t i;
+	int same = a != NULL && b != NULL;
+
+	if( same && (a->vertex_count != b->vertex_count || a->vertex_size != b->vertex_size
+		|| a->face_count != b->face_count || a->object_count != b->object_count
+		|| a->material_count != b->material_count
+		|| a->material_reference_count != b->material_reference_count) )
+		same = 0;
+
+	if( same && (memcmp( a->vertices, b->vertices, a->vertex_count * a->vertex_size ) != 0
+		|| memcmp( a->faces, b->faces, a->face_count * 3 * sizeof(unsigned int) ) != 0) )
+		same = 0;
+
+	for( i = 0; same && i < a->object_count; i++ )
+	{
+		if( strcmp( a->objects[i].name, b->objects[i].name ) != 0
+			|| a->objects[i].face_index != b->objects[i].face_index
+			|| a->objects[i].face_count != b->objects[i].face_count )
+			same = 0;
+	}
+
+	for( i = 0; same && i < a->material_count; i++ )
+	{
+		if( strcmp( a->materials[i].name, b->materials[i].name ) != 0
+			|| memcmp( a->materials[i].diffuse, b->materials[i].diffuse, sizeof(float) * 4 ) != 0
+			|| a->materials[i].shininess != b->materials[i].shininess )
+			same = 0;
+	}
+
+	for( i = 0; same && i < a->material_reference_count; i++ )
+	{
+		if( strcmp( a->material_references[i].name, b->material_references[i].name ) != 0
+			|| a->material_references[i].face_index != b->material_references[i].face_index
+			|| a->material_references[i].face_count != b->material_references[i].face_count )
+			same = 0;
+	}
+
+	check( same, what );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the diffuse green of TEST_MATERIAL, -1 if it is missing */
+static float material_diffuse_green( tlTrimesh *trimesh )
+{
+	size_t i;
+
+	for( i = 0; trimesh != NULL && i < trimesh->material_count; i++ )
+	{
+		if( strcmp( trimesh->materials[i].name, TEST_MATERIAL ) == 0 )
+			return trimesh->materials[i].diffuse[1];
+	}
+
+	return -1.0f;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* a tlOpenFunction with a different library under the same name */
+static int open_other_mtl( void *open_data, const char *filename, tlReader *reader )
+{
+	if( strcmp( filename, TEST_MTL_FILE ) == 0 )
+		return tlReaderOpenMemory( reader, othermtl, sizeof(othermtl) - 1 );
+
+	return tlReaderOpen( open_data, filename, reader );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* loads through an installed cache must match uncached loads */
+static void test_material_cache( tlTrimesh *reference )
+{
+	tlMaterialCache *cache = tlMaterialCacheCreate();
+	tlTrimesh *first, *second, *other;
+
+	check( cache != NULL, "tlMaterialCacheCreate" );
+	if( cache == NULL )
+		return;
+
+	tlSetMaterialCache( cache );
+	first = tlLoadTrimesh( TEST_OBJ_FILE, TL_FVF_XYZ | TL_FVF_UV );
+	second = tlLoadTrimesh( TEST_OBJ_FILE, TL_FVF_XYZ | TL_FVF_UV );
+	other = tlLoadTrimeshEx( TEST_OBJ_FILE, open_other_mtl, NULL, TL_FVF_XYZ | TL_FVF_UV );
+	tlSetMaterialCache( NULL );
+
+	check_trimeshes( reference, first, "first cached load matches tlLoadTrimesh" );
+	check_trimeshes( reference, second, "second cached load matches tlLoadTrimesh" );
+
+	/* the second load takes the library parsed by the first */
+	check( first != NULL && second != NULL
+		&& first->material_library_count == 1 && second->material_library_count == 1
+		&& first->material_libraries[0] == second->material_libraries[0],
+		"cached loads share the material library" );
+
+	/* the file on disk is not what open_other_mtl returns */
+	check( material_diffuse_green( other ) == 0.75f, "cache keeps libraries of other open functions apart" );
+
+	/* the trimeshes keep the library, the cache can go first */
+	tlMaterialCacheDestroy( cache );
+	check( material_diffuse_green( second ) == 0.25f, "material outlives the cache" );
+
+	if( first )
+		tlDeleteTrimesh( first );
+
+	if( second )
+		tlDeleteTrimesh( second );
+
+	if( other )
+		tlDeleteTrimesh( other );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* the same file many times over and a missing one, with and without cache */
+static void test_batch( tlTrimesh *reference )
+{
+	const char *filenames[9];
+	tlTrimesh *trimeshes[9];
+	tlMaterialCache *cache;
+	size_t i, loaded;
+	int pass;
+
+	for( i = 0; i < 8; i++ )
+		filenames[i] = TEST_OBJ_FILE;
+
+	filenames[8] = "missing.obj";
+
+	for( pass = 0; pass < 2; pass++ )
+	{
+		cache = pass == 1 ? tlMaterialCacheCreate() : NULL;
+		tlSetMaterialCache( cache );
+		loaded = tlLoadTrimeshBatch( filenames, 9, trimeshes, NULL, NULL, TL_FVF_XYZ | TL_FVF_UV, 4 );
+		tlSetMaterialCache( NULL );
+
+		check( loaded == 8, "tlLoadTrimeshBatch loads every existing file" );
+		check( trimeshes[8] == NULL, "tlLoadTrimeshBatch returns NULL for a missing file" );
+
+		for( i = 0; i < 8; i++ )
+		{
+			check_trimeshes( reference, trimeshes[i], pass == 1
+				? "cached tlLoadTrimeshBatch matches tlLoadTrimesh"
+				: "tlLoadTrimeshBatch matches tlLoadTrimesh" );
+
+			if( trimeshes[i] )
+				tlDeleteTrimesh( trimeshes[i] );
+		}
+
+		tlMaterialCacheDestroy( cache );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* all objects by name have to give the whole file, unknown names nothing,
+ * test.3ds has no texture coordinates */
+static void test_3ds_objects( void )
+{
+	const char *unknown = "no such object";
+	const char **names;
+	tlTrimesh *reference, *trimesh;
+	size_t i;
+
+	if( write_file( TEST_3DS_FILE, (const char *)test3ds, sizeof(test3ds) ) )
+	{
+		check( 0, "writing the test files" );
+		return;
+	}
+
+	reference = tlLoad3DS( TEST_3DS_FILE, TL_FVF_XYZ );
+	check( reference != NULL && reference->object_count > 0, "tlLoad3DS" );
+
+	if( reference )
+	{
+		names = malloc( sizeof(const char *) * reference->object_count );
+		if( names )
+		{
+			for( i = 0; i < reference->object_count; i++ )
+				names[i] = reference->objects[i].name;
+
+			trimesh = tlLoad3DSObjects( TEST_3DS_FILE, names, reference->object_count,
+				TL_FVF_XYZ );
+			check_trimeshes( reference, trimesh, "tlLoad3DSObjects with every name matches tlLoad3DS" );
+
+			if( trimesh )
+				tlDeleteTrimesh( trimesh );
+
+			free( (void *)names );
+		}
+
+		tlDeleteTrimesh( reference );
+	}
+
+	trimesh = tlLoad3DSObjects( TEST_3DS_FILE, &unknown, 1, TL_FVF_XYZ );
+	check( trimesh == NULL, "tlLoad3DSObjects returns NULL for an unknown name" );
+
+	if( trimesh )
+		tlDeleteTrimesh( trimesh );
+
+	remove( TEST_3DS_FILE );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* a growing buffer to generate 3DS files in */
+typedef struct test_buffer
+{
+	unsigned char *data;
+	size_t length, size;
+} test_buffer;
+
+/*----------------------------------------------------------------------------*/
+static void put_bytes( test_buffer *buffer, const void *data, size_t length )
+{
+	if( buffer->length + length > buffer->size )
+	{
+		size_t size = buffer->size > 0 ? buffer->size : 1024;
+		unsigned char *grown;
+
+		while( size < buffer->length + length )
+			size *= 2;
+
+		grown = realloc( buffer->data, size );
+		if( grown == NULL )
+		{
+			check( 0, "growing the test buffer" );
+			return;
+		}
+
+		buffer->data = grown;
+		buffer->size = size;
+	}
+
+	memcpy( buffer->data + buffer->length, data, length );
+	buffer->length += length;
+}
+
+/*----------------------------------------------------------------------------*/
+static void put_u16( test_buffer *buffer, unsigned int value )
+{
+	unsigned char bytes[2];
+
+	bytes[0] = (unsigned char)(value & 0xff);
+	bytes[1] = (unsigned char)((value >> 8) & 0xff);
+	put_bytes( buffer, bytes, 2 );
+}
+
+/*----------------------------------------------------------------------------*/
+static void put_u32( test_buffer *buffer, unsigned long value )
+{
+	put_u16( buffer, (unsigned int)(value & 0xffff) );
+	put_u16( buffer, (unsigned int)((value >> 16) & 0xffff) );
+}
+
+/*----------------------------------------------------------------------------*/
+static void put_float( test_buffer *buffer, float value )
+{
+	unsigned int bits;
+
+	memcpy( &bits, &value, 4 );
+	put_u32( buffer, bits );
+}
+
+/*----------------------------------------------------------------------------*/
+/* chunk header with the length patched in by end_chunk */
+static size_t begin_chunk( test_buffer *buffer, unsigned int id )
+{
+	size_t start = buffer->length;
+
+	put_u16( buffer, id );
+	put_u32( buffer, 0 );
+
+	return start;
+}
+
+/*----------------------------------------------------------------------------*/
+static void end_chunk( test_buffer *buffer, size_t start )
+{
+	size_t length = buffer->length - start, i;
+
+	if( buffer->data == NULL )
+		return;
+
+	for( i = 0; i < 4; i++ )
+		buffer->data[start + 2 + i] = (unsigned char)((length >> (i * 8)) & 0xff);
+}
+
+/*----------------------------------------------------------------------------*/
+/* objects of separate triangles, vertex i of the file is at (i, 0, 0)
+ * with texture coordinates (i / 2, -i), with keyframer bytes of animation
+ * data between the first and the second half of the objects */
+static void generate_3ds( test_buffer *buffer, size_t objects, size_t triangles, size_t keyframer )
+{
+	size_t main_chunk, editor, object, mesh, array, i, j, first = 0;
+	unsigned char filler[256];
+	char name[32];
+
+	main_chunk = begin_chunk( buffer, 0x4d4d );
+	editor = begin_chunk( buffer, 0x3d3d );
+
+	for( i = 0; i < objects; i++ )
+	{
+		if( keyframer > 0 && i == objects / 2 )
+		{
+			end_chunk( buffer, editor );
+
+			/* bytes that break the parser if it does not skip them all */
+			for( j = 0; j < sizeof(filler); j++ )
+				filler[j] = (unsigned char)(j % 2 ? 0x3d : 0x4d);
+
+			array = begin_chunk( buffer, 0xb000 );
+			for( j = 0; j < keyframer; j += sizeof(filler) )
+				put_bytes( buffer, filler,
+					keyframer - j < sizeof(filler) ? keyframer - j : sizeof(filler) );
+			end_chunk( buffer, array );
+
+			editor = begin_chunk( buffer, 0x3d3d );
+		}
+
+		object = begin_chunk( buffer, 0x4000 );
+		sprintf( name, "object%lu", (unsigned long)i );
+		put_bytes( buffer, name, strlen( name ) + 1 );
+		mesh = begin_chunk( buffer, 0x4100 );
+
+		array = begin_chunk( buffer, 0x4110 );
+		put_u16( buffer, (unsigned int)(triangles * 3) );
+		for( j = 0; j < triangles * 3; j++ )
+		{
+			put_float( buffer, (float)(first + j) );
+			put_float( buffer, 0.0f );
+			put_float( buffer, 0.0f );
+		}
+		end_chunk( buffer, array );
+
+		array = begin_chunk( buffer, 0x4140 );
+		put_u16( buffer, (unsigned int)(triangles * 3) );
+		for( j = 0; j < triangles * 3; j++ )
+		{
+			put_float( buffer, (float)(first + j) * 0.5f );
+			put_float( buffer, -(float)(first + j) );
+		}
+		end_chunk( buffer, array );
+
+		array = begin_chunk( buffer, 0x4120 );
+		put_u16( buffer, (unsigned int)triangles );
+		for( j = 0; j < triangles; j++ )
+		{
+			put_u16( buffer, (unsigned int)(j * 3) );
+			put_u16( buffer, (unsigned int)(j * 3 + 1) );
+			put_u16( buffer, (unsigned int)(j * 3 + 2) );
+			put_u16( buffer, 0 );
+		}
+		end_chunk( buffer, array );
+
+		end_chunk( buffer, mesh );
+		end_chunk( buffer, object );
+		first += triangles * 3;
+	}
+
+	end_chunk( buffer, editor );
+	end_chunk( buffer, main_chunk );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* tl3dsParse called for every step bytes of data, all at once for 0 */
+static tlTrimesh *parse_3ds_pieces( const unsigned char *data, size_t length, size_t step,
+	unsigned int vertex_format )
+{
+	tl3dsState *state = tl3dsCreateState();
+	tlTrimesh *trimesh = NULL;
+	size_t offset, piece;
+	int result = 0;
+
+	if( state == NULL )
+		return NULL;
+
+	if( step == 0 )
+		step = length;
+
+	for( offset = 0; result == 0 && offset < length; offset += piece )
+	{
+		piece = length - offset < step ? length - offset : step;
+		result = tl3dsParse( state, (const char *)data + offset, piece, offset + piece == length );
+	}
+
+	if( result == 0 )
+		trimesh = tlCreateTrimeshFrom3dsState( state, vertex_format );
+
+	tl3dsDestroyState( state );
+
+	return trimesh;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* arrays split across tl3dsParse calls take the byte by byte path, whole
+ * ones in a single buffer are decoded at once, both have to agree */
+static void test_3ds_pieces( void )
+{
+	static const size_t steps[] = { 1, 3, 7 };
+	test_buffer buffer;
+	tlTrimesh *whole, *generated, *pieces;
+	size_t i;
+
+	memset( &buffer, 0, sizeof(buffer) );
+	generate_3ds( &buffer, 3, 100, 0 );
+
+	whole = parse_3ds_pieces( test3ds, sizeof(test3ds), 0, TL_FVF_XYZ );
+	generated = parse_3ds_pieces( buffer.data, buffer.length, 0, TL_FVF_XYZ | TL_FVF_UV );
+	check( whole != NULL && generated != NULL, "tl3dsParse" );
+
+	for( i = 0; i < sizeof(steps) / sizeof(steps[0]); i++ )
+	{
+		pieces = parse_3ds_pieces( test3ds, sizeof(test3ds), steps[i], TL_FVF_XYZ );
+		check_trimeshes( whole, pieces, "tl3dsParse in pieces matches one call" );
+
+		if( pieces )
+			tlDeleteTrimesh( pieces );
+
+		pieces = parse_3ds_pieces( buffer.data, buffer.length, steps[i], TL_FVF_XYZ | TL_FVF_UV );
+		check_trimeshes( generated, pieces, "tl3dsParse of texture coordinates in pieces matches one call" );
+
+		if( pieces )
+			tlDeleteTrimesh( pieces );
+	}
+
+	/* spot check the bulk decoding against the generator */
+	check( generated != NULL && generated->vertex_count == 900
+		&& generated->vertices[5 * 5 + 3] == 2.5f && generated->vertices[5 * 5 + 4] == -5.0f,
+		"tl3dsParse texture coordinates" );
+
+	if( generated )
+		tlDeleteTrimesh( generated );
+
+	if( whole )
+		tlDeleteTrimesh( whole );
+
+	free( buffer.data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* tlLoad3DS seeks past large chunks instead of reading them, the objects
+ * behind the animation data have to come out as from memory */
+static void test_3ds_skip( void )
+{
+	test_buffer buffer;
+	tlTrimesh *memory, *pieces, *loaded;
+
+	memset( &buffer, 0, sizeof(buffer) );
+	generate_3ds( &buffer, 4, 1000, 1024 * 1024 + 3 );
+
+	if( buffer.data == NULL || write_file( TEST_SKIP_FILE, (const char *)buffer.data, buffer.length ) )
+	{
+		check( 0, "writing the test files" );
+		free( buffer.data );
+		return;
+	}
+
+	memory = parse_3ds_pieces( buffer.data, buffer.length, 0, TL_FVF_XYZ | TL_FVF_UV );
+	check( memory != NULL && memory->object_count == 4 && memory->vertex_count == 12000,
+		"tl3dsParse skips the keyframer chunk" );
+
+	pieces = parse_3ds_pieces( buffer.data, buffer.length, 7, TL_FVF_XYZ | TL_FVF_UV );
+	check_trimeshes( memory, pieces, "tl3dsParse skips the keyframer chunk in pieces" );
+
+	loaded = tlLoad3DS( TEST_SKIP_FILE, TL_FVF_XYZ | TL_FVF_UV );
+	check_trimeshes( memory, loaded, "tlLoad3DS seeking past the keyframer chunk matches tl3dsParse" );
+
+	if( loaded )
+		tlDeleteTrimesh( loaded );
+
+	if( pieces )
+		tlDeleteTrimesh( pieces );
+
+	if( memory )
+		tlDeleteTrimesh( memory );
+
+	remove( TEST_SKIP_FILE );
+	free( buffer.data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* groups of three corners with positive and negative indices, objects and
+ * material groups change every few lines so they span the split points */
+static void generate_obj( test_buffer *buffer, size_t groups )
+{
+	char line[128];
+	size_t i, j;
+
+	for( i = 0; i < groups; i++ )
+	{
+		if( i % 7 == 0 )
+		{
+			sprintf( line, "o part%lu\n", (unsigned long)(i / 7) );
+			put_bytes( buffer, line, strlen( line ) );
+		}
+
+		if( i % 5 == 0 )
+		{
+			sprintf( line, "usemtl %s\r\n", i % 10 == 0 ? "red" : "blue" );
+			put_bytes( buffer, line, strlen( line ) );
+		}
+
+		for( j = 0; j < 3; j++ )
+		{
+			sprintf( line, "v %lu.%lu %lu -%lu.5\nvt 0.%lu 0.%lu\nvn 0 %lu 1\n",
+				(unsigned long)i, (unsigned long)j, (unsigned long)(j * 7), (unsigned long)(i % 13),
+				(unsigned long)(i % 10), (unsigned long)j, (unsigned long)(i % 3) );
+			put_bytes( buffer, line, strlen( line ) );
+		}
+
+		/* a comment line here and there */
+		if( i % 11 == 0 )
+			put_bytes( buffer, "# generated\n", 12 );
+
+		if( i % 2 == 0 )
+			sprintf( line, "f -3/-3/-3 -2/-2/-2 -1/-1/-1\n" );
+		else
+			sprintf( line, "f %lu/%lu %lu//%lu -1/-1/-1\n",
+				(unsigned long)(i * 3 + 1), (unsigned long)(i * 3 + 1),
+				(unsigned long)(i * 3 + 2), (unsigned long)(i * 3 + 2) );
+
+		put_bytes( buffer, line, strlen( line ) );
+	}
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* input large enough that every thread gets a piece of its own */
+static void test_obj_parallel_split( void )
+{
+	test_buffer buffer;
+	tlObjState *serial = tlObjCreateState();
+	tlObjState *parallel = tlObjCreateState();
+	unsigned int threads;
+
+	memset( &buffer, 0, sizeof(buffer) );
+	generate_obj( &buffer, 12000 );
+
+	if( serial && parallel && buffer.data )
+	{
+		check( tlObjParse( serial, (const char *)buffer.data, buffer.length, 1 ) == 0, "tlObjParse" );
+
+		for( threads = 2; threads <= 8; threads++ )
+		{
+			tlObjResetState( parallel );
+			check( tlObjParseParallel( parallel, (const char *)buffer.data, buffer.length, threads ) == 0,
+				"tlObjParseParallel" );
+			check_obj_states( serial, parallel, "split tlObjParseParallel matches tlObjParse" );
+		}
+	}
+
+	tlObjDestroyState( parallel );
+	tlObjDestroyState( serial );
+	free( buffer.data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* tlObjParse called for every few bytes of data */
+static int parse_obj_pieces( tlObjState *state, const char *data, size_t length, size_t step )
+{
+	size_t offset, piece;
+
+	for( offset = 0; offset < length; offset += piece )
+	{
+		piece = length - offset < step ? length - offset : step;
+
+		if( tlObjParse( state, data + offset, piece, offset + piece == length ) != 0 )
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* pieces break lines, comments and numbers anywhere, with CRLF also
+ * between the \r and the \n */
+static void test_obj_pieces( void )
+{
+	static const size_t steps[] = { 1, 2, 3, 7 };
+	tlObjState *whole = tlObjCreateState();
+	tlObjState *pieces = tlObjCreateState();
+	test_buffer crlf;
+	size_t i;
+
+	memset( &crlf, 0, sizeof(crlf) );
+	for( i = 0; i < sizeof(testobj); i++ )
+	{
+		if( testobj[i] == '\n' )
+			put_bytes( &crlf, "\r\n", 2 );
+		else
+			put_bytes( &crlf, &testobj[i], 1 );
+	}
+
+	if( whole && pieces && crlf.data )
+	{
+		check( tlObjParse( whole, testobj, sizeof(testobj), 1 ) == 0, "tlObjParse" );
+
+		for( i = 0; i < sizeof(steps) / sizeof(steps[0]); i++ )
+		{
+			tlObjResetState( pieces );
+			check( parse_obj_pieces( pieces, testobj, sizeof(testobj), steps[i] ) == 0, "tlObjParse pieces" );
+			check_obj_states( whole, pieces, "tlObjParse in pieces matches one call" );
+
+			tlObjResetState( pieces );
+			check( parse_obj_pieces( pieces, (const char *)crlf.data, crlf.length, steps[i] ) == 0,
+				"tlObjParse CRLF pieces" );
+			check_obj_states( whole, pieces, "tlObjParse of CRLF in pieces matches one call" );
+		}
+	}
+
+	tlObjDestroyState( pieces );
+	tlObjDestroyState( whole );
+	free( crlf.data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* every corner its own vertex, in order, at (index, 0, 0) */
+static void check_separate_triangles( tlTrimesh *trimesh, size_t vertex_count, const char *what )
+{
+	size_t i;
+	int same = trimesh != NULL && trimesh->vertex_count == vertex_count
+		&& trimesh->face_count * 3 == vertex_count;
+
+	for( i = 0; same && i < vertex_count; i++ )
+	{
+		if( trimesh->faces[i] != i || trimesh->vertices[i * 3] != (float)i )
+			same = 0;
+	}
+
+	check( same, what );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void test_large_meshes( void )
+{
+	test_buffer buffer;
+	tl3dsState *state;
+	tlTrimesh *trimesh;
+	FILE *f;
+	size_t i;
+
+	f = fopen( TEST_LARGE_FILE, "wb" );
+	check( f != NULL, "writing the large OBJ file" );
+	if( f )
+	{
+		for( i = 0; i < TEST_LARGE_TRIANGLES * 3; i++ )
+			fprintf( f, "v %lu 0 0\n", (unsigned long)i );
+
+		for( i = 0; i < TEST_LARGE_TRIANGLES; i++ )
+			fprintf( f, "f %lu %lu %lu\n", (unsigned long)(i * 3 + 1),
+				(unsigned long)(i * 3 + 2), (unsigned long)(i * 3 + 3) );
+
+		fclose( f );
+
+		trimesh = tlLoadOBJ( TEST_LARGE_FILE, TL_FVF_XYZ );
+		check_separate_triangles( trimesh, TEST_LARGE_TRIANGLES * 3,
+			"OBJ indices past 65535 survive in tlTrimesh" );
+
+		if( trimesh )
+			tlDeleteTrimesh( trimesh );
+
+		remove( TEST_LARGE_FILE );
+	}
+
+	/* 3DS objects are limited to 65535 vertices, their sum is not */
+	memset( &buffer, 0, sizeof(buffer) );
+	generate_3ds( &buffer, 2, TEST_LARGE_TRIANGLES / 2, 0 );
+
+	state = tl3dsCreateState();
+	if( state && buffer.data )
+	{
+		tl3dsParse( state, (const char *)buffer.data, buffer.length, 1 );
+		trimesh = tlCreateTrimeshFrom3dsState( state, TL_FVF_XYZ );
+		check_separate_triangles( trimesh, (TEST_LARGE_TRIANGLES / 2) * 2 * 3,
+			"3DS indices past 65535 survive in tlTrimesh" );
+
+		if( trimesh )
+			tlDeleteTrimesh( trimesh );
+	}
+
+	tl3dsDestroyState( state );
+	free( buffer.data );
+}
+
+
+/*----------------------------------------------------------------------------*/
+static void test_load( void )
+{
+	tlTrimesh *reference;
+
+	if( write_file( TEST_OBJ_FILE, testobj, sizeof(testobj) )
+		|| write_file( TEST_MTL_FILE, testmtl, sizeof(testmtl) - 1 ) )
+	{
+		check( 0, "writing the test files" );
+		return;
+	}
+
+	reference = tlLoadTrimesh( TEST_OBJ_FILE, TL_FVF_XYZ | TL_FVF_UV );
+	check( reference != NULL, "tlLoadTrimesh" );
+	check( material_diffuse_green( reference ) == 0.25f, "tlLoadTrimesh loads the mtllib" );
+
+	if( reference )
+	{
+		test_material_cache( reference );
+		test_batch( reference );
+		tlDeleteTrimesh( reference );
+	}
+
+	remove( TEST_MTL_FILE );
+	remove( TEST_OBJ_FILE );
+}
+
+
+/*----------------------------------------------------------------------------*/
+/* prints the objects and vertices of a 3DS file */
+static void dump_3ds( const char *filename )
 {
 	FILE *f = 0;
 	
-	if( argc < 2 )
-		return 1;
-		
-	f = fopen( argv[1], "r" );
+	f = fopen( filename, "r" );
 	if( f )
 	{
 		tl3dsState *state = 0;
@@ -59,7 +932,26 @@ int main( int argc, char **argv )
 		
 		fclose( f );
 	}
-	
-	return 0;
 }
 
+
+/*----------------------------------------------------------------------------*/
+int main( int argc, char **argv )
+{
+	test_obj_parallel();
+	test_obj_parallel_split();
+	test_obj_pieces();
+	test_3ds_pieces();
+	test_3ds_skip();
+	test_load();
+	test_3ds_objects();
+	test_large_meshes();
+
+	if( argc > 1 )
+		dump_3ds( argv[1] );
+
+	if( failures > 0 )
+		printf( "%d checks failed\n", failures );
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#include "../src/tlnumber.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int failures = 0;
+static unsigned int checks = 0;
+static tl_uint64 seed = 88172645463325252;
+
+static tl_uint64 next_random()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return seed;
+}
+
+/* compare consumed length and bits with the C library */
+static void check( const char *text )
+{
+	const char *end = text + strlen( text );
+	char *libc_end;
+	double d, libc_d;
+	const char *d_end;
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+	float f, libc_f;
+	const char *f_end;
+#endif
+
+	d_end = tl_parse_double( text, end, &d );
+	libc_d = strtod( text, &libc_end );
+	checks++;
+	if( d_end != libc_end || memcmp( &d, &libc_d, sizeof(double) ) != 0 )
+	{
+		if( failures++ < 20 )
+			printf( "double mismatch: \"%s\" %.17g (%d) != %.17g (%d)\n", text,
+				d, (int)(d_end - text), libc_d, (int)(libc_end - text) );
+	}
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+	f_end = tl_parse_float( text, end, &f );
+	libc_f = strtof( text, &libc_end );
+	checks++;
+	if( f_end != libc_end || memcmp( &f, &libc_f, sizeof(float) ) != 0 )
+	{
+		if( failures++ < 20 )
+			printf( "float mismatch: \"%s\" %.9g (%d) != %.9g (%d)\n", text,
+				f, (int)(f_end - text), libc_f, (int)(libc_end - text) );
+	}
+#endif
+}
+
+static const char *fixed[] =
+{
+	"0", "-0", "+0", "0.0", "-0.0", "1", "-1", "+1", ".5", "5.", "-.5", ".",
+	"-", "+", "", "e5", "1e", "1e+", "1e-", "1.5e3", "1.5E-3", "1.5e+03x",
+	"0.1", "0.2", "0.3", "3.14159265358979323846", "2.718281828459045",
+	"9007199254740993", "9007199254740992", "9007199254740991",
+	"2.2250738585072011e-308", "2.2250738585072014e-308",
+	"4.9406564584124654e-324", "2.4703282292062327e-324",
+	"2.4703282292062328e-324", "1.7976931348623157e308",
+	"1.7976931348623158e308", "1.7976931348623159e308", "1e308", "1e309",
+	"1e-400", "1e23", "8.988465674311580536566680e307",
+	"1.00000005960464477550", "1.0000000596046447755", "16777217",
+	"3.4028235e38", "3.4028236e38", "1.17549435e-38", "1.4e-45", "7e-46",
+	"0.000000000000000000000000000000000000000000001",
+	"123456789012345678901234567890", "0.1234567890123456789012",
+	"00000000000000000000000000000000001.5", "1234567890123456789",
+	"12345678901234567890", "-2.090601", "-11.700001", "0.300000",
+	"inf", "-inf", "infinity", "nan", "0x1p3", "0X1.8p1", "1/2/3", "1#2",
+	"1.5.5", "1e1e1", "1-1", "1,5",
+	NULL
+};
+
+int main( int argc, char **argv )
+{
+	char text[128];
+	unsigned int i;
+
+	for( i = 0; fixed[i] != NULL; i++ )
+		check( fixed[i] );
+
+	/* random doubles, shortest and fixed notations */
+	for( i = 0; i < 200000; i++ )
+	{
+		tl_uint64 bits = next_random();
+		double d;
+		memcpy( &d, &bits, sizeof(double) );
+		if( d != d )
+			continue;
+
+		sprintf( text, "%.17g", d );
+		check( text );
+		sprintf( text, "%.*g", (int)(next_random() % 17) + 1, d );
+		check( text );
+		sprintf( text, "%.6f", (double)(next_random() % 2000000) / 1000.0 - 1000.0 );
+		check( text );
+	}
+
+	/* random digit strings with random exponents */
+	for( i = 0; i < 200000; i++ )
+	{
+		int digits = (int)(next_random() % 22) + 1, j, length = 0;
+
+		if( next_random() & 1 )
+			text[length++] = '-';
+
+		for( j = 0; j < digits; j++ )
+		{
+			if( j == (int)(next_random() % (digits + 1)) )
+				text[length++] = '.';
+			text[length++] = (char)('0' + next_random() % 10);
+		}
+
+		sprintf( text + length, "e%d", (int)(next_random() % 700) - 350 );
+		check( text );
+	}
+
+	/* halfway cases between adjacent floats and doubles */
+	for( i = 0; i < 100000; i++ )
+	{
+		tl_uint64 bits = next_random() & ((tl_uint64)0x7FEFFFFF << 32 | 0xFFFFFFFF);
+		double d, next;
+		float f, next_f;
+		unsigned int fbits = (unsigned int)next_random() & 0x7F7FFFFF;
+
+		memcpy( &d, &bits, sizeof(double) );
+		bits++;
+		memcpy( &next, &bits, sizeof(double) );
+		sprintf( text, "%.40g", d / 2 + next / 2 );
+		check( text );
+
+		memcpy( &f, &fbits, sizeof(float) );
+		fbits++;
+		memcpy( &next_f, &fbits, sizeof(float) );
+		sprintf( text, "%.25g", (double)f / 2 + (double)next_f / 2 );
+		check( text );
+	}
+
+	printf( "%u checks, %u failures\n", checks, failures );
+
+	return failures != 0;
+}
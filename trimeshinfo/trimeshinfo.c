@@ -20,10 +20,10 @@ int main( int argc, char **argv )
 	trimesh = tlLoadTrimesh( argv[1] , TL_FVF_XYZ | TL_FVF_UV | TL_FVF_NORMAL );
 	if( trimesh )
 	{
-		printf( "Objects: %d\n", trimesh->object_count );
-		printf( "Vertices: %d\n", trimesh->vertex_count );
-		printf( "Faces: %d\n", trimesh->face_count );
-		printf( "Materials: %d\n", trimesh->material_count );
+		printf( "Objects: %lu\n", (unsigned long)trimesh->object_count );
+		printf( "Vertices: %lu\n", (unsigned long)trimesh->vertex_count );
+		printf( "Faces: %lu\n", (unsigned long)trimesh->face_count );
+		printf( "Materials: %lu\n", (unsigned long)trimesh->material_count );
 
 		tlDeleteTrimesh( trimesh );
 	}